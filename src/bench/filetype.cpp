@@ -0,0 +1,191 @@
+/*
+	Copyright (c) 2019 Kamil Chojnowski Y29udGFjdEBkaWF0aC5uZXQ=
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in the
+	Software without restriction, including without limitation the rights to use,
+	copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+	THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "core/utils.hpp"
+
+/*
+	Compares GetFileType() against the classifier it replaced, which lowercased a copy of the name and searched a
+	table of suffixes one by one.
+
+	Usage: bench_filetype [path...]
+	Every directory given is walked for file names, every regular file is read as a list of names, one per line.
+	Without arguments the names are collected from /usr.
+*/
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr int Passes = 5;
+
+FileType GetFileTypeLinear(std::string name)
+{
+	static const std::tuple<std::string, FileType> FileTypes[] = {
+		// Document
+		{".txt", FileType::Document},
+		{".doc", FileType::Document},
+		{".pdf", FileType::Document},
+		{".tex", FileType::Document},
+		{".rtf", FileType::Document},
+		// Image
+		{".jpg", FileType::Image},
+		{".jpeg", FileType::Image},
+		{".png", FileType::Image},
+		{".bmp", FileType::Image},
+		{".gif", FileType::Image},
+		{".tiff", FileType::Image},
+		{".ppm", FileType::Image},
+		// Video
+		{".webm", FileType::Video},
+		{".mkv", FileType::Video},
+		{".flv", FileType::Video},
+		{".avi", FileType::Video},
+		{".mp4", FileType::Video},
+		// Audio
+		{".3gp", FileType::Audio},
+		{".aac", FileType::Audio},
+		{".m4a", FileType::Audio},
+		{".mp3", FileType::Audio},
+		{".ogg", FileType::Audio},
+		{".opus", FileType::Audio},
+		{".wav", FileType::Audio},
+		// Archive
+		{".zip", FileType::Archive},
+		{".rar", FileType::Archive},
+		{".tar", FileType::Archive},
+		{".gz", FileType::Archive},
+		{".xz", FileType::Archive},
+		{".bz2", FileType::Archive},
+		{".7z", FileType::Archive},
+		// NOTE: Lowercased, the old table had ".Z" which could never match a lowercased name.
+		{".z", FileType::Archive},
+		{".tgz", FileType::Archive},
+		{".tbz2", FileType::Archive},
+		// System
+		{".exe", FileType::System},
+		{".dll", FileType::System},
+		{".sys", FileType::System},
+		{".so", FileType::System},
+	};
+
+	const auto size = name.size();
+	if (!size) {
+		return FileType::Generic;
+	}
+
+	std::transform(name.begin(), name.end(), name.begin(), [] (const unsigned char ch) {
+		return std::tolower(ch);
+	});
+
+	for (const auto &pair: FileTypes) {
+		const auto &[ext, type] = pair;
+		if (ext.size() > size) {
+			continue;
+		}
+
+		auto index = name.rfind(ext);
+		if (index == std::string::npos) {
+			continue;
+		}
+
+		if (name.substr(index) == ext) {
+			return type;
+		}
+	}
+
+	return FileType::Generic;
+}
+
+void CollectNames(const fs::path &path, std::vector<std::string> &names)
+{
+	std::error_code error{};
+	if (fs::is_regular_file(path, error)) {
+		std::ifstream file{path};
+		for (std::string line{}; std::getline(file, line);) {
+			names.push_back(line);
+		}
+
+		return;
+	}
+
+	for (auto it = fs::recursive_directory_iterator{path, fs::directory_options::skip_permission_denied, error}; it != fs::recursive_directory_iterator{}; it.increment(error)) {
+		if (error) {
+			break;
+		}
+
+		names.push_back(it->path().filename().string());
+	}
+}
+
+template <typename Classifier>
+double Measure(const std::vector<std::string> &names, Classifier &&classifier, std::size_t &checksum)
+{
+	const auto start = std::chrono::steady_clock::now();
+	for (int pass = 0; pass < Passes; ++pass) {
+		for (const auto &name: names) {
+			checksum += static_cast<std::size_t>(classifier(name));
+		}
+	}
+
+	const auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	return elapsed / static_cast<double>(names.size() * Passes);
+}
+
+} // namespace <anonymous>
+
+int main(int argc, char **argv)
+{
+	std::vector<std::string> names{};
+	if (argc > 1) {
+		for (int i = 1; i < argc; ++i) {
+			CollectNames(argv[i], names);
+		}
+	} else {
+		CollectNames("/usr", names);
+	}
+
+	if (names.empty()) {
+		std::fprintf(stderr, "No file names to classify.\n");
+		return EXIT_FAILURE;
+	}
+
+	std::size_t mismatches = 0;
+	for (const auto &name: names) {
+		mismatches += GetFileType(name) != GetFileTypeLinear(name);
+	}
+
+	std::size_t checksum = 0;
+	const auto linear = Measure(names, [] (const std::string &name) { return GetFileTypeLinear(name); }, checksum);
+	const auto hashed = Measure(names, [] (const std::string &name) { return GetFileType(name); }, checksum);
+
+	std::printf("%zu names, %d passes (checksum %zu)\n", names.size(), Passes, checksum);
+	std::printf("  linear table: %8.1f ns per name\n", linear);
+	std::printf("  perfect hash: %8.1f ns per name (%.1fx)\n", hashed, linear / hashed);
+	std::printf("  mismatches:   %zu\n", mismatches);
+	return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,292 @@
+/*
+	Copyright (c) 2019 Kamil Chojnowski Y29udGFjdEBkaWF0aC5uZXQ=
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in the
+	Software without restriction, including without limitation the rights to use,
+	copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+	THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <iterator>
+
+#include "bitmap.hpp"
+
+namespace {
+
+// Past this many ids an array container takes more memory than a bitset, same threshold as in roaring.
+constexpr std::size_t ArrayMaxSize = 4096;
+constexpr std::size_t BitsetWords = 65536 / 64;
+
+inline std::uint16_t High(const Bitmap::Id id)
+{
+	return static_cast<std::uint16_t>(id >> 16);
+}
+
+inline std::uint16_t Low(const Bitmap::Id id)
+{
+	return static_cast<std::uint16_t>(id & 0xFFFF);
+}
+
+inline bool BitsetHas(const std::vector<std::uint64_t> &bits, const std::uint16_t value)
+{
+	return (bits[value >> 6] >> (value & 63)) & 1;
+}
+
+std::uint32_t CountBits(const std::vector<std::uint64_t> &bits)
+{
+	std::uint32_t count = 0;
+	for (const auto word: bits) {
+		count += static_cast<std::uint32_t>(__builtin_popcountll(word));
+	}
+
+	return count;
+}
+
+} // namespace <anonymous>
+
+void Bitmap::Container::toBitset()
+{
+	bits.assign(BitsetWords, 0);
+	for (const auto value: array) {
+		bits[value >> 6] |= std::uint64_t{1} << (value & 63);
+	}
+
+	array.clear();
+	array.shrink_to_fit();
+}
+
+void Bitmap::Container::toArray()
+{
+	array.clear();
+	array.reserve(cardinality);
+
+	for (std::size_t word = 0; word < bits.size(); ++word) {
+		for (auto current = bits[word]; current; current &= current - 1) {
+			array.push_back(static_cast<std::uint16_t>(word * 64 + __builtin_ctzll(current)));
+		}
+	}
+
+	bits.clear();
+	bits.shrink_to_fit();
+}
+
+void Bitmap::add(const Id id)
+{
+	const auto key = High(id);
+	const auto value = Low(id);
+
+	Container *container = nullptr;
+	if (!containers.empty() && containers.back().key == key) {
+		container = &containers.back();
+	} else if (containers.empty() || containers.back().key < key) {
+		containers.push_back({key, 0, {}, {}});
+		container = &containers.back();
+	} else {
+		auto it = std::lower_bound(containers.begin(), containers.end(), key, [] (const Container &container, const std::uint16_t key) {
+			return container.key < key;
+		});
+
+		if (it == containers.end() || it->key != key) {
+			it = containers.insert(it, {key, 0, {}, {}});
+		}
+
+		container = &*it;
+	}
+
+	if (container->isBitset()) {
+		auto &word = container->bits[value >> 6];
+		const auto bit = std::uint64_t{1} << (value & 63);
+		if (!(word & bit)) {
+			word |= bit;
+			++container->cardinality;
+		}
+
+		return;
+	}
+
+	auto &array = container->array;
+	if (array.empty() || array.back() < value) {
+		array.push_back(value);
+	} else {
+		auto it = std::lower_bound(array.begin(), array.end(), value);
+		if (*it == value) {
+			return;
+		}
+
+		array.insert(it, value);
+	}
+
+	if (++container->cardinality > ArrayMaxSize) {
+		container->toBitset();
+	}
+}
+
+bool Bitmap::contains(const Id id) const
+{
+	const auto container = find(High(id));
+	if (!container) {
+		return false;
+	}
+
+	if (container->isBitset()) {
+		return BitsetHas(container->bits, Low(id));
+	}
+
+	return std::binary_search(container->array.begin(), container->array.end(), Low(id));
+}
+
+void Bitmap::clear()
+{
+	containers.clear();
+}
+
+std::size_t Bitmap::cardinality() const
+{
+	std::size_t result = 0;
+	for (const auto &container: containers) {
+		result += container.cardinality;
+	}
+
+	return result;
+}
+
+Bitmap &Bitmap::operator |=(const Bitmap &other)
+{
+	std::vector<Container> result{};
+	result.reserve(containers.size() + other.containers.size());
+
+	auto lhs = containers.begin();
+	auto rhs = other.containers.begin();
+
+	while (lhs != containers.end() || rhs != other.containers.end()) {
+		if (rhs == other.containers.end() || (lhs != containers.end() && lhs->key < rhs->key)) {
+			result.push_back(std::move(*lhs++));
+			continue;
+		}
+
+		if (lhs == containers.end() || rhs->key < lhs->key) {
+			result.push_back(*rhs++);
+			continue;
+		}
+
+		Container merged{lhs->key, 0, {}, {}};
+		if (!lhs->isBitset() && !rhs->isBitset()) {
+			std::set_union(lhs->array.begin(), lhs->array.end(), rhs->array.begin(), rhs->array.end(), std::back_inserter(merged.array));
+			merged.cardinality = static_cast<std::uint32_t>(merged.array.size());
+
+			if (merged.cardinality > ArrayMaxSize) {
+				merged.toBitset();
+			}
+		} else {
+			auto &bitset = lhs->isBitset() ? *lhs : *rhs;
+			const auto &other = lhs->isBitset() ? *rhs : *lhs;
+
+			merged.bits = std::move(bitset.bits);
+			if (other.isBitset()) {
+				for (std::size_t word = 0; word < BitsetWords; ++word) {
+					merged.bits[word] |= other.bits[word];
+				}
+			} else {
+				for (const auto value: other.array) {
+					merged.bits[value >> 6] |= std::uint64_t{1} << (value & 63);
+				}
+			}
+
+			merged.cardinality = CountBits(merged.bits);
+		}
+
+		result.push_back(std::move(merged));
+		++lhs;
+		++rhs;
+	}
+
+	containers = std::move(result);
+	return *this;
+}
+
+Bitmap &Bitmap::operator &=(const Bitmap &other)
+{
+	std::vector<Container> result{};
+
+	for (auto &container: containers) {
+		const auto match = other.find(container.key);
+		if (!match) {
+			continue;
+		}
+
+		Container merged{container.key, 0, {}, {}};
+		if (container.isBitset() && match->isBitset()) {
+			merged.bits = std::move(container.bits);
+			for (std::size_t word = 0; word < BitsetWords; ++word) {
+				merged.bits[word] &= match->bits[word];
+			}
+
+			merged.cardinality = CountBits(merged.bits);
+			if (merged.cardinality <= ArrayMaxSize) {
+				merged.toArray();
+			}
+		} else if (container.isBitset() || match->isBitset()) {
+			const auto &bitset = container.isBitset() ? container : *match;
+			const auto &array = container.isBitset() ? *match : container;
+
+			for (const auto value: array.array) {
+				if (BitsetHas(bitset.bits, value)) {
+					merged.array.push_back(value);
+				}
+			}
+
+			merged.cardinality = static_cast<std::uint32_t>(merged.array.size());
+		} else {
+			std::set_intersection(container.array.begin(), container.array.end(), match->array.begin(), match->array.end(), std::back_inserter(merged.array));
+			merged.cardinality = static_cast<std::uint32_t>(merged.array.size());
+		}
+
+		if (merged.cardinality > 0) {
+			result.push_back(std::move(merged));
+		}
+	}
+
+	containers = std::move(result);
+	return *this;
+}
+
+void Bitmap::toVector(std::vector<Id> &out) const
+{
+	out.reserve(out.size() + cardinality());
+
+	for (const auto &container: containers) {
+		const auto base = static_cast<Id>(container.key) << 16;
+
+		if (!container.isBitset()) {
+			for (const auto value: container.array) {
+				out.push_back(base | value);
+			}
+
+			continue;
+		}
+
+		for (std::size_t word = 0; word < BitsetWords; ++word) {
+			for (auto current = container.bits[word]; current; current &= current - 1) {
+				out.push_back(base | static_cast<Id>(word * 64 + __builtin_ctzll(current)));
+			}
+		}
+	}
+}
+
+const Bitmap::Container *Bitmap::find(const std::uint16_t key) const
+{
+	auto it = std::lower_bound(containers.begin(), containers.end(), key, [] (const Container &container, const std::uint16_t key) {
+		return container.key < key;
+	});
+
+	return (it != containers.end() && it->key == key) ? &*it : nullptr;
+}
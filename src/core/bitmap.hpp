@@ -0,0 +1,71 @@
+/*
+	Copyright (c) 2019 Kamil Chojnowski Y29udGFjdEBkaWF0aC5uZXQ=
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in the
+	Software without restriction, including without limitation the rights to use,
+	copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+	THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef NOTHING_BITMAP_HPP
+#define NOTHING_BITMAP_HPP
+
+#include <cstdint>
+#include <vector>
+
+/*
+	Compressed bitmap of row ids, laid out like a roaring bitmap.
+
+	The id space is split into chunks of 65536 ids keyed by the upper 16 bits. A chunk with few ids keeps them as a
+	sorted array of the lower 16 bits, a dense chunk switches to a plain 8 KiB bitset. Unions and intersections
+	work chunk by chunk and pick the cheapest way to combine each pair of containers.
+*/
+class Bitmap
+{
+	public:
+		using Id = std::uint32_t;
+
+		Bitmap() = default;
+
+		// Ids are expected to be added in mostly ascending order, which makes adding an append.
+		void add(const Id id);
+		bool contains(const Id id) const;
+		void clear();
+
+		bool empty() const { return containers.empty(); }
+		std::size_t cardinality() const;
+
+		Bitmap &operator |=(const Bitmap &other);
+		Bitmap &operator &=(const Bitmap &other);
+
+		// Appends the ids in ascending order.
+		void toVector(std::vector<Id> &out) const;
+
+	private:
+		struct Container
+		{
+			std::uint16_t key = 0;
+			std::uint32_t cardinality = 0;
+			// Exactly one of these is in use, the bitset one once the container holds more than ArrayMaxSize ids.
+			std::vector<std::uint16_t> array{};
+			std::vector<std::uint64_t> bits{};
+
+			bool isBitset() const { return !bits.empty(); }
+			void toBitset();
+			void toArray();
+		};
+
+		std::vector<Container> containers{};
+
+		const Container *find(const std::uint16_t key) const;
+};
+
+#endif // NOTHING_BITMAP_HPP
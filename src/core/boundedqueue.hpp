@@ -0,0 +1,135 @@
+/*
+	Copyright (c) 2019 Kamil Chojnowski Y29udGFjdEBkaWF0aC5uZXQ=
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in the
+	Software without restriction, including without limitation the rights to use,
+	copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+	THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef NOTHING_BOUNDEDQUEUE_HPP
+#define NOTHING_BOUNDEDQUEUE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+/*
+	A fixed capacity multi-producer multi-consumer queue that takes no locks.
+
+	Every cell carries a sequence number that tells whether it is free for the producer or filled for the consumer
+	at a given position (Dmitry Vyukov's bounded queue). Producers and consumers each claim a position with a single
+	compare-and-swap, so they only contend with their own kind and never with each other. Both operations fail
+	instead of blocking when the queue is full or empty, waiting is up to the caller.
+*/
+template <typename T>
+class BoundedQueue
+{
+	public:
+		// The capacity is rounded up to a power of two.
+		explicit BoundedQueue(const std::size_t capacity) {
+			std::size_t size = 2;
+			while (size < capacity) {
+				size *= 2;
+			}
+
+			cells = std::make_unique<Cell[]>(size);
+			mask = size - 1;
+
+			for (std::size_t i = 0; i < size; ++i) {
+				cells[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+
+		BoundedQueue(const BoundedQueue &) = delete;
+		BoundedQueue(BoundedQueue &&) = delete;
+
+		BoundedQueue &operator =(const BoundedQueue &) = delete;
+		BoundedQueue &operator =(BoundedQueue &&) = delete;
+
+		// The value is only moved from if it was queued.
+		bool tryPush(T &value) {
+			auto position = enqueuePosition.load(std::memory_order_relaxed);
+			Cell *cell = nullptr;
+
+			for (;;) {
+				cell = &cells[position & mask];
+				const auto sequence = cell->sequence.load(std::memory_order_acquire);
+				const auto difference = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position);
+
+				if (difference == 0) {
+					if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+						break;
+					}
+				} else if (difference < 0) {
+					return false;
+				} else {
+					position = enqueuePosition.load(std::memory_order_relaxed);
+				}
+			}
+
+			cell->value = std::move(value);
+			cell->sequence.store(position + 1, std::memory_order_release);
+			return true;
+		}
+
+		bool tryPop(T &value) {
+			auto position = dequeuePosition.load(std::memory_order_relaxed);
+			Cell *cell = nullptr;
+
+			for (;;) {
+				cell = &cells[position & mask];
+				const auto sequence = cell->sequence.load(std::memory_order_acquire);
+				const auto difference = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position + 1);
+
+				if (difference == 0) {
+					if (dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+						break;
+					}
+				} else if (difference < 0) {
+					return false;
+				} else {
+					position = dequeuePosition.load(std::memory_order_relaxed);
+				}
+			}
+
+			value = std::move(cell->value);
+			cell->value = T{};
+			cell->sequence.store(position + mask + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Only a snapshot, the queue may change right after.
+		std::size_t size() const {
+			const auto dequeued = dequeuePosition.load(std::memory_order_relaxed);
+			const auto enqueued = enqueuePosition.load(std::memory_order_relaxed);
+			return enqueued > dequeued ? enqueued - dequeued : 0;
+		}
+
+		std::size_t capacity() const { return mask + 1; }
+
+	private:
+		struct Cell
+		{
+			std::atomic<std::size_t> sequence{0};
+			T value{};
+		};
+
+		std::unique_ptr<Cell[]> cells{};
+		std::size_t mask = 0;
+
+		// NOTE: Kept on separate cache lines so that producers and consumers do not invalidate each other's position.
+		alignas(64) std::atomic<std::size_t> enqueuePosition{0};
+		alignas(64) std::atomic<std::size_t> dequeuePosition{0};
+};
+
+#endif // NOTHING_BOUNDEDQUEUE_HPP
@@ -15,258 +15,419 @@
 	THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
+#include <condition_variable>
 #include <regex>
+#include <unordered_map>
 
 #include "database.hpp"
+#include "directoryreader.hpp"
+#include "search.hpp"
+#include "snapshot.hpp"
 
 namespace {
 
-void RegexQuery(sqlite3_context *ctx, int argc, sqlite3_value **argv)
+constexpr std::size_t QueryCacheCapacity = 64 * 1024 * 1024;
+
+} // namespace <anonymous>
+
+Database::Database()
+: queryCache{QueryCacheCapacity}
 {
-	if (argc < 2) {
-		sqlite3_result_error(ctx, "SQL function regexp() called with invalid arguments.\n", -1);
-		return;
-	}
+}
 
-	std::string pattern = std::string(reinterpret_cast<const char *>(sqlite3_value_text(argv[0])));
-	std::string file = std::string(reinterpret_cast<const char *>(sqlite3_value_text(argv[1])));
+Database::~Database()
+{
+	stopSearchThread();
 
-	try {
-		sqlite3_result_int(ctx, !!std::regex_search(file, std::regex(pattern)));
-	} catch (const std::regex_error &) {
-		// NOTE: Most commonly, a regex error will occur when someone types unfinished expression, just yield empty result set in that case.
-		sqlite3_result_null(ctx);
+	if (autosaveThread.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock{autosaveMutex};
+			autosaveStopped = true;
+		}
+
+		autosaveCv.notify_one();
+		autosaveThread.join();
+
+		autosave();
 	}
 }
 
-} // namespace <anonymous>
+Index::Id Database::internRoot(const std::string &path)
+{
+	std::unique_lock<std::shared_mutex> lock{mutex};
+	return index.internRoot(path);
+}
 
-Database::Database()
+Index::Id Database::internDirectory(const std::string &path)
 {
-	if (sqlite3_threadsafe() == 0) {
-		fprintf(stderr, "[Error] The linked SQLite3 library was not built with the SQLITE_THREADSAFE option.\n");
-		std::exit(EXIT_FAILURE);
-	}
+	std::unique_lock<std::shared_mutex> lock{mutex};
+	return index.internDirectory(path);
+}
 
-	sqlite3_config(SQLITE_CONFIG_SERIALIZED);
-	sqlite3_initialize();
-	if (sqlite3_open_v2(":memory:", &handle, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX, nullptr) != SQLITE_OK) {
-		fprintf(stderr, "[Error] Failed to open the SQLite3 database.\n");
-		std::exit(EXIT_FAILURE);
-	}
+Index::Id Database::internDirectory(const Index::Id parent, const std::string &name)
+{
+	std::unique_lock<std::shared_mutex> lock{mutex};
+	return index.internDirectory(parent, name);
+}
 
-	char *error = nullptr;
-	if (sqlite3_exec(handle, "CREATE TABLE files (file TEXT, path TEXT, parent TEXT, size INT, perms INT);", nullptr, nullptr, &error) != SQLITE_OK) {
-		fprintf(stderr, "[Error] Failed to create the files table: %s\n", error);
-		std::exit(EXIT_FAILURE);
-	}
+std::vector<Index::Id> Database::internDirectories(const std::vector<NewDirectory> &directories)
+{
+	std::unique_lock<std::shared_mutex> lock{mutex};
 
-	if (sqlite3_create_function(handle, "regexp", 2, SQLITE_UTF8, nullptr, &RegexQuery, nullptr, nullptr) != SQLITE_OK) {
-		fprintf(stderr, "[Error] Failed to register the regexp function\n");
-		std::exit(EXIT_FAILURE);
+	std::vector<Index::Id> result{};
+	result.reserve(directories.size());
+
+	for (const auto &directory: directories) {
+		const auto parent = directory.parentIndex != NewDirectory::NoParentIndex ? result[directory.parentIndex] : directory.parent;
+		result.push_back(index.internDirectory(parent, directory.name));
 	}
+
+	return result;
 }
 
-Database::~Database()
+std::string Database::getPath(const Index::Id directory) const
 {
-	if (handle != nullptr) {
-		stopSearchThread();
+	std::shared_lock<std::shared_mutex> lock{mutex};
+	return index.directoryPath(directory);
+}
 
-		sqlite3_close(handle);
-		handle = nullptr;
-	}
+std::string Database::getRootPath(const Index::Id root) const
+{
+	std::shared_lock<std::shared_mutex> lock{mutex};
+	return index.rootPath(root);
+}
 
-	sqlite3_shutdown();
+std::vector<std::string> Database::getRootPaths() const
+{
+	std::shared_lock<std::shared_mutex> lock{mutex};
+	return index.rootPaths();
 }
 
-bool Database::addEntry(const Entry &entry)
+bool Database::isRootComplete(const std::string &path) const
 {
-	std::lock_guard<std::mutex> lock{mutex};
+	std::shared_lock<std::shared_mutex> lock{mutex};
 
-	sqlite3_stmt *stmt = nullptr;
-	if (sqlite3_prepare(handle, "INSERT INTO files (file, path, parent, size, perms) VALUES (?, ?, ?, ?, ?);", -1, &stmt, nullptr) != SQLITE_OK) {
-		return false;
-	}
+	const auto root = index.findRoot(path);
+	return root != Index::InvalidId && index.isComplete(root);
+}
 
-	const auto &[name, path, parent, size, perms] = entry;
+void Database::setRootComplete(const Index::Id root, const bool complete)
+{
+	std::unique_lock<std::shared_mutex> lock{mutex};
+	index.setComplete(root, complete);
+}
 
-	if (sqlite3_bind_text(stmt, 1, name.c_str(), -1, nullptr) != SQLITE_OK) {
-		sqlite3_finalize(stmt);
-		return false;
-	}
+Index::Id Database::getRootOwner(const Index::Id directory) const
+{
+	std::shared_lock<std::shared_mutex> lock{mutex};
+	return index.ownerRoot(directory);
+}
 
-	if (sqlite3_bind_text(stmt, 2, path.c_str(), -1, nullptr) != SQLITE_OK) {
-		sqlite3_finalize(stmt);
-		return false;
+std::vector<std::string> Database::mergeRoots(const Index::Id root, const std::vector<std::string> &children)
+{
+	std::unique_lock<std::shared_mutex> lock{mutex};
+
+	std::vector<Index::Id> merged{};
+	std::vector<std::string> result{};
+
+	for (const auto &path: children) {
+		const auto child = index.findRoot(path);
+		if (child == Index::InvalidId) {
+			continue;
+		}
+
+		if (index.isComplete(child)) {
+			merged.push_back(child);
+			result.push_back(path);
+		} else {
+			index.removeByRoot(child);
+		}
 	}
 
-	if (sqlite3_bind_text(stmt, 3, parent.c_str(), -1, nullptr) != SQLITE_OK) {
-		sqlite3_finalize(stmt);
-		return false;
+	index.mergeRoots(root, merged);
+	return result;
+}
+
+std::vector<Database::Directory> Database::getListedDirectories(const Index::Id root) const
+{
+	std::shared_lock<std::shared_mutex> lock{mutex};
+
+	std::vector<Directory> result{};
+	for (const auto id: index.listedDirectories(root)) {
+		result.push_back({id, index.directoryParent(id), index.directoryPath(id), index.directoryStamp(id)});
 	}
 
-	if (sqlite3_bind_int64(stmt, 4, static_cast<sqlite3_int64>(size)) != SQLITE_OK) {
-		sqlite3_finalize(stmt);
-		return false;
+	return result;
+}
+
+void Database::setDirectoryStamps(const std::vector<std::pair<Index::Id, std::uint64_t>> &stamps)
+{
+	std::unique_lock<std::shared_mutex> lock{mutex};
+
+	for (const auto &[directory, stamp]: stamps) {
+		index.setDirectoryStamp(directory, stamp);
 	}
+}
 
-	if (sqlite3_bind_int(stmt, 5, static_cast<int>(perms)) != SQLITE_OK) {
-		sqlite3_finalize(stmt);
-		return false;
+void Database::setDirectoryAliases(const std::vector<std::pair<Index::Id, Index::Id>> &aliases)
+{
+	std::unique_lock<std::shared_mutex> lock{mutex};
+
+	for (const auto &[directory, target]: aliases) {
+		index.setDirectoryAlias(directory, target);
 	}
+}
 
-	sqlite3_step(stmt);
-	sqlite3_finalize(stmt);
+std::vector<std::pair<std::string, std::string>> Database::getAliases() const
+{
+	std::shared_lock<std::shared_mutex> lock{mutex};
 
-	return true;
+	std::vector<std::pair<std::string, std::string>> result{};
+	for (const auto &[directory, target]: index.aliases()) {
+		result.emplace_back(index.directoryPath(directory), index.directoryPath(target));
+	}
+
+	return result;
 }
 
-bool Database::addEntries(const std::vector<Entry> &entries)
+void Database::reconcile(const std::vector<Listing> &listings, const std::vector<Index::Id> &removedDirectories)
 {
-	std::lock_guard<std::mutex> lock{mutex};
+	std::unique_lock<std::shared_mutex> lock{mutex};
 
-	sqlite3_exec(handle, "BEGIN TRANSACTION", nullptr, nullptr, nullptr);
+	if (!removedDirectories.empty()) {
+		index.removeByDirectories(removedDirectories);
+	}
 
-	sqlite3_stmt *stmt = nullptr;
-	if (sqlite3_prepare(handle, "INSERT INTO files (file, path, parent, size, perms) VALUES (?, ?, ?, ?, ?);", -1, &stmt, nullptr) != SQLITE_OK) {
-		return false;
+	if (listings.empty()) {
+		return;
 	}
 
-	auto cleanup = [this, stmt] () {
-		sqlite3_exec(handle, "ROLLBACK TRANSACTION", nullptr, nullptr, nullptr);
-		sqlite3_finalize(stmt);
-	};
+	std::unordered_map<Index::Id, std::size_t> listed{};
+	for (std::size_t i = 0; i < listings.size(); ++i) {
+		listed.emplace(listings[i].directory, i);
+	}
 
-	for (auto &&entry: entries) {
-		const auto &[name, path, parent, size, perms] = entry;
-		if (sqlite3_bind_text(stmt, 1, name.c_str(), -1, nullptr) != SQLITE_OK) {
-			cleanup();
-			return false;
+	// NOTE: A single pass over the table collects the current files of every listed directory.
+	std::vector<std::unordered_map<std::string_view, Index::Id>> current(listings.size());
+	for (Index::Id row = 0; row < index.rows(); ++row) {
+		if (!index.alive(row)) {
+			continue;
 		}
 
-		if (sqlite3_bind_text(stmt, 2, path.c_str(), -1, nullptr) != SQLITE_OK) {
-			cleanup();
-			return false;
+		if (auto it = listed.find(index.directory(row)); it != listed.end()) {
+			current[it->second].emplace(index.name(row), row);
 		}
+	}
 
-		if (sqlite3_bind_text(stmt, 3, parent.c_str(), -1, nullptr) != SQLITE_OK) {
-			cleanup();
-			return false;
-		}
+	std::vector<Index::Id> stale{};
+	std::vector<const Entry *> added{};
 
-		if (sqlite3_bind_int64(stmt, 4, static_cast<sqlite3_int64>(size)) != SQLITE_OK) {
-			cleanup();
-			return false;
+	for (std::size_t i = 0; i < listings.size(); ++i) {
+		auto &rows = current[i];
+		for (const auto &file: listings[i].files) {
+			auto it = rows.find(file.name);
+			if (it == rows.end()) {
+				added.push_back(&file);
+				continue;
+			}
+
+			const auto perms = static_cast<std::uint16_t>(file.perms);
+			const auto row = it->second;
+			if (!index.hasMetadata(row) || index.size(row) != file.size || index.perms(row) != perms || index.mtime(row) != file.mtime) {
+				index.update(row, file.size, perms, file.mtime);
+			}
+
+			rows.erase(it);
 		}
 
-		if (sqlite3_bind_int(stmt, 5, static_cast<int>(perms)) != SQLITE_OK) {
-			cleanup();
-			return false;
+		for (const auto &[name, row]: rows) {
+			stale.push_back(row);
 		}
 
-		sqlite3_step(stmt);
-		sqlite3_reset(stmt);
+		index.setDirectoryStamp(listings[i].directory, listings[i].stamp);
 	}
 
-	sqlite3_finalize(stmt);
-	sqlite3_exec(handle, "END TRANSACTION", nullptr, nullptr, nullptr);
+	// NOTE: The name views point into the index, they have to be dropped before the rows get removed or added.
+	current.clear();
 
-	return true;
+	std::sort(stale.begin(), stale.end());
+	index.removeRows(stale);
+
+	for (const auto entry: added) {
+		addEntryInternal(*entry);
+	}
 }
 
-bool Database::removeEntry(const std::string &name, const std::string &path)
+Index::Id Database::getPendingFiles(const Index::Id from, const std::size_t limit, std::vector<std::pair<Index::Id, Entry>> &files, std::uint64_t &layout) const
 {
-	std::lock_guard<std::mutex> lock{mutex};
+	std::shared_lock<std::shared_mutex> lock{mutex};
 
-	sqlite3_stmt *stmt = nullptr;
-	if (sqlite3_prepare(handle, "DELETE FROM files WHERE file = ? AND path = ?;", -1, &stmt, nullptr) != SQLITE_OK) {
-		return false;
+	Index::Id row = index.layoutGeneration() == layout ? from : 0;
+	layout = index.layoutGeneration();
+
+	if (index.pendingMetadata() == 0) {
+		return static_cast<Index::Id>(index.rows());
 	}
 
-	if (sqlite3_bind_text(stmt, 1, name.c_str(), -1, nullptr) != SQLITE_OK) {
-		sqlite3_finalize(stmt);
-		return false;
+	for (; row < index.rows() && files.size() < limit; ++row) {
+		if (index.alive(row) && !index.hasMetadata(row)) {
+			files.emplace_back(row, makeEntry(row));
+		}
 	}
 
-	if (sqlite3_bind_text(stmt, 2, path.c_str(), -1, nullptr) != SQLITE_OK) {
-		sqlite3_finalize(stmt);
+	return row;
+}
+
+bool Database::setMetadata(const std::vector<std::pair<Index::Id, Entry>> &files, const std::uint64_t layout)
+{
+	std::unique_lock<std::shared_mutex> lock{mutex};
+
+	// NOTE: Compaction renumbered the rows in the meantime, they are picked up again by the next pass.
+	if (index.layoutGeneration() != layout) {
 		return false;
 	}
 
-	sqlite3_step(stmt);
-	sqlite3_finalize(stmt);
+	for (const auto &[row, file]: files) {
+		if (index.alive(row) && !index.hasMetadata(row)) {
+			index.update(row, static_cast<std::uint64_t>(file.size), static_cast<std::uint16_t>(file.perms), file.mtime);
+		}
+	}
 
 	return true;
 }
 
-bool Database::removeEntries(const std::string &parent)
+std::size_t Database::getPendingCount() const
 {
-	std::lock_guard<std::mutex> lock{mutex};
+	std::shared_lock<std::shared_mutex> lock{mutex};
+	return index.pendingMetadata();
+}
 
-	sqlite3_exec(handle, "BEGIN TRANSACTION", nullptr, nullptr, nullptr);
+bool Database::loadSnapshot(const std::string &path)
+{
+	stopSearchThread();
 
-	sqlite3_stmt *stmt = nullptr;
-	if (sqlite3_prepare(handle, "DELETE FROM files WHERE parent = ?", -1, &stmt, nullptr) != SQLITE_OK) {
+	std::unique_lock<std::shared_mutex> lock{mutex};
+	if (!Snapshot::load(index, path)) {
 		return false;
 	}
 
-	if (sqlite3_bind_text(stmt, 1, parent.c_str(), -1, nullptr) != SQLITE_OK) {
-		sqlite3_finalize(stmt);
-		return false;
+	queryCache.clear();
+	lastQuery.valid = false;
+	savedGeneration = index.generation();
+	savedMetadataGeneration = index.metadataGeneration();
+	return true;
+}
+
+bool Database::saveSnapshot(const std::string &path) const
+{
+	std::shared_lock<std::shared_mutex> lock{mutex};
+	return Snapshot::save(index, path);
+}
+
+void Database::enableAutosave(const std::string &path, const std::chrono::seconds interval)
+{
+	if (autosaveThread.joinable()) {
+		return;
 	}
 
-	sqlite3_step(stmt);
-	sqlite3_finalize(stmt);
-	sqlite3_exec(handle, "END TRANSACTION", nullptr, nullptr, nullptr);
+	autosavePath = path;
+	autosaveThread = std::thread([this, interval] () {
+		std::unique_lock<std::mutex> lock{autosaveMutex};
+		while (!autosaveCv.wait_for(lock, interval, [this] { return autosaveStopped; })) {
+			lock.unlock();
+			autosave();
+			lock.lock();
+		}
+	});
+}
+
+void Database::autosave()
+{
+	// NOTE: Writers are blocked for as long as the snapshot is being written, readers can carry on.
+	std::shared_lock<std::shared_mutex> lock{mutex};
 
-	return true;
+	const auto generation = index.generation();
+	const auto metadataGeneration = index.metadataGeneration();
+	if (generation == savedGeneration && metadataGeneration == savedMetadataGeneration) {
+		return;
+	}
+
+	if (Snapshot::save(index, autosavePath)) {
+		savedGeneration = generation;
+		savedMetadataGeneration = metadataGeneration;
+	}
 }
 
-bool Database::removeEntriesByPath(const std::string &path)
+bool Database::addEntry(const Entry &entry)
 {
-	std::lock_guard<std::mutex> lock{mutex};
+	std::unique_lock<std::shared_mutex> lock{mutex};
+	return addEntryInternal(entry);
+}
 
-	sqlite3_exec(handle, "BEGIN TRANSACTION", nullptr, nullptr, nullptr);
+bool Database::addEntries(const std::vector<Entry> &entries)
+{
+	std::unique_lock<std::shared_mutex> lock{mutex};
 
-	sqlite3_stmt *stmt = nullptr;
-	if (sqlite3_prepare(handle, "DELETE FROM files WHERE parent = ?", -1, &stmt, nullptr) != SQLITE_OK) {
-		return false;
+	for (auto &&entry: entries) {
+		if (!addEntryInternal(entry)) {
+			return false;
+		}
 	}
 
-	if (sqlite3_bind_text(stmt, 1, path.c_str(), -1, nullptr) != SQLITE_OK) {
-		sqlite3_finalize(stmt);
-		return false;
+	return true;
+}
+
+bool Database::removeEntry(const std::string &name, const std::string &path)
+{
+	std::unique_lock<std::shared_mutex> lock{mutex};
+	return index.remove(name, index.findDirectory(path));
+}
+
+bool Database::removeEntries(const std::string &parent)
+{
+	std::unique_lock<std::shared_mutex> lock{mutex};
+
+	if (const auto root = index.findRoot(parent); root != Index::InvalidId) {
+		index.removeByRoot(root);
 	}
 
-	sqlite3_step(stmt);
-	sqlite3_finalize(stmt);
-	sqlite3_exec(handle, "END TRANSACTION", nullptr, nullptr, nullptr);
+	return true;
+}
 
+bool Database::removeEntriesByPath(const std::string &path)
+{
+	std::unique_lock<std::shared_mutex> lock{mutex};
+	index.removeByDirectory(index.findDirectory(path));
 	return true;
 }
 
-void Database::query(const std::string &pattern, const bool regexp, QueryCallback callback, QueryDoneCallback doneCallback/* = {} */)
+void Database::query(const std::string &pattern, const QueryOptions &options, QueryCallback callback, QueryDoneCallback doneCallback/* = {} */)
 {
-	if (regexp) {
-		queryRegexp(pattern, callback, doneCallback);
-	} else {
-		queryLike(pattern, callback, doneCallback);
-	}
+	queryInternal(pattern, options, callback, doneCallback);
 }
 
 void Database::queryLike(const std::string &pattern, const QueryCallback &callback, const QueryDoneCallback &doneCallback)
 {
-	queryInternal("SELECT file, path, parent, size, perms FROM files WHERE file LIKE ?;", "%" + pattern + "%", callback, doneCallback);
+	queryInternal(pattern, {}, callback, doneCallback);
 }
 
 void Database::queryRegexp(const std::string &pattern, const QueryCallback &callback, const QueryDoneCallback &doneCallback)
 {
-	queryInternal("SELECT file, path, parent, size, perms FROM files WHERE file REGEXP(?);", pattern, callback, doneCallback);
+	QueryOptions options{};
+	options.regexp = true;
+
+	queryInternal(pattern, options, callback, doneCallback);
+}
+
+void Database::queryPinned(const QueryOptions &options, QueryCallback callback, QueryDoneCallback doneCallback/* = {} */)
+{
+	queryInternal({}, options, callback, doneCallback, true);
 }
 
-void Database::queryInternal(const std::string &query, const std::string &pattern, const QueryCallback &callback, const QueryDoneCallback &doneCallback)
+void Database::queryInternal(const std::string &pattern, const QueryOptions &options, const QueryCallback &callback, const QueryDoneCallback &doneCallback, const bool pinned/* = false */)
 {
 	static std::atomic<std::size_t> QueryIndex = 0;
 	++QueryIndex;
@@ -274,43 +435,390 @@ void Database::queryInternal(const std::string &query, const std::string &patter
 	stopSearchThread();
 
 	searchStopped = false;
-	searchThread = std::thread([this, query, pattern, callback, doneCallback] () {
-		sqlite3_stmt *stmt = nullptr;
-		if (sqlite3_prepare(handle, query.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
-			fprintf(stderr, "[Error] Failed to prepare query statement: %s.\n", sqlite3_errmsg(handle));
+	searchThread = std::thread([this, pattern, options, callback, doneCallback, pinned] () {
+		const auto queryIndex = QueryIndex.load();
+		const auto regexp = options.regexp;
+		const auto windowBegin = options.offset;
+		const auto windowEnd = options.offset + std::min(options.limit, std::numeric_limits<std::size_t>::max() - options.offset);
+
+		// NOTE: A query that is just a substring keeps going through the substring paths, which can refine the previous results.
+		Query query{};
+		const auto valid = !pinned && (regexp || query.parse(pattern));
+		const auto substring = !regexp && valid && query.isSubstring();
+
+		if (!regexp && !substring && valid && query.usesMetadata()) {
+			fetchMetadata(query);
+		}
+
+		std::shared_lock<std::shared_mutex> lock{mutex};
+
+		/*
+			NOTE: Only the rows that fall into the requested window are turned into entries, everything else is just counted.
+			Those shown before the scanner got to their metadata are stat'ed once the lock is released, along with the
+			rows after them so that the order is kept.
+		*/
+		std::size_t seen = 0;
+		std::vector<std::pair<Entry, std::filesystem::path>> deferred{};
+		auto report = [this, &callback, &options, &seen, &deferred, queryIndex, windowBegin, windowEnd] (const std::vector<Index::Id> &rows) {
+			const auto first = seen;
+			seen += rows.size();
+
+			if (options.countOnly || seen <= windowBegin || first >= windowEnd) {
+				return !searchStopped;
+			}
+
+			const auto begin = windowBegin > first ? windowBegin - first : 0;
+			const auto end = std::min(rows.size(), windowEnd - first);
+			for (auto i = begin; i < end; ++i) {
+				if (searchStopped) {
+					return false;
+				}
+
+				// NOTE: Only the rows of a pinned result set can have been removed since, they keep their place and are skipped.
+				if (rows[i] == Index::InvalidId || !index.alive(rows[i])) {
+					continue;
+				}
+
+				auto entry = makeEntry(rows[i]);
+				entry.path = index.directoryPath(entry.directory);
+
+				if (!entry.metadata || !deferred.empty()) {
+					auto path = entry.metadata ? std::filesystem::path{} : std::filesystem::path{entry.path} / entry.name;
+					deferred.emplace_back(std::move(entry), std::move(path));
+					continue;
+				}
+
+				callback(queryIndex, entry);
+			}
+
+			return true;
+		};
+
+		std::vector<Index::Id> rows{};
+		auto collect = [&report, &rows] (const std::vector<Index::Id> &partition) {
+			rows.insert(rows.end(), partition.begin(), partition.end());
+			return report(partition);
+		};
+
+		QueryCache::Key key{pattern, QueryCache::Mode::Query};
+		if (regexp) {
+			key.mode = QueryCache::Mode::Regexp;
+		} else if (substring) {
+			key = {query.substring(), QueryCache::Mode::Substring};
+		}
+
+		const auto metadata = !regexp && !substring && valid && query.usesMetadata() ? index.metadataGeneration() : 0;
+		const QueryCache::Stamp stamp{index.layoutGeneration(), index.rootGenerations(), metadata};
+		if (pinned) {
+			report(index.pinned());
+		} else if (!valid) {
+			// NOTE: Like with regexps, a query that is still being typed just yields an empty result set.
+		} else if (queryCache.find(key, stamp, rows)) {
+			report(rows);
+		} else {
+			if (regexp) {
+				queryRegexpInternal(pattern, collect);
+			} else if (substring) {
+				queryLikeInternal(key.pattern, collect);
+			} else {
+				queryStructuredInternal(query, collect);
+			}
+
+			if (!searchStopped) {
+				queryCache.insert(key, stamp, rows);
+			}
+		}
+
+		// NOTE: The search thread is the only one to touch the pinned rows outside of the exclusive lock.
+		if (options.pin && !pinned) {
+			index.pin(!searchStopped ? rows : std::vector<Index::Id>{});
+		}
+
+		if (substring) {
+			lastQuery.valid = !searchStopped;
+			if (lastQuery.valid) {
+				lastQuery.needle = std::move(key.pattern);
+				lastQuery.generation = index.generation();
+				lastQuery.rows = std::move(rows);
+			}
+		}
+
+		lock.unlock();
+
+		for (auto &[entry, path]: deferred) {
+			if (searchStopped) {
+				break;
+			}
+
+			if (!entry.metadata) {
+				readMetadata(path, entry);
+			}
+
+			callback(queryIndex, entry);
+		}
+
+		if (doneCallback) {
+			doneCallback(seen);
+		}
+	});
+}
+
+void Database::queryLikeInternal(const std::string &needle, const PartitionResult &result)
+{
+	/*
+		NOTE: The previous results are checked on a single thread, they are only worth refining while they are no
+		more than a partition or fewer than the candidates the trigram index would have to verify.
+	*/
+	const auto refinable = lastQuery.valid && lastQuery.generation == index.generation() && needle.find(lastQuery.needle) != std::string::npos;
+	if (refinable && (lastQuery.rows.size() <= PartitionSize || (index.isSelective(needle) && lastQuery.rows.size() < index.estimate(needle)))) {
+		std::vector<Index::Id> rows{};
+		for (const auto row: lastQuery.rows) {
+			if (searchStopped) {
+				return;
+			}
+
+			if (index.foldedName(row).find(needle) != std::string_view::npos) {
+				rows.push_back(row);
+			}
+		}
+
+		result(rows);
+		return;
+	}
+
+	// NOTE: A needle common enough to match a large share of the rows is faster to find by scanning them on every core.
+	std::vector<Index::Id> rows{};
+	if (index.isSelective(needle) && index.findIndexed(needle, rows)) {
+		result(rows);
+		return;
+	}
+
+	scanPartitioned([this, &needle] (const Index::Id begin, const Index::Id end, std::vector<Index::Id> &out) {
+		index.find(needle, begin, end, out);
+	}, result);
+}
+
+void Database::queryStructuredInternal(Query &query, const PartitionResult &result)
+{
+	query.prepare(index);
+
+	std::vector<Index::Id> candidates{};
+	if (query.candidates(index, candidates)) {
+		std::vector<Index::Id> rows{};
+		query.filter(index, candidates, rows);
+		result(rows);
+		return;
+	}
+
+	scanPartitioned([this, &query] (const Index::Id begin, const Index::Id end, std::vector<Index::Id> &out) {
+		query.scan(index, begin, end, out);
+	}, result);
+}
+
+void Database::fetchMetadata(Query &query)
+{
+	std::vector<std::pair<Index::Id, Entry>> files{};
+	std::vector<std::filesystem::path> paths{};
+	std::uint64_t layout = 0;
+
+	{
+		std::shared_lock<std::shared_mutex> lock{mutex};
+		if (index.pendingMetadata() == 0) {
+			return;
+		}
+
+		// NOTE: A dry run of the query finds the rows the size and perm filters get to, the cheaper operands run first.
+		std::mutex pendingMutex{};
+		std::vector<Index::Id> pending{};
+		query.setMetadataResolver([&pendingMutex, &pending] (const Index::Id row, std::uint64_t &, std::uint16_t &) {
+			std::lock_guard<std::mutex> lock{pendingMutex};
+			pending.push_back(row);
+			return false;
+		});
+
+		queryStructuredInternal(query, [this] (const std::vector<Index::Id> &) {
+			return !searchStopped;
+		});
+
+		query.setMetadataResolver({});
+		if (searchStopped) {
 			return;
 		}
 
-		if (sqlite3_bind_text(stmt, 1, pattern.c_str(), -1, nullptr) != SQLITE_OK) {
-			fprintf(stderr, "[Error] Failed to bind query parameter: %s\n", sqlite3_errmsg(handle));
-			sqlite3_finalize(stmt);
+		std::sort(pending.begin(), pending.end());
+		pending.erase(std::unique(pending.begin(), pending.end()), pending.end());
+
+		layout = index.layoutGeneration();
+		files.reserve(pending.size());
+		paths.reserve(pending.size());
+
+		for (const auto row: pending) {
+			files.emplace_back(row, makeEntry(row));
+			paths.push_back(makePath(row));
+		}
+	}
+
+	// NOTE: The files are stat'ed without the lock, so that neither the scanner nor the metadata pass wait on them.
+	std::vector<std::pair<Index::Id, Entry>> read{};
+	for (std::size_t i = 0; i < files.size(); ++i) {
+		if (searchStopped) {
 			return;
 		}
 
-		int result = SQLITE_OK;
-		while ((result = sqlite3_step(stmt)) != SQLITE_DONE && !searchStopped) {
-			if (result != SQLITE_ROW) {
-				fprintf(stderr, "[Error] Failed to fetch a query result: %s\n", sqlite3_errmsg(handle));
-				sqlite3_finalize(stmt);
+		if (readMetadata(paths[i], files[i].second)) {
+			read.push_back(std::move(files[i]));
+		}
+	}
+
+	if (!read.empty()) {
+		setMetadata(read, layout);
+	}
+}
+
+void Database::queryRegexpInternal(const std::string &pattern, const PartitionResult &result)
+{
+	Regex regex{};
+	if (regex.compile(pattern)) {
+		queryRegexpCompiled(regex, result);
+		return;
+	}
+
+	std::regex expression{};
+	try {
+		expression = std::regex(pattern);
+	} catch (const std::regex_error &) {
+		// NOTE: Most commonly, a regex error will occur when someone types unfinished expression, just yield empty result set in that case.
+		return;
+	}
+
+	scanPartitioned([this, &expression] (const Index::Id begin, const Index::Id end, std::vector<Index::Id> &out) {
+		for (auto row = begin; row < end; ++row) {
+			if (!index.alive(row)) {
+				continue;
+			}
+
+			const auto name = index.name(row);
+			if (std::regex_search(name.begin(), name.end(), expression)) {
+				out.push_back(row);
+			}
+		}
+	}, result);
+}
+
+void Database::queryRegexpCompiled(const Regex &regex, const PartitionResult &result)
+{
+	/*
+		Every match has to contain the required literal, so the substring indexes narrow the rows down before the
+		automaton runs. The literal is matched case-insensitively there, the regex itself stays case-sensitive.
+	*/
+	const auto &literal = regex.literal();
+
+	std::string needle(literal.size(), '\0');
+	FoldCase(literal.data(), literal.data() + literal.size(), needle.data());
+
+	auto verify = [this, &regex] (const std::vector<Index::Id> &candidates, std::vector<Index::Id> &out) {
+		Regex::Matcher matcher{regex};
+		for (const auto row: candidates) {
+			if (searchStopped) {
 				return;
 			}
 
-			Entry entry{};
-			auto &[file, path, parent, size, perms] = entry;
-			file = std::string(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0)));
-			path = std::string(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1)));
-			parent = std::string(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 2)));
-			size = static_cast<std::uintmax_t>(sqlite3_column_int64(stmt, 3));
-			perms = static_cast<std::filesystem::perms>(sqlite3_column_int(stmt, 4));
+			if (matcher.search(index.name(row))) {
+				out.push_back(row);
+			}
+		}
+	};
 
-			callback(QueryIndex, entry);
+	std::vector<Index::Id> candidates{};
+	if (!needle.empty() && index.isSelective(needle) && index.findIndexed(needle, candidates)) {
+		std::vector<Index::Id> rows{};
+		verify(candidates, rows);
+		result(rows);
+		return;
+	}
+
+	scanPartitioned([this, &regex, &needle, &verify] (const Index::Id begin, const Index::Id end, std::vector<Index::Id> &out) {
+		if (!needle.empty()) {
+			std::vector<Index::Id> candidates{};
+			index.find(needle, begin, end, candidates);
+			verify(candidates, out);
+			return;
 		}
 
-		sqlite3_finalize(stmt);
+		Regex::Matcher matcher{regex};
+		for (auto row = begin; row < end; ++row) {
+			if (index.alive(row) && matcher.search(index.name(row))) {
+				out.push_back(row);
+			}
+		}
+	}, result);
+}
 
-		if (doneCallback) {
-			doneCallback();
+void Database::scanPartitioned(const PartitionScan &scan, const PartitionResult &result)
+{
+	/*
+		The rows are split into fixed size partitions which the search pool workers claim in order, so the early
+		partitions finish first and their results can be reported while the rest of the table is still being scanned.
+	*/
+	const auto rows = static_cast<Index::Id>(index.rows());
+	const std::size_t partitions = (rows + PartitionSize - 1) / PartitionSize;
+	if (partitions == 0) {
+		return;
+	}
+
+	std::vector<std::vector<Index::Id>> results(partitions);
+	std::vector<bool> ready(partitions, false);
+	std::atomic<std::size_t> next = 0;
+
+	std::mutex partitionMutex{};
+	std::condition_variable partitionCv{};
+
+	const auto workers = std::min(searchPool.size(), partitions);
+	std::size_t activeWorkers = workers;
+
+	for (std::size_t i = 0; i < workers; ++i) {
+		searchPool.submit([&] () {
+			std::size_t partition = 0;
+			while (!searchStopped && (partition = next++) < partitions) {
+				const auto begin = static_cast<Index::Id>(partition * PartitionSize);
+				const auto end = std::min(rows, static_cast<Index::Id>(begin + PartitionSize));
+				scan(begin, end, results[partition]);
+
+				std::lock_guard<std::mutex> lock{partitionMutex};
+				ready[partition] = true;
+				partitionCv.notify_all();
+			}
+
+			std::lock_guard<std::mutex> lock{partitionMutex};
+			--activeWorkers;
+			partitionCv.notify_all();
+		});
+	}
+
+	for (std::size_t partition = 0; partition < partitions; ++partition) {
+		{
+			std::unique_lock<std::mutex> lock{partitionMutex};
+			partitionCv.wait(lock, [&] {
+				return ready[partition] || activeWorkers == 0;
+			});
+
+			if (!ready[partition]) {
+				break;
+			}
+		}
+
+		if (!result(results[partition])) {
+			searchStopped = true;
+			break;
 		}
+
+		results[partition] = {};
+	}
+
+	// NOTE: The workers reference the state on this stack frame, wait for all of them before returning.
+	std::unique_lock<std::mutex> lock{partitionMutex};
+	partitionCv.wait(lock, [&] {
+		return activeWorkers == 0;
 	});
 }
 
@@ -322,3 +830,46 @@ void Database::stopSearchThread()
 		searchThread.join();
 	}
 }
+
+bool Database::addEntryInternal(const Entry &entry)
+{
+	if (entry.name.empty() || entry.directory == Index::InvalidId || entry.root == Index::InvalidId) {
+		return false;
+	}
+
+	index.add(entry.name, entry.directory, entry.root, static_cast<std::uint64_t>(entry.size), static_cast<std::uint16_t>(entry.perms), entry.mtime, entry.metadata);
+	return true;
+}
+
+Database::Entry Database::makeEntry(const Index::Id row) const
+{
+	return {
+		std::string{index.name(row)},
+		index.directory(row),
+		index.root(row),
+		static_cast<std::uintmax_t>(index.size(row)),
+		static_cast<std::filesystem::perms>(index.perms(row)),
+		index.type(row),
+		index.mtime(row),
+		index.hasMetadata(row),
+	};
+}
+
+std::filesystem::path Database::makePath(const Index::Id row) const
+{
+	return std::filesystem::path{index.directoryPath(index.directory(row))} / index.name(row);
+}
+
+bool Database::readMetadata(const std::filesystem::path &path, Entry &entry)
+{
+	DirectoryReader::Entry file{};
+	if (!ReadMetadata(path, file)) {
+		return false;
+	}
+
+	entry.size = static_cast<std::uintmax_t>(file.size);
+	entry.perms = file.perms;
+	entry.mtime = file.mtime;
+	entry.metadata = true;
+	return true;
+}
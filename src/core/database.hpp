@@ -19,23 +19,86 @@
 #define NOTHING_DATABASE_HPP
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <filesystem>
 #include <functional>
+#include <limits>
 #include <mutex>
+#include <shared_mutex>
 #include <string>
 #include <thread>
-#include <tuple>
 #include <vector>
 
-#include <sqlite3.h>
+#include "index.hpp"
+#include "query.hpp"
+#include "querycache.hpp"
+#include "regex.hpp"
+#include "threadpool.hpp"
 
 class Database
 {
 	public:
-		using Entry = std::tuple<std::string, std::string, std::string, std::uintmax_t, std::filesystem::perms>;
+		struct Entry
+		{
+			std::string name{};
+			Index::Id directory = Index::InvalidId;
+			Index::Id root = Index::InvalidId;
+			std::uintmax_t size = 0;
+			std::filesystem::perms perms = std::filesystem::perms::unknown;
+			FileType type = FileType::Generic;
+			// Nanoseconds since the Unix epoch.
+			std::uint64_t mtime = 0;
+			// Entries added without metadata are indexed by name right away, the scanner fills the rest in later.
+			bool metadata = true;
+			// The path of the folder, only filled in for the matches reported by a query so that callers need not look it up.
+			std::string path{};
+		};
+
+		struct QueryOptions
+		{
+			bool regexp = false;
+			// Only the matches in the [offset, offset + limit) window are reported, the rest is just counted.
+			std::size_t offset = 0;
+			std::size_t limit = std::numeric_limits<std::size_t>::max();
+			// Skips reporting the matches altogether, only the total count is passed to the done callback.
+			bool countOnly = false;
+			// Keeps the matches, so that the following windows are read from them with queryPinned() in the same order.
+			bool pin = false;
+		};
+
+		struct Directory
+		{
+			Index::Id id = Index::InvalidId;
+			Index::Id parent = Index::InvalidId;
+			std::string path{};
+			std::uint64_t stamp = 0;
+		};
+
+		// The files of a directory as found on disk, along with the stamp the directory had when it was listed.
+		struct Listing
+		{
+			Index::Id directory = Index::InvalidId;
+			std::uint64_t stamp = 0;
+			std::vector<Entry> files{};
+		};
+
+		// A directory to intern, its parent is either an id of the index or another directory interned by the same call.
+		struct NewDirectory
+		{
+			Index::Id parent = Index::InvalidId;
+			// The position of the parent in the list, if it is interned by the same call it has to come first.
+			std::size_t parentIndex = NoParentIndex;
+			std::string name{};
+
+			static constexpr std::size_t NoParentIndex = ~std::size_t{0};
+		};
+
+		// Query results are reported from the search thread in index order, even though the index is scanned in parallel.
 		using QueryCallback = std::function<void(const std::size_t, const Entry &)>;
-		using QueryDoneCallback = std::function<void()>;
+		// Receives the total number of matches, including the ones outside of the requested window.
+		using QueryDoneCallback = std::function<void(const std::size_t)>;
 
 		Database();
 		~Database();
@@ -46,6 +109,61 @@ class Database
 		Database &operator =(const Database &) = delete;
 		Database &operator =(Database &&) = delete;
 
+		Index::Id internRoot(const std::string &path);
+		Index::Id internDirectory(const std::string &path);
+		Index::Id internDirectory(const Index::Id parent, const std::string &name);
+		// Interns the directories in order under a single lock and returns their ids.
+		std::vector<Index::Id> internDirectories(const std::vector<NewDirectory> &directories);
+
+		std::string getPath(const Index::Id directory) const;
+		std::string getRootPath(const Index::Id root) const;
+		// Returns the path of every root that has not been retired, whether it holds any rows or not.
+		std::vector<std::string> getRootPaths() const;
+
+		bool isRootComplete(const std::string &path) const;
+		void setRootComplete(const Index::Id root, const bool complete);
+		// The root a directory lies in, or InvalidId if it is not in any.
+		Index::Id getRootOwner(const Index::Id directory) const;
+
+		/*
+			Hands the rows of the complete roots among the given ones over to a root they lie in and drops the rows of
+			the others, which have to be scanned again. Returns the roots that were handed over.
+		*/
+		std::vector<std::string> mergeRoots(const Index::Id root, const std::vector<std::string> &children);
+
+		// Returns every directory of a root that has been listed before, parents come before their children.
+		std::vector<Directory> getListedDirectories(const Index::Id root) const;
+		void setDirectoryStamps(const std::vector<std::pair<Index::Id, std::uint64_t>> &stamps);
+
+		// Records directories that are the same folder as another one, see Index::directoryAlias().
+		void setDirectoryAliases(const std::vector<std::pair<Index::Id, Index::Id>> &aliases);
+		// Returns the path of every alias along with the path of the folder it aliases.
+		std::vector<std::pair<std::string, std::string>> getAliases() const;
+
+		/*
+			Applies the changes found by a reconciliation pass: the files of every listed directory are replaced by
+			the listing (rows that did not change are kept as they are) and the removed directories are dropped along
+			with their subtrees.
+		*/
+		void reconcile(const std::vector<Listing> &listings, const std::vector<Index::Id> &removedDirectories);
+
+		/*
+			Collects up to limit files still waiting for their metadata, starting at the given row, and returns the
+			row to continue from. The rows are only valid at the layout generation returned through the last argument,
+			if the rows were renumbered since the one passed in the collection starts over from the first row and
+			setMetadata() drops files collected at an older layout.
+		*/
+		Index::Id getPendingFiles(const Index::Id from, const std::size_t limit, std::vector<std::pair<Index::Id, Entry>> &files, std::uint64_t &layout) const;
+		bool setMetadata(const std::vector<std::pair<Index::Id, Entry>> &files, const std::uint64_t layout);
+		std::size_t getPendingCount() const;
+
+		// Loading a snapshot replaces the whole index, see the Snapshot class for the format.
+		bool loadSnapshot(const std::string &path);
+		bool saveSnapshot(const std::string &path) const;
+
+		// Writes a snapshot to the given path every interval if the index has changed since the last one, and once more on destruction.
+		void enableAutosave(const std::string &path, const std::chrono::seconds interval);
+
 		bool addEntry(const Entry &entry);
 		bool addEntries(const std::vector<Entry> &entries);
 
@@ -53,19 +171,65 @@ class Database
 		bool removeEntries(const std::string &parent);
 		bool removeEntriesByPath(const std::string &path);
 
-		void query(const std::string &pattern, const bool regexp, QueryCallback callback, QueryDoneCallback doneCallback = {});
+		void query(const std::string &pattern, const QueryOptions &options, QueryCallback callback, QueryDoneCallback doneCallback = {});
 		void queryLike(const std::string &pattern, const QueryCallback &callback, const QueryDoneCallback &doneCallback);
 		void queryRegexp(const std::string &pattern, const QueryCallback &callback, const QueryDoneCallback &doneCallback);
+		// Reports a window of the matches kept by the last query run with the pin option, even if the index has changed since.
+		void queryPinned(const QueryOptions &options, QueryCallback callback, QueryDoneCallback doneCallback = {});
 
 		void stopSearchThread();
 
 	private:
-		sqlite3 *handle = nullptr;
-		std::mutex mutex{};
+		Index index{};
+		mutable std::shared_mutex mutex{};
 		std::thread searchThread{};
 		std::atomic<bool> searchStopped = false;
-
-		void queryInternal(const std::string &query, const std::string &pattern, const QueryCallback &callback, const QueryDoneCallback &doneCallback);
+		ThreadPool searchPool{};
+
+		/*
+			The matches of the last completed substring search. When the next pattern contains the previous one,
+			its results are a subset of these rows, so only they have to be checked again.
+		*/
+		struct {
+			std::string needle{};
+			std::uint64_t generation = 0;
+			std::vector<Index::Id> rows{};
+			bool valid = false;
+		} lastQuery;
+
+		QueryCache queryCache;
+
+		std::string autosavePath{};
+		std::thread autosaveThread{};
+		std::mutex autosaveMutex{};
+		std::condition_variable autosaveCv{};
+		bool autosaveStopped = false;
+		std::atomic<std::uint64_t> savedGeneration = 0;
+		std::atomic<std::uint64_t> savedMetadataGeneration = 0;
+
+		void autosave();
+
+		// The number of rows a search pool worker scans at once, see scanPartitioned().
+		static constexpr Index::Id PartitionSize = 64 * 1024;
+
+		using PartitionScan = std::function<void(const Index::Id, const Index::Id, std::vector<Index::Id> &)>;
+		using PartitionResult = std::function<bool(const std::vector<Index::Id> &)>;
+
+		void scanPartitioned(const PartitionScan &scan, const PartitionResult &result);
+		void queryLikeInternal(const std::string &needle, const PartitionResult &result);
+		void queryStructuredInternal(Query &query, const PartitionResult &result);
+		void queryRegexpInternal(const std::string &pattern, const PartitionResult &result);
+		void queryRegexpCompiled(const Regex &regex, const PartitionResult &result);
+
+		void queryInternal(const std::string &pattern, const QueryOptions &options, const QueryCallback &callback, const QueryDoneCallback &doneCallback, const bool pinned = false);
+
+		bool addEntryInternal(const Entry &entry);
+		Entry makeEntry(const Index::Id row) const;
+		std::filesystem::path makePath(const Index::Id row) const;
+		// Reads the metadata of a file from disk without storing it, for rows the scanner has not gotten to yet. Never called with the lock held.
+		static bool readMetadata(const std::filesystem::path &path, Entry &entry);
+		// Stats the files without metadata that the size and perm filters of the query get to, and stores what was read.
+		void fetchMetadata(Query &query);
 };
 
 #endif
@@ -0,0 +1,157 @@
+/*
+	Copyright (c) 2019 Kamil Chojnowski Y29udGFjdEBkaWF0aC5uZXQ=
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in the
+	Software without restriction, including without limitation the rights to use,
+	copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+	THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <filesystem>
+
+#include "directories.hpp"
+
+namespace {
+
+inline bool IsSeparator(const char ch)
+{
+	return ch == '/' || ch == static_cast<char>(std::filesystem::path::preferred_separator);
+}
+
+/*
+	Splits a path into its components. An absolute POSIX path yields an empty first component standing in for
+	the filesystem root, empty components caused by repeated or trailing separators are skipped.
+*/
+template <typename Callback>
+bool SplitPath(const std::string_view path, Callback &&callback)
+{
+	std::size_t start = 0;
+	bool first = true;
+
+	for (std::size_t i = 0; i <= path.size(); ++i) {
+		if (i != path.size() && !IsSeparator(path[i])) {
+			continue;
+		}
+
+		const auto component = path.substr(start, i - start);
+		if (!component.empty() || first) {
+			if (!callback(component)) {
+				return false;
+			}
+		}
+
+		first = false;
+		start = i + 1;
+	}
+
+	return true;
+}
+
+} // namespace <anonymous>
+
+Directories::Id Directories::intern(const Id parent, const std::string_view name)
+{
+	if (auto it = lookup.find({parent, name}); it != lookup.end()) {
+		return it->second;
+	}
+
+	const auto id = static_cast<Id>(parents.size());
+	parents.push_back(parent);
+	names.emplace_back(name);
+	lookup.emplace(Key{parent, names.back()}, id);
+	return id;
+}
+
+Directories::Id Directories::intern(const std::string_view path)
+{
+	Id id = InvalidId;
+	SplitPath(path, [this, &id] (const std::string_view component) {
+		id = intern(id, component);
+		return true;
+	});
+
+	return id;
+}
+
+Directories::Id Directories::find(const Id parent, const std::string_view name) const
+{
+	if (auto it = lookup.find({parent, name}); it != lookup.end()) {
+		return it->second;
+	}
+
+	return InvalidId;
+}
+
+Directories::Id Directories::find(const std::string_view path) const
+{
+	Id id = InvalidId;
+	const auto found = SplitPath(path, [this, &id] (const std::string_view component) {
+		id = find(id, component);
+		return id != InvalidId;
+	});
+
+	return found ? id : InvalidId;
+}
+
+std::string Directories::path(const Id id) const
+{
+	if (id == InvalidId) {
+		return {};
+	}
+
+	std::vector<Id> chain{};
+	for (auto current = id; current != InvalidId; current = parents[current]) {
+		chain.push_back(current);
+	}
+
+	std::string result{};
+	for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+		if (it != chain.rbegin()) {
+			result += '/';
+		}
+
+		result += names[*it];
+	}
+
+	// NOTE: The filesystem root is stored as an empty component, make sure it does not collapse to an empty path.
+	if (result.empty()) {
+		result = "/";
+	}
+
+	return result;
+}
+
+std::vector<bool> Directories::subtree(const std::vector<Id> &ids) const
+{
+	std::vector<bool> mask(parents.size(), false);
+
+	Id first = InvalidId;
+	for (const auto id: ids) {
+		if (id != InvalidId && id < parents.size()) {
+			mask[id] = true;
+			first = std::min(first, id);
+		}
+	}
+
+	if (first == InvalidId) {
+		return mask;
+	}
+
+	for (auto current = first + 1; current < parents.size(); ++current) {
+		const auto parent = parents[current];
+		if (parent != InvalidId && mask[parent]) {
+			mask[current] = true;
+		}
+	}
+
+	return mask;
+}
@@ -0,0 +1,92 @@
+/*
+	Copyright (c) 2019 Kamil Chojnowski Y29udGFjdEBkaWF0aC5uZXQ=
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in the
+	Software without restriction, including without limitation the rights to use,
+	copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+	THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef NOTHING_DIRECTORIES_HPP
+#define NOTHING_DIRECTORIES_HPP
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/*
+	Interned directory table.
+
+	Every directory is stored once as a (parent id, component name) pair, so files only need to carry a 32-bit
+	directory id and full paths are rebuilt on demand. Ids are never reused, a parent always has a lower id than
+	its children, which lets subtree walks run as a single forward pass.
+*/
+class Directories
+{
+	public:
+		using Id = std::uint32_t;
+
+		static constexpr Id InvalidId = ~Id{0};
+
+		Directories() = default;
+
+		Directories(const Directories &) = delete;
+		Directories(Directories &&) = delete;
+
+		Directories &operator =(const Directories &) = delete;
+		Directories &operator =(Directories &&) = delete;
+
+		Id intern(const Id parent, const std::string_view name);
+		Id intern(const std::string_view path);
+
+		Id find(const Id parent, const std::string_view name) const;
+		Id find(const std::string_view path) const;
+
+		Id parent(const Id id) const { return parents[id]; }
+		const std::string &name(const Id id) const { return names[id]; }
+		std::string path(const Id id) const;
+
+		std::size_t size() const { return parents.size(); }
+
+		// Returns a mask with every directory in the subtrees rooted at the given ids (inclusive) set.
+		std::vector<bool> subtree(const Id id) const { return subtree(std::vector<Id>{id}); }
+		std::vector<bool> subtree(const std::vector<Id> &ids) const;
+
+	private:
+		friend class Snapshot;
+
+		struct Key
+		{
+			Id parent;
+			std::string_view name;
+
+			bool operator ==(const Key &other) const {
+				return parent == other.parent && name == other.name;
+			}
+		};
+
+		struct KeyHash
+		{
+			std::size_t operator ()(const Key &key) const {
+				return std::hash<std::string_view>{}(key.name) ^ (static_cast<std::size_t>(key.parent) * 0x9E3779B97F4A7C15ull);
+			}
+		};
+
+		std::vector<Id> parents{};
+		// NOTE: A deque does not relocate its elements when growing, so the lookup keys can safely view into it.
+		std::deque<std::string> names{};
+		std::unordered_map<Key, Id, KeyHash> lookup{};
+};
+
+#endif // NOTHING_DIRECTORIES_HPP
@@ -0,0 +1,711 @@
+/*
+	Copyright (c) 2019 Kamil Chojnowski Y29udGFjdEBkaWF0aC5uZXQ=
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in the
+	Software without restriction, including without limitation the rights to use,
+	copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+	THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+
+#if defined(PLATFORM_LINUX)
+	#include <dirent.h>
+	#include <fcntl.h>
+	#include <sys/stat.h>
+	#include <sys/syscall.h>
+	#include <unistd.h>
+#endif
+
+#if defined(PLATFORM_LINUX) && defined(WITH_IO_URING)
+	#include <cstdio>
+	#include <cstring>
+	#include <vector>
+
+	#include <linux/io_uring.h>
+	#include <sys/mman.h>
+	#include <sys/statfs.h>
+	#include <sys/sysmacros.h>
+#endif
+
+#include "directoryreader.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+#if defined(PLATFORM_LINUX)
+constexpr unsigned StatMask = STATX_TYPE | STATX_MODE | STATX_SIZE | STATX_MTIME;
+
+// Entries are stat'ed this many at a time, which is also the depth of the io_uring.
+constexpr std::size_t ChunkSize = 128;
+
+struct Slot
+{
+	const char *name = nullptr;
+	unsigned char type = DT_UNKNOWN;
+	// Whether the entry gets stat'ed at all.
+	bool stat = false;
+	// Zero or the errno of the stat.
+	int result = 0;
+	struct statx info{};
+};
+
+std::uint64_t Stamp(const struct stat &info)
+{
+	const auto mtime = static_cast<std::uint64_t>(info.st_mtim.tv_sec) * 1000000000ull + static_cast<std::uint64_t>(info.st_mtim.tv_nsec);
+	const auto ctime = static_cast<std::uint64_t>(info.st_ctim.tv_sec) * 1000000000ull + static_cast<std::uint64_t>(info.st_ctim.tv_nsec);
+	return std::max<std::uint64_t>(std::max(mtime, ctime), 1);
+}
+
+// Only symlinks are followed, for everything else not following saves resolving the name twice.
+inline int StatFlags(const bool follow)
+{
+	return AT_STATX_DONT_SYNC | (follow ? 0 : AT_SYMLINK_NOFOLLOW);
+}
+
+// Returns zero or the errno, only the type, mode, size and mtime are filled in.
+int Stat(const int fd, const char *name, const bool follow, struct statx &info)
+{
+	if (statx(fd, name, StatFlags(follow), StatMask, &info) == 0) {
+		return 0;
+	}
+
+	// NOTE: Kernels older than 4.11 do not have statx().
+	if (errno != ENOSYS) {
+		return errno;
+	}
+
+	struct stat fallback{};
+	if (fstatat(fd, name, &fallback, follow ? 0 : AT_SYMLINK_NOFOLLOW) == -1) {
+		return errno;
+	}
+
+	info.stx_mode = static_cast<std::uint16_t>(fallback.st_mode);
+	info.stx_size = static_cast<std::uint64_t>(fallback.st_size);
+	info.stx_mtime.tv_sec = fallback.st_mtim.tv_sec;
+	info.stx_mtime.tv_nsec = static_cast<std::uint32_t>(fallback.st_mtim.tv_nsec);
+	return 0;
+}
+
+void SetMetadata(const struct statx &info, DirectoryReader::Entry &entry)
+{
+	entry.directory = S_ISDIR(info.stx_mode);
+	entry.metadata = true;
+
+	if (!entry.directory) {
+		entry.size = info.stx_size;
+		entry.perms = static_cast<fs::perms>(info.stx_mode & 07777);
+		entry.mtime = static_cast<std::uint64_t>(info.stx_mtime.tv_sec) * 1000000000ull + info.stx_mtime.tv_nsec;
+	}
+}
+#else
+std::uint64_t UnixTime(const fs::file_time_type time)
+{
+	// NOTE: The file clock has no portable epoch in C++17, the time is shifted by the current offset between both clocks instead.
+	const auto system = time - fs::file_time_type::clock::now() + std::chrono::system_clock::now();
+	const auto count = std::chrono::duration_cast<std::chrono::nanoseconds>(system.time_since_epoch()).count();
+	return count > 0 ? static_cast<std::uint64_t>(count) : 0;
+}
+#endif
+
+#if defined(PLATFORM_LINUX) && defined(WITH_IO_URING)
+/*
+	Whether the entries of a directory are worth stat'ing through the ring. On local flash the kernel serves
+	statx() from the cache faster than it can hand requests to its io_uring workers, the ring only pays off when
+	every call may wait on the network or a disk head: network filesystems and rotational drives.
+*/
+bool WantsBatching(const int fd, const dev_t device)
+{
+	static constexpr decltype(statfs::f_type) Remote[] = {
+		0x6969,     // NFS
+		0x517B,     // SMB
+		0xFE534D42, // SMB2
+		0xFF534D42, // CIFS
+		0x00C36400, // Ceph
+		0x65735546, // FUSE
+		0x01021997, // 9P
+		0x5346414F, // AFS
+		0x0BD00BD0, // Lustre
+		0x01161970, // GFS2
+		0x7461636F, // OCFS2
+	};
+
+	struct statfs info{};
+	if (fstatfs(fd, &info) == 0 && std::find(std::begin(Remote), std::end(Remote), info.f_type) != std::end(Remote)) {
+		return true;
+	}
+
+	// NOTE: Partitions do not have a queue of their own, the one of the whole disk is one level up.
+	char path[128] = {0};
+	for (const auto format: {"/sys/dev/block/%u:%u/queue/rotational", "/sys/dev/block/%u:%u/../queue/rotational"}) {
+		std::snprintf(path, sizeof(path), format, major(device), minor(device));
+
+		if (auto file = std::fopen(path, "r")) {
+			const auto rotational = std::fgetc(file) == '1';
+			std::fclose(file);
+			return rotational;
+		}
+	}
+
+	return false;
+}
+
+/*
+	A minimal io_uring driven through the raw system calls, it only ever runs statx() requests. A chunk is
+	submitted and waited for with a single io_uring_enter() call whenever the kernel can take it at once.
+*/
+class StatRing
+{
+	public:
+		StatRing();
+		~StatRing();
+
+		StatRing(const StatRing &) = delete;
+		StatRing(StatRing &&) = delete;
+
+		StatRing &operator =(const StatRing &) = delete;
+		StatRing &operator =(StatRing &&) = delete;
+
+		bool valid() const { return fd != -1; }
+
+		// Stats the given slots, returns false if the ring is not usable and the slots have to be stat'ed directly.
+		bool stat(const int directory, Slot *slots, const std::size_t count);
+
+	private:
+		int fd = -1;
+
+		void *rings = MAP_FAILED;
+		std::size_t ringsSize = 0;
+		void *completionRing = MAP_FAILED;
+		std::size_t completionRingSize = 0;
+		io_uring_sqe *submissions = static_cast<io_uring_sqe *>(MAP_FAILED);
+		std::size_t submissionsSize = 0;
+
+		unsigned *submissionTail = nullptr;
+		unsigned *submissionMask = nullptr;
+		unsigned *submissionArray = nullptr;
+		unsigned *completionHead = nullptr;
+		unsigned *completionTail = nullptr;
+		unsigned *completionMask = nullptr;
+		io_uring_cqe *completions = nullptr;
+
+		void release();
+};
+
+StatRing::StatRing()
+{
+	io_uring_params params{};
+
+	fd = static_cast<int>(syscall(__NR_io_uring_setup, ChunkSize, &params));
+	if (fd == -1) {
+		return;
+	}
+
+	ringsSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	completionRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+	// NOTE: Since 5.4 both rings share one mapping.
+	const auto single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (single) {
+		ringsSize = std::max(ringsSize, completionRingSize);
+	}
+
+	rings = mmap(nullptr, ringsSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (rings == MAP_FAILED) {
+		release();
+		return;
+	}
+
+	if (!single) {
+		completionRing = mmap(nullptr, completionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (completionRing == MAP_FAILED) {
+			release();
+			return;
+		}
+	}
+
+	submissionsSize = params.sq_entries * sizeof(io_uring_sqe);
+	submissions = static_cast<io_uring_sqe *>(mmap(nullptr, submissionsSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+	if (submissions == MAP_FAILED) {
+		release();
+		return;
+	}
+
+	auto base = static_cast<char *>(rings);
+	submissionTail = reinterpret_cast<unsigned *>(base + params.sq_off.tail);
+	submissionMask = reinterpret_cast<unsigned *>(base + params.sq_off.ring_mask);
+	submissionArray = reinterpret_cast<unsigned *>(base + params.sq_off.array);
+
+	auto completionBase = single ? base : static_cast<char *>(completionRing);
+	completionHead = reinterpret_cast<unsigned *>(completionBase + params.cq_off.head);
+	completionTail = reinterpret_cast<unsigned *>(completionBase + params.cq_off.tail);
+	completionMask = reinterpret_cast<unsigned *>(completionBase + params.cq_off.ring_mask);
+	completions = reinterpret_cast<io_uring_cqe *>(completionBase + params.cq_off.cqes);
+}
+
+StatRing::~StatRing()
+{
+	release();
+}
+
+void StatRing::release()
+{
+	if (submissions != MAP_FAILED) {
+		munmap(submissions, submissionsSize);
+		submissions = static_cast<io_uring_sqe *>(MAP_FAILED);
+	}
+
+	if (completionRing != MAP_FAILED) {
+		munmap(completionRing, completionRingSize);
+		completionRing = MAP_FAILED;
+	}
+
+	if (rings != MAP_FAILED) {
+		munmap(rings, ringsSize);
+		rings = MAP_FAILED;
+	}
+
+	if (fd != -1) {
+		::close(fd);
+		fd = -1;
+	}
+}
+
+bool StatRing::stat(const int directory, Slot *slots, const std::size_t count)
+{
+	// NOTE: Only this thread produces submissions, the kernel consumes them before the completions are posted.
+	auto tail = *submissionTail;
+	unsigned queued = 0;
+
+	for (std::size_t i = 0; i < count; ++i) {
+		if (!slots[i].stat) {
+			continue;
+		}
+
+		const auto index = tail & *submissionMask;
+		auto &submission = submissions[index];
+		std::memset(&submission, 0, sizeof(submission));
+
+		submission.opcode = IORING_OP_STATX;
+		submission.fd = directory;
+		submission.addr = reinterpret_cast<std::uint64_t>(slots[i].name);
+		submission.len = StatMask;
+		submission.addr2 = reinterpret_cast<std::uint64_t>(&slots[i].info);
+		submission.statx_flags = static_cast<std::uint32_t>(StatFlags(slots[i].type == DT_LNK));
+		submission.user_data = i;
+
+		submissionArray[index] = index;
+		++tail;
+		++queued;
+	}
+
+	if (queued == 0) {
+		return true;
+	}
+
+	__atomic_store_n(submissionTail, tail, __ATOMIC_RELEASE);
+
+	unsigned submit = queued;
+	unsigned completed = 0;
+	bool supported = true;
+
+	while (completed < queued) {
+		const auto result = syscall(__NR_io_uring_enter, fd, submit, queued - completed, IORING_ENTER_GETEVENTS, nullptr, 0);
+		if (result < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			// NOTE: Not expected to happen, the ring is given up on and the caller stats the slots directly.
+			release();
+			return false;
+		}
+
+		submit -= std::min<unsigned>(submit, static_cast<unsigned>(result));
+
+		auto head = *completionHead;
+		const auto end = __atomic_load_n(completionTail, __ATOMIC_ACQUIRE);
+		for (; head != end; ++head, ++completed) {
+			const auto &completion = completions[head & *completionMask];
+			auto &slot = slots[completion.user_data];
+			slot.result = completion.res < 0 ? -completion.res : 0;
+
+			// NOTE: Kernels before 5.6 know io_uring but not its statx operation.
+			if (completion.res == -EINVAL || completion.res == -EOPNOTSUPP) {
+				slot.result = Stat(directory, slot.name, slot.type == DT_LNK, slot.info);
+				supported = false;
+			}
+		}
+
+		__atomic_store_n(completionHead, head, __ATOMIC_RELEASE);
+	}
+
+	if (!supported) {
+		release();
+	}
+
+	return true;
+}
+#endif
+
+} // namespace <anonymous>
+
+#if defined(PLATFORM_LINUX)
+struct DirectoryReader::Batch
+{
+	std::array<Slot, ChunkSize> slots{};
+	std::size_t count = 0;
+	std::size_t index = 0;
+
+#if defined(WITH_IO_URING)
+	StatRing ring{};
+	// Whether the current directory goes through the ring, decided once per device.
+	bool batched = false;
+	std::vector<std::pair<dev_t, bool>> devices{};
+#endif
+};
+
+DirectoryReader::DirectoryReader()
+: batch{std::make_unique<Batch>()}
+{
+}
+
+DirectoryReader::~DirectoryReader()
+{
+	close();
+}
+
+bool DirectoryReader::open(const fs::path &path, const bool metadata/* = true */)
+{
+	close();
+	withMetadata = metadata;
+
+	fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd == -1) {
+		lastOpenError = {errno, std::generic_category()};
+		error = true;
+		return false;
+	}
+
+	struct stat info{};
+	if (fstat(fd, &info) == -1) {
+		const auto code = errno;
+		close();
+		lastOpenError = {code, std::generic_category()};
+		error = true;
+		return false;
+	}
+
+	openStamp = Stamp(info);
+	openDevice = static_cast<std::uint64_t>(info.st_dev);
+	openInode = static_cast<std::uint64_t>(info.st_ino);
+
+#if defined(WITH_IO_URING)
+	if (batch->ring.valid()) {
+		auto &devices = batch->devices;
+		auto it = std::find_if(devices.begin(), devices.end(), [&info] (const auto &device) {
+			return device.first == info.st_dev;
+		});
+
+		if (it == devices.end()) {
+			it = devices.insert(devices.end(), {info.st_dev, WantsBatching(fd, info.st_dev)});
+		}
+
+		batch->batched = it->second;
+	}
+#endif
+
+	return true;
+}
+
+void DirectoryReader::close()
+{
+	if (fd != -1) {
+		::close(fd);
+		fd = -1;
+	}
+
+	error = false;
+	lastOpenError = {};
+	openStamp = 0;
+	openDevice = 0;
+	openInode = 0;
+	position = 0;
+	available = 0;
+	batch->count = 0;
+	batch->index = 0;
+}
+
+bool DirectoryReader::next(Entry &entry)
+{
+	if (fd == -1) {
+		return false;
+	}
+
+	while (batch->index == batch->count) {
+		if (!fill()) {
+			return false;
+		}
+	}
+
+	auto &slot = batch->slots[batch->index++];
+
+	entry.name = slot.name;
+	entry.directory = slot.type == DT_DIR;
+	entry.symlink = slot.type == DT_LNK;
+	entry.size = 0;
+	entry.perms = fs::perms::unknown;
+	entry.mtime = 0;
+	entry.metadata = false;
+
+	if (!slot.stat) {
+		return true;
+	}
+
+	// NOTE: Dangling symlinks and entries removed since the listing are indexed with empty metadata.
+	entry.metadata = true;
+	if (slot.result != 0) {
+		return true;
+	}
+
+	// NOTE: Some filesystems do not fill in the type, such entries were stat'ed as they are and symlinks have to be followed now.
+	if (slot.type == DT_UNKNOWN && S_ISLNK(slot.info.stx_mode)) {
+		entry.symlink = true;
+		if (Stat(fd, slot.name, true, slot.info) != 0) {
+			return true;
+		}
+	}
+
+	SetMetadata(slot.info, entry);
+	return true;
+}
+
+bool DirectoryReader::readMetadata(const std::string &name, Entry &entry)
+{
+	struct statx info{};
+	if (fd == -1 || Stat(fd, name.c_str(), true, info) != 0) {
+		return false;
+	}
+
+	SetMetadata(info, entry);
+	return true;
+}
+
+bool DirectoryReader::fill()
+{
+	batch->count = 0;
+	batch->index = 0;
+
+	// NOTE: The slots point into the buffer, so a chunk never spans two reads.
+	if (position == available) {
+		const auto count = syscall(SYS_getdents64, fd, buffer, BufferSize);
+		if (count <= 0) {
+			error = count < 0;
+			return false;
+		}
+
+		position = 0;
+		available = static_cast<std::size_t>(count);
+	}
+
+	while (position < available && batch->count < ChunkSize) {
+		const auto dirent = reinterpret_cast<const struct dirent64 *>(buffer + position);
+		position += dirent->d_reclen;
+
+		const char *name = dirent->d_name;
+		if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+			continue;
+		}
+
+		auto &slot = batch->slots[batch->count++];
+		slot.name = name;
+		slot.type = dirent->d_type;
+		slot.stat = slot.type != DT_DIR && (withMetadata || slot.type == DT_LNK || slot.type == DT_UNKNOWN);
+		slot.result = 0;
+	}
+
+#if defined(WITH_IO_URING)
+	if (batch->batched && batch->ring.valid() && batch->ring.stat(fd, batch->slots.data(), batch->count)) {
+		return true;
+	}
+#endif
+
+	for (std::size_t i = 0; i < batch->count; ++i) {
+		auto &slot = batch->slots[i];
+		if (slot.stat) {
+			slot.result = Stat(fd, slot.name, slot.type == DT_LNK, slot.info);
+		}
+	}
+
+	return true;
+}
+
+std::uint64_t DirectoryStamp(const fs::path &path)
+{
+	struct stat info{};
+	if (stat(path.c_str(), &info) == -1 || !S_ISDIR(info.st_mode)) {
+		return 0;
+	}
+
+	return Stamp(info);
+}
+
+bool DirectoryIdentity(const fs::path &path, std::uint64_t &device, std::uint64_t &inode)
+{
+	struct stat info{};
+	if (stat(path.c_str(), &info) == -1 || !S_ISDIR(info.st_mode)) {
+		return false;
+	}
+
+	device = static_cast<std::uint64_t>(info.st_dev);
+	inode = static_cast<std::uint64_t>(info.st_ino);
+	return true;
+}
+
+bool ReadMetadata(const fs::path &path, DirectoryReader::Entry &entry)
+{
+	struct statx info{};
+	if (Stat(AT_FDCWD, path.c_str(), true, info) != 0) {
+		return false;
+	}
+
+	SetMetadata(info, entry);
+	return true;
+}
+#else
+DirectoryReader::DirectoryReader()
+{
+}
+
+DirectoryReader::~DirectoryReader()
+{
+	close();
+}
+
+bool DirectoryReader::open(const fs::path &path, const bool metadata/* = true */)
+{
+	close();
+	withMetadata = metadata;
+	directory = path;
+
+	openStamp = DirectoryStamp(path);
+
+	std::error_code ec{};
+	iterator = fs::directory_iterator{path, fs::directory_options::skip_permission_denied, ec};
+	if (ec || openStamp == 0) {
+		close();
+		lastOpenError = ec ? ec : std::make_error_code(std::errc::no_such_file_or_directory);
+		error = true;
+		return false;
+	}
+
+	return true;
+}
+
+void DirectoryReader::close()
+{
+	iterator = {};
+	directory.clear();
+	error = false;
+	lastOpenError = {};
+	openStamp = 0;
+}
+
+bool DirectoryReader::next(Entry &entry)
+{
+	if (iterator == fs::directory_iterator{}) {
+		return false;
+	}
+
+	const auto &current = *iterator;
+
+	name = current.path().filename().string();
+	entry.name = name;
+	entry.directory = current.is_directory();
+	entry.symlink = current.is_symlink();
+	entry.size = 0;
+	entry.perms = fs::perms::unknown;
+	entry.mtime = 0;
+	entry.metadata = false;
+
+	if (!entry.directory && withMetadata) {
+		std::error_code ec{};
+		const auto size = current.file_size(ec);
+		entry.size = ec ? 0 : static_cast<std::uint64_t>(size);
+		entry.perms = current.status(ec).permissions();
+
+		const auto time = current.last_write_time(ec);
+		entry.mtime = ec ? 0 : UnixTime(time);
+		entry.metadata = true;
+	}
+
+	std::error_code ec{};
+	iterator.increment(ec);
+	if (ec) {
+		iterator = {};
+		error = true;
+	}
+
+	return true;
+}
+
+std::uint64_t DirectoryStamp(const fs::path &path)
+{
+	std::error_code ec{};
+	if (!fs::is_directory(path, ec)) {
+		return 0;
+	}
+
+	const auto time = fs::last_write_time(path, ec);
+	if (ec) {
+		return 0;
+	}
+
+	return std::max<std::uint64_t>(static_cast<std::uint64_t>(time.time_since_epoch().count()), 1);
+}
+
+bool DirectoryIdentity(const fs::path &, std::uint64_t &, std::uint64_t &)
+{
+	return false;
+}
+
+bool DirectoryReader::readMetadata(const std::string &name, Entry &entry)
+{
+	return !directory.empty() && ReadMetadata(directory / name, entry);
+}
+
+bool ReadMetadata(const fs::path &path, DirectoryReader::Entry &entry)
+{
+	std::error_code ec{};
+	const auto status = fs::status(path, ec);
+	if (ec) {
+		return false;
+	}
+
+	entry.directory = fs::is_directory(status);
+	entry.metadata = true;
+
+	if (!entry.directory) {
+		const auto size = fs::file_size(path, ec);
+		entry.size = ec ? 0 : static_cast<std::uint64_t>(size);
+		entry.perms = status.permissions();
+
+		const auto time = fs::last_write_time(path, ec);
+		entry.mtime = ec ? 0 : UnixTime(time);
+	}
+
+	return true;
+}
+#endif
@@ -0,0 +1,129 @@
+/*
+	Copyright (c) 2019 Kamil Chojnowski Y29udGFjdEBkaWF0aC5uZXQ=
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in the
+	Software without restriction, including without limitation the rights to use,
+	copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+	THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef NOTHING_DIRECTORYREADER_HPP
+#define NOTHING_DIRECTORYREADER_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+/*
+	Lists a single directory together with the metadata the index stores.
+
+	On Linux the directory is opened once and read in large getdents64() batches. The entry type comes from the
+	directory entry itself, so folders are never stat'ed, and files are stat'ed relative to the directory with
+	statx() asking for just the type, mode, size and mtime. Names point into the read buffer, nothing is allocated
+	per entry. Elsewhere the reader falls back to std::filesystem.
+
+	A directory can also be listed without metadata, then only the entries whose type the listing does not tell
+	(symlinks and filesystems that leave the type out) are stat'ed and the rest come back with metadata unset.
+
+	When built WITH_IO_URING and the kernel allows it, the entries of directories on network filesystems and
+	rotational drives are stat'ed in chunks: the statx() calls of a whole chunk are submitted to an io_uring at
+	once and run concurrently, which keeps such high latency storage busy without a thread per request.
+	Otherwise the calls are made one by one.
+*/
+class DirectoryReader
+{
+	public:
+		struct Entry
+		{
+			// Points into the reader, only valid until the next call to next().
+			std::string_view name{};
+			// Symlinked folders count as folders, they are flagged so that callers do not descend into them.
+			bool directory = false;
+			bool symlink = false;
+			std::uint64_t size = 0;
+			std::filesystem::perms perms = std::filesystem::perms::unknown;
+			// Nanoseconds since the Unix epoch.
+			std::uint64_t mtime = 0;
+			// False if the size, permissions and mtime have not been read.
+			bool metadata = false;
+		};
+
+		DirectoryReader();
+		~DirectoryReader();
+
+		DirectoryReader(const DirectoryReader &) = delete;
+		DirectoryReader(DirectoryReader &&) = delete;
+
+		DirectoryReader &operator =(const DirectoryReader &) = delete;
+		DirectoryReader &operator =(DirectoryReader &&) = delete;
+
+		// Returns false if the directory cannot be listed, the previous one is closed either way and openError() tells why.
+		bool open(const std::filesystem::path &path, const bool metadata = true);
+		void close();
+
+		// Returns false once all the entries have been read or the listing failed, failed() tells the two apart.
+		bool next(Entry &entry);
+		bool failed() const { return error; }
+		const std::error_code &openError() const { return lastOpenError; }
+
+		// Reads the metadata of a file in the open directory, without listing it. Returns false if it cannot be stat'ed.
+		bool readMetadata(const std::string &name, Entry &entry);
+
+		// The DirectoryStamp() of the directory, taken when it was opened.
+		std::uint64_t stamp() const { return openStamp; }
+		// The device and inode numbers of the directory, zero where the platform does not have them.
+		std::uint64_t device() const { return openDevice; }
+		std::uint64_t inode() const { return openInode; }
+
+	private:
+		bool error = false;
+		bool withMetadata = true;
+		std::error_code lastOpenError{};
+		std::uint64_t openStamp = 0;
+		std::uint64_t openDevice = 0;
+		std::uint64_t openInode = 0;
+
+#if defined(PLATFORM_LINUX)
+		static constexpr std::size_t BufferSize = 32 * 1024;
+
+		// The entries of the current chunk and their metadata, along with the io_uring if there is one.
+		struct Batch;
+
+		int fd = -1;
+		std::size_t position = 0;
+		std::size_t available = 0;
+		alignas(8) char buffer[BufferSize];
+		std::unique_ptr<Batch> batch;
+
+		bool fill();
+#else
+		std::filesystem::path directory{};
+		std::filesystem::directory_iterator iterator{};
+		std::string name{};
+#endif
+};
+
+// Reads the metadata of a single file, returns false if it cannot be stat'ed.
+bool ReadMetadata(const std::filesystem::path &path, DirectoryReader::Entry &entry);
+
+/*
+	Returns a value that changes whenever the contents of a directory do, or zero if the path is not a directory.
+	On Linux this is the later of the mtime and ctime, elsewhere only the last write time is available.
+*/
+std::uint64_t DirectoryStamp(const std::filesystem::path &path);
+
+// Reads the device and inode numbers of a directory, returns false if it is not one or the platform does not have them.
+bool DirectoryIdentity(const std::filesystem::path &path, std::uint64_t &device, std::uint64_t &inode);
+
+#endif // NOTHING_DIRECTORYREADER_HPP
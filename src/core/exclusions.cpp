@@ -0,0 +1,443 @@
+/*
+	Copyright (c) 2019 Kamil Chojnowski Y29udGFjdEBkaWF0aC5uZXQ=
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in the
+	Software without restriction, including without limitation the rights to use,
+	copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+	THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+#include "exclusions.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr const char *PseudoFilesystems[] = {
+	"autofs", "binfmt_misc", "bpf", "cgroup", "cgroup2", "configfs", "debugfs", "devpts", "devtmpfs", "efivarfs",
+	"fusectl", "hugetlbfs", "mqueue", "nsfs", "proc", "pstore", "rpc_pipefs", "securityfs", "selinuxfs", "sysfs",
+	"tracefs",
+};
+
+inline bool HasWildcards(const std::string_view text)
+{
+	return text.find_first_of("*?[\\") != std::string_view::npos;
+}
+
+std::string_view Trim(std::string_view text)
+{
+	while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+		text.remove_prefix(1);
+	}
+
+	while (!text.empty() && (text.back() == ' ' || text.back() == '\t' || text.back() == '\r' || text.back() == '\n')) {
+		text.remove_suffix(1);
+	}
+
+	return text;
+}
+
+// Returns the position of the bracket closing the class that starts at the given one, or npos if it is not closed.
+std::size_t ClassEnd(const std::string_view pattern, std::size_t position)
+{
+	++position;
+	if (position < pattern.size() && (pattern[position] == '!' || pattern[position] == '^')) {
+		++position;
+	}
+
+	// NOTE: A bracket right at the start is a part of the class.
+	if (position < pattern.size() && pattern[position] == ']') {
+		++position;
+	}
+
+	return pattern.find(']', position);
+}
+
+bool MatchClass(std::string_view body, const char ch)
+{
+	const auto negated = !body.empty() && (body.front() == '!' || body.front() == '^');
+	if (negated) {
+		body.remove_prefix(1);
+	}
+
+	bool matched = false;
+	for (std::size_t i = 0; i < body.size() && !matched; ++i) {
+		if (i + 2 < body.size() && body[i + 1] == '-') {
+			matched = body[i] <= ch && ch <= body[i + 2];
+			i += 2;
+		} else {
+			matched = body[i] == ch;
+		}
+	}
+
+	return matched != negated;
+}
+
+// Turns the \NNN escapes of the mount table back into characters.
+std::string Unescape(const std::string_view text)
+{
+	std::string result{};
+	result.reserve(text.size());
+
+	for (std::size_t i = 0; i < text.size(); ++i) {
+		if (text[i] == '\\' && i + 3 < text.size()) {
+			const auto digits = text.substr(i + 1, 3);
+			if (std::all_of(digits.begin(), digits.end(), [] (const char ch) { return ch >= '0' && ch <= '7'; })) {
+				result += static_cast<char>((digits[0] - '0') * 64 + (digits[1] - '0') * 8 + (digits[2] - '0'));
+				i += 3;
+				continue;
+			}
+		}
+
+		result += text[i];
+	}
+
+	return result;
+}
+
+} // namespace <anonymous>
+
+bool MatchGlob(const std::string_view pattern, const std::string_view text, const bool path)
+{
+	std::size_t p = 0;
+	std::size_t t = 0;
+
+	while (p < pattern.size()) {
+		if (pattern[p] == '*') {
+			const auto doubled = p + 1 < pattern.size() && pattern[p + 1] == '*';
+			const auto crossing = !path || doubled;
+			while (p < pattern.size() && pattern[p] == '*') {
+				++p;
+			}
+
+			// NOTE: A **/ also matches no folder at all.
+			if (doubled && p < pattern.size() && pattern[p] == '/' && MatchGlob(pattern.substr(p + 1), text.substr(t), path)) {
+				return true;
+			}
+
+			if (p == pattern.size()) {
+				return crossing || text.find('/', t) == std::string_view::npos;
+			}
+
+			for (; t <= text.size(); ++t) {
+				if (MatchGlob(pattern.substr(p), text.substr(t), path)) {
+					return true;
+				}
+
+				if (t == text.size() || (!crossing && text[t] == '/')) {
+					return false;
+				}
+			}
+
+			return false;
+		}
+
+		if (t == text.size()) {
+			return false;
+		}
+
+		if (pattern[p] == '?') {
+			if (path && text[t] == '/') {
+				return false;
+			}
+
+			++p;
+			++t;
+			continue;
+		}
+
+		if (pattern[p] == '[') {
+			if (const auto end = ClassEnd(pattern, p); end != std::string_view::npos) {
+				if ((path && text[t] == '/') || !MatchClass(pattern.substr(p + 1, end - p - 1), text[t])) {
+					return false;
+				}
+
+				p = end + 1;
+				++t;
+				continue;
+			}
+		}
+
+		if (pattern[p] == '\\' && p + 1 < pattern.size()) {
+			++p;
+		}
+
+		if (pattern[p] != text[t]) {
+			return false;
+		}
+
+		++p;
+		++t;
+	}
+
+	return t == text.size();
+}
+
+bool Exclusions::add(const std::string_view rule)
+{
+	auto text = Trim(rule);
+	if (text.empty()) {
+		return false;
+	}
+
+	if (text.substr(0, 3) == "fs:") {
+		const auto type = Trim(text.substr(3));
+		if (type.empty()) {
+			return false;
+		}
+
+		if (std::find(filesystemTypes.begin(), filesystemTypes.end(), type) == filesystemTypes.end()) {
+			filesystemTypes.emplace_back(type);
+			loadMounts();
+		}
+
+		return true;
+	}
+
+	const auto directoryOnly = text.size() > 1 && text.back() == '/';
+	if (directoryOnly) {
+		text.remove_suffix(1);
+	}
+
+	const auto path = text.find('/') != std::string_view::npos;
+	if (!path && !HasWildcards(text)) {
+		(directoryOnly ? directoryNames : names).emplace(text);
+		return true;
+	}
+
+	Glob glob{GlobType::Pattern, std::string{text}, path, directoryOnly};
+
+	// NOTE: The common *.ext and prefix* forms of name globs are plain string comparisons.
+	if (!path && text.size() > 1) {
+		if (text.front() == '*' && !HasWildcards(text.substr(1))) {
+			glob.type = GlobType::Suffix;
+			glob.text = text.substr(1);
+		} else if (text.back() == '*' && !HasWildcards(text.substr(0, text.size() - 1))) {
+			glob.type = GlobType::Prefix;
+			glob.text = text.substr(0, text.size() - 1);
+		}
+	}
+
+	globs.push_back(std::move(glob));
+	return true;
+}
+
+void Exclusions::addDefaults()
+{
+	for (const auto type: PseudoFilesystems) {
+		if (std::find(filesystemTypes.begin(), filesystemTypes.end(), type) == filesystemTypes.end()) {
+			filesystemTypes.emplace_back(type);
+		}
+	}
+
+	loadMounts();
+}
+
+void Exclusions::loadMounts()
+{
+	mountPoints.clear();
+
+#if defined(PLATFORM_LINUX)
+	if (filesystemTypes.empty()) {
+		return;
+	}
+
+	std::ifstream file{"/proc/self/mountinfo"};
+	if (!file) {
+		std::fprintf(stderr, "[Exclusions] loadMounts(): Failed to read the mount table\n");
+		return;
+	}
+
+	/*
+		Every line is "id parent major:minor root mountpoint options [optional fields...] - type source options",
+		the optional fields vary in number so the type is found after the separator.
+	*/
+	std::string line{};
+	while (std::getline(file, line)) {
+		std::vector<std::string_view> fields{};
+		std::string_view rest{line};
+
+		while (!rest.empty()) {
+			const auto end = rest.find(' ');
+			fields.push_back(rest.substr(0, end));
+			rest = end == std::string_view::npos ? std::string_view{} : rest.substr(end + 1);
+		}
+
+		const auto separator = std::find(fields.begin(), fields.end(), "-");
+		if (fields.size() < 5 || separator == fields.end() || separator + 1 == fields.end()) {
+			continue;
+		}
+
+		const auto type = *(separator + 1);
+		if (std::find(filesystemTypes.begin(), filesystemTypes.end(), type) != filesystemTypes.end()) {
+			mountPoints.insert(Unescape(fields[4]));
+		}
+	}
+#endif
+}
+
+bool Exclusions::excludesDirectory(const std::string_view path, const std::string_view name) const
+{
+	if (names.find(name) != names.end() || directoryNames.find(name) != directoryNames.end()) {
+		return true;
+	}
+
+	if (!mountPoints.empty() && mountPoints.find(path) != mountPoints.end()) {
+		return true;
+	}
+
+	for (const auto &glob: globs) {
+		if (matches(glob, path, name, true)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool Exclusions::excludesFile(const std::string_view directory, const std::string_view name) const
+{
+	if (names.find(name) != names.end()) {
+		return true;
+	}
+
+	// NOTE: The full path is only put together if a path glob needs it.
+	std::string path{};
+	for (const auto &glob: globs) {
+		if (glob.directoryOnly) {
+			continue;
+		}
+
+		if (glob.path && path.empty()) {
+			path.reserve(directory.size() + name.size() + 1);
+			path += directory;
+			if (path.empty() || path.back() != '/') {
+				path += '/';
+			}
+			path += name;
+		}
+
+		if (matches(glob, path, name, false)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool Exclusions::matches(const Glob &glob, const std::string_view path, const std::string_view name, const bool directory) const
+{
+	if (glob.directoryOnly && !directory) {
+		return false;
+	}
+
+	switch (glob.type) {
+		case GlobType::Prefix:
+			return name.size() >= glob.text.size() && name.compare(0, glob.text.size(), glob.text) == 0;
+
+		case GlobType::Suffix:
+			return name.size() >= glob.text.size() && name.compare(name.size() - glob.text.size(), glob.text.size(), glob.text) == 0;
+
+		default:
+			return glob.path ? MatchGlob(glob.text, path, true) : MatchGlob(glob.text, name, false);
+	}
+}
+
+std::shared_ptr<const IgnoreRules> IgnoreRules::load(const fs::path &directory, std::shared_ptr<const IgnoreRules> parent)
+{
+	std::ifstream file{directory / ".gitignore"};
+	if (!file) {
+		return parent;
+	}
+
+	auto rules = std::make_shared<IgnoreRules>();
+
+	std::string line{};
+	while (std::getline(file, line)) {
+		std::string_view text{line};
+		while (!text.empty() && (text.back() == '\r' || text.back() == '\n')) {
+			text.remove_suffix(1);
+		}
+
+		if (text.empty() || text.front() == '#') {
+			continue;
+		}
+
+		// NOTE: Trailing spaces are dropped unless they are escaped.
+		while (text.size() > 1 && text.back() == ' ' && text[text.size() - 2] != '\\') {
+			text.remove_suffix(1);
+		}
+
+		Pattern pattern{};
+		if (text.front() == '!') {
+			pattern.negated = true;
+			text.remove_prefix(1);
+		} else if (text.front() == '\\' && text.size() > 1 && (text[1] == '!' || text[1] == '#')) {
+			text.remove_prefix(1);
+		}
+
+		if (!text.empty() && text.back() == '/') {
+			pattern.directoryOnly = true;
+			text.remove_suffix(1);
+		}
+
+		// NOTE: A pattern with a slash anywhere but at the end is relative to the .gitignore, otherwise it matches names at any depth.
+		pattern.anchored = text.find('/') != std::string_view::npos;
+		if (!text.empty() && text.front() == '/') {
+			text.remove_prefix(1);
+		}
+
+		if (text.empty() || text == " ") {
+			continue;
+		}
+
+		pattern.text = text;
+		rules->patterns.push_back(std::move(pattern));
+	}
+
+	if (rules->patterns.empty()) {
+		return parent;
+	}
+
+	rules->parent = std::move(parent);
+	rules->base = directory.generic_string();
+	if (rules->base.empty() || rules->base.back() != '/') {
+		rules->base += '/';
+	}
+
+	return rules;
+}
+
+bool IgnoreRules::isIgnored(const std::string_view path, const std::string_view name, const bool directory) const
+{
+	for (auto rules = this; rules; rules = rules->parent.get()) {
+		if (path.compare(0, rules->base.size(), rules->base) != 0) {
+			continue;
+		}
+
+		const auto relative = path.substr(rules->base.size());
+		for (auto it = rules->patterns.rbegin(); it != rules->patterns.rend(); ++it) {
+			if (it->directoryOnly && !directory) {
+				continue;
+			}
+
+			if (MatchGlob(it->text, it->anchored ? relative : name, true)) {
+				return !it->negated;
+			}
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,129 @@
+/*
+	Copyright (c) 2019 Kamil Chojnowski Y29udGFjdEBkaWF0aC5uZXQ=
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in the
+	Software without restriction, including without limitation the rights to use,
+	copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+	THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef NOTHING_EXCLUSIONS_HPP
+#define NOTHING_EXCLUSIONS_HPP
+
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+	The rules deciding which files and folders are left out of the index.
+
+	Rules are given as text:
+
+		node_modules    a file or folder with exactly this name
+		*.o             a glob (*, ? and [...] classes) matched against the name
+		/tmp/build-*    a glob with a slash is matched against the full path, where only ** crosses slashes
+		build/          a trailing slash limits the rule to folders
+		fs:tmpfs        everything on filesystems of the given type, see /proc/self/mountinfo
+
+	Names without wildcards are looked up in a set and globs are sorted into literal prefix and suffix checks
+	wherever they allow it, only the rest goes through the full glob matcher. Folders are checked before they are
+	opened, an excluded folder is skipped along with everything below it.
+*/
+class Exclusions
+{
+	public:
+		Exclusions() = default;
+
+		// Returns false if the rule is not valid.
+		bool add(const std::string_view rule);
+		// Excludes the pseudo filesystems (procfs, sysfs, cgroups and the like) that never hold files worth finding.
+		void addDefaults();
+
+		// Whether .gitignore files found while scanning are honored as well, off by default.
+		void setGitIgnore(const bool enabled) { gitIgnore = enabled; }
+		bool isGitIgnoreEnabled() const { return gitIgnore; }
+
+		/*
+			Reads the mount table and remembers the mount points of the excluded filesystem types, called by add()
+			and addDefaults() and has to be called again to pick up filesystems mounted since.
+		*/
+		void loadMounts();
+
+		// Whether any rule can exclude a file, callers can skip building the paths of files otherwise.
+		bool hasFileRules() const { return !names.empty() || !globs.empty(); }
+
+		// Both take the full path of the folder or of the folder holding the file.
+		bool excludesDirectory(const std::string_view path, const std::string_view name) const;
+		bool excludesFile(const std::string_view directory, const std::string_view name) const;
+
+	private:
+		enum class GlobType
+		{
+			Prefix,
+			Suffix,
+			Pattern,
+		};
+
+		struct Glob
+		{
+			GlobType type = GlobType::Pattern;
+			// The literal part for prefix and suffix globs, the whole pattern otherwise.
+			std::string text{};
+			bool path = false;
+			bool directoryOnly = false;
+		};
+
+		std::set<std::string, std::less<>> names{};
+		std::set<std::string, std::less<>> directoryNames{};
+		std::vector<Glob> globs{};
+		std::vector<std::string> filesystemTypes{};
+		std::set<std::string, std::less<>> mountPoints{};
+		bool gitIgnore = false;
+
+		bool matches(const Glob &glob, const std::string_view path, const std::string_view name, const bool directory) const;
+};
+
+/*
+	The patterns of one .gitignore file, chained to the ones of the folders above it. A folder without a .gitignore
+	shares the rules of its parent.
+*/
+class IgnoreRules
+{
+	public:
+		// Returns the rules that apply below the given folder, which are the parent ones if it has no .gitignore.
+		static std::shared_ptr<const IgnoreRules> load(const std::filesystem::path &directory, std::shared_ptr<const IgnoreRules> parent);
+
+		// Takes the full path of the file or folder, the last matching pattern of the nearest .gitignore wins.
+		bool isIgnored(const std::string_view path, const std::string_view name, const bool directory) const;
+
+	private:
+		struct Pattern
+		{
+			std::string text{};
+			bool negated = false;
+			bool anchored = false;
+			bool directoryOnly = false;
+		};
+
+		std::shared_ptr<const IgnoreRules> parent{};
+		// The folder holding the .gitignore, with a trailing slash.
+		std::string base{};
+		std::vector<Pattern> patterns{};
+};
+
+// Matches a glob against the text, with path set * and ? do not match a slash and only ** crosses folders.
+bool MatchGlob(const std::string_view pattern, const std::string_view text, const bool path);
+
+#endif // NOTHING_EXCLUSIONS_HPP
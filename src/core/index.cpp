@@ -0,0 +1,469 @@
+/*
+	Copyright (c) 2019 Kamil Chojnowski Y29udGFjdEBkaWF0aC5uZXQ=
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in the
+	Software without restriction, including without limitation the rights to use,
+	copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+	THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <algorithm>
+
+#include "index.hpp"
+#include "search.hpp"
+
+namespace {
+
+// Compaction is only worth it once a meaningful amount of the table is made up of tombstones.
+constexpr std::size_t CompactMinDeadRows = 64 * 1024;
+
+} // namespace <anonymous>
+
+Index::Id Index::internRoot(const std::string_view path)
+{
+	const auto directory = directories.intern(path);
+	if (auto it = rootLookup.find(directory); it != rootLookup.end()) {
+		return it->second;
+	}
+
+	const auto root = static_cast<Id>(roots.size());
+	roots.push_back(directory);
+	rootLookup.emplace(directory, root);
+	completeRoots.push_back(false);
+	rootModifications.push_back(0);
+	return root;
+}
+
+Index::Id Index::findRoot(const std::string_view path) const
+{
+	const auto directory = directories.find(path);
+	if (directory == InvalidId) {
+		return InvalidId;
+	}
+
+	if (auto it = rootLookup.find(directory); it != rootLookup.end()) {
+		return it->second;
+	}
+
+	return InvalidId;
+}
+
+std::vector<std::string> Index::rootPaths() const
+{
+	std::vector<std::string> result{};
+	for (const auto directory: roots) {
+		if (directory != InvalidId) {
+			result.push_back(directories.path(directory));
+		}
+	}
+
+	return result;
+}
+
+Index::Id Index::ownerRoot(const Id directory) const
+{
+	for (auto current = directory; current != InvalidId && current < directories.size(); current = directories.parent(current)) {
+		if (auto it = rootLookup.find(current); it != rootLookup.end()) {
+			return it->second;
+		}
+	}
+
+	return InvalidId;
+}
+
+void Index::mergeRoots(const Id root, const std::vector<Id> &children)
+{
+	if (children.empty()) {
+		return;
+	}
+
+	std::vector<bool> merged(roots.size(), false);
+	for (const auto child: children) {
+		if (child >= roots.size() || child == root || roots[child] == InvalidId) {
+			continue;
+		}
+
+		merged[child] = true;
+		rootLookup.erase(roots[child]);
+		roots[child] = InvalidId;
+		completeRoots[child] = false;
+		++rootModifications[child];
+	}
+
+	const auto count = static_cast<Id>(directoryIds.size());
+	for (Id row = 0; row < count; ++row) {
+		if (merged[rootIds[row]] && directoryIds[row] != InvalidId) {
+			rootIds[row] = root;
+		}
+	}
+
+	++modifications;
+	++rootModifications[root];
+}
+
+Index::Id Index::add(const std::string_view name, const Id directory, const Id root, const std::uint64_t size, const std::uint16_t perms, const std::uint64_t mtime, const bool metadata)
+{
+	const auto row = static_cast<Id>(directoryIds.size());
+
+	names.insert(names.end(), name.begin(), name.end());
+	names.push_back('\0');
+
+	folded.resize(names.size());
+	FoldCase(name.data(), name.data() + name.size(), folded.data() + offsets.back());
+	offsets.push_back(static_cast<std::uint32_t>(names.size()));
+
+	directoryIds.push_back(directory);
+	rootIds.push_back(root);
+	sizes.push_back(size);
+	permissions.push_back(perms);
+	mtimes.push_back(mtime);
+	pending.push_back(!metadata);
+	pendingRows += !metadata;
+
+	const auto extension = internExtension(foldedName(row));
+	const auto type = extensionTypes[extension];
+	extensionIds.push_back(extension);
+	types.push_back(static_cast<std::uint8_t>(type));
+
+	trigrams.add(row, name);
+	extensionBitmaps[extension].add(row);
+	typeBitmaps[static_cast<std::size_t>(type)].add(row);
+
+	++modifications;
+	++rootModifications[root];
+	return row;
+}
+
+bool Index::remove(const std::string_view name, const Id directory)
+{
+	if (directory == InvalidId) {
+		return false;
+	}
+
+	const auto count = static_cast<Id>(directoryIds.size());
+	for (Id row = 0; row < count; ++row) {
+		if (directoryIds[row] == directory && this->name(row) == name) {
+			kill(row);
+			compactIfNeeded();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+std::size_t Index::removeByRoot(const Id root)
+{
+	std::size_t removed = 0;
+	completeRoots[root] = false;
+
+	// NOTE: The aliases are found again by the next scan of the root, the stamps are only ever read for complete roots.
+	const auto mask = directories.subtree(roots[root]);
+	for (std::size_t id = 0; id < mask.size() && id < directoryAliases.size(); ++id) {
+		if (mask[id]) {
+			directoryAliases[id] = InvalidId;
+		}
+	}
+
+	const auto count = static_cast<Id>(directoryIds.size());
+	for (Id row = 0; row < count; ++row) {
+		if (rootIds[row] == root && directoryIds[row] != InvalidId) {
+			kill(row);
+			++removed;
+		}
+	}
+
+	compactIfNeeded();
+	return removed;
+}
+
+std::size_t Index::removeByDirectories(const std::vector<Id> &directories)
+{
+	const auto mask = this->directories.subtree(directories);
+	for (std::size_t id = 0; id < mask.size() && id < directoryStamps.size(); ++id) {
+		if (mask[id]) {
+			directoryStamps[id] = 0;
+		}
+	}
+
+	for (std::size_t id = 0; id < mask.size() && id < directoryAliases.size(); ++id) {
+		if (mask[id]) {
+			directoryAliases[id] = InvalidId;
+		}
+	}
+
+	std::size_t removed = 0;
+
+	const auto count = static_cast<Id>(directoryIds.size());
+	for (Id row = 0; row < count; ++row) {
+		const auto id = directoryIds[row];
+		if (id != InvalidId && mask[id]) {
+			kill(row);
+			++removed;
+		}
+	}
+
+	compactIfNeeded();
+	return removed;
+}
+
+void Index::removeRows(const std::vector<Id> &rows)
+{
+	for (const auto row: rows) {
+		if (directoryIds[row] != InvalidId) {
+			kill(row);
+		}
+	}
+
+	compactIfNeeded();
+}
+
+void Index::update(const Id row, const std::uint64_t size, const std::uint16_t perms, const std::uint64_t mtime)
+{
+	sizes[row] = size;
+	permissions[row] = perms;
+	mtimes[row] = mtime;
+
+	if (pending[row]) {
+		pending[row] = false;
+		--pendingRows;
+	}
+
+	// NOTE: Filling in the metadata leaves the names alone, results that only depend on them stay valid.
+	++metadataModifications;
+}
+
+void Index::setDirectoryStamp(const Id directory, const std::uint64_t stamp)
+{
+	if (directory >= directoryStamps.size()) {
+		directoryStamps.resize(directories.size(), 0);
+	}
+
+	directoryStamps[directory] = stamp;
+
+	if (stamp != 0 && directory < directoryAliases.size()) {
+		directoryAliases[directory] = InvalidId;
+	}
+}
+
+void Index::setDirectoryAlias(const Id directory, const Id target)
+{
+	if (directory >= directoryAliases.size()) {
+		directoryAliases.resize(directories.size(), InvalidId);
+	}
+
+	directoryAliases[directory] = target;
+
+	if (target != InvalidId && directory < directoryStamps.size()) {
+		directoryStamps[directory] = 0;
+	}
+}
+
+std::vector<std::pair<Index::Id, Index::Id>> Index::aliases() const
+{
+	std::vector<std::pair<Id, Id>> result{};
+	for (Id id = 0; id < directoryAliases.size(); ++id) {
+		if (directoryAliases[id] != InvalidId) {
+			result.emplace_back(id, directoryAliases[id]);
+		}
+	}
+
+	return result;
+}
+
+std::vector<Index::Id> Index::listedDirectories(const Id root) const
+{
+	const auto mask = directories.subtree(roots[root]);
+
+	std::vector<Id> result{};
+	for (Id id = 0; id < mask.size() && id < directoryStamps.size(); ++id) {
+		if (mask[id] && directoryStamps[id] != 0) {
+			result.push_back(id);
+		}
+	}
+
+	return result;
+}
+
+Index::ExtensionId Index::findExtension(const std::string_view extension) const
+{
+	if (auto it = extensionLookup.find(std::string{extension}); it != extensionLookup.end()) {
+		return it->second;
+	}
+
+	return InvalidId;
+}
+
+bool Index::findIndexed(const std::string_view needle, std::vector<Id> &out) const
+{
+	std::vector<Id> rows{};
+	if (!trigrams.candidates(needle, rows)) {
+		return false;
+	}
+
+	for (const auto row: rows) {
+		if (directoryIds[row] != InvalidId && foldedName(row).find(needle) != std::string_view::npos) {
+			out.push_back(row);
+		}
+	}
+
+	return true;
+}
+
+void Index::find(const std::string_view needle, const Id begin, const Id end, std::vector<Id> &out) const
+{
+	const auto first = out.size();
+	FindMatchingRows(folded.data(), offsets.data(), begin, end, needle, out);
+
+	out.erase(std::remove_if(out.begin() + first, out.end(), [this] (const Id row) {
+		return directoryIds[row] == InvalidId;
+	}), out.end());
+}
+
+void Index::compact()
+{
+	std::vector<char> newNames{};
+	std::vector<char> newFolded{};
+	std::vector<std::uint32_t> newOffsets{0};
+	std::vector<Id> newDirectoryIds{};
+	std::vector<Id> newRootIds{};
+	std::vector<std::uint64_t> newSizes{};
+	std::vector<std::uint16_t> newPermissions{};
+	std::vector<std::uint64_t> newMtimes{};
+	std::vector<std::uint8_t> newPending{};
+	std::vector<ExtensionId> newExtensionIds{};
+	std::vector<std::uint8_t> newTypes{};
+
+	const auto live = liveRows();
+	newNames.reserve(names.size());
+	newFolded.reserve(folded.size());
+	newOffsets.reserve(live + 1);
+	newDirectoryIds.reserve(live);
+	newRootIds.reserve(live);
+	newSizes.reserve(live);
+	newPermissions.reserve(live);
+	newMtimes.reserve(live);
+	newPending.reserve(live);
+	newExtensionIds.reserve(live);
+	newTypes.reserve(live);
+
+	// NOTE: The new id of every old row, only kept while there is a pinned result set to renumber.
+	std::vector<Id> renumbered{};
+	if (!pinnedRows.empty()) {
+		renumbered.assign(directoryIds.size(), InvalidId);
+	}
+
+	const auto count = static_cast<Id>(directoryIds.size());
+	for (Id row = 0; row < count; ++row) {
+		if (directoryIds[row] == InvalidId) {
+			continue;
+		}
+
+		if (!renumbered.empty()) {
+			renumbered[row] = static_cast<Id>(newDirectoryIds.size());
+		}
+
+		newNames.insert(newNames.end(), names.begin() + offsets[row], names.begin() + offsets[row + 1]);
+		newFolded.insert(newFolded.end(), folded.begin() + offsets[row], folded.begin() + offsets[row + 1]);
+		newOffsets.push_back(static_cast<std::uint32_t>(newNames.size()));
+		newDirectoryIds.push_back(directoryIds[row]);
+		newRootIds.push_back(rootIds[row]);
+		newSizes.push_back(sizes[row]);
+		newPermissions.push_back(permissions[row]);
+		newMtimes.push_back(mtimes[row]);
+		newPending.push_back(pending[row]);
+		newExtensionIds.push_back(extensionIds[row]);
+		newTypes.push_back(types[row]);
+	}
+
+	names = std::move(newNames);
+	folded = std::move(newFolded);
+	offsets = std::move(newOffsets);
+	directoryIds = std::move(newDirectoryIds);
+	rootIds = std::move(newRootIds);
+	sizes = std::move(newSizes);
+	permissions = std::move(newPermissions);
+	mtimes = std::move(newMtimes);
+	pending = std::move(newPending);
+	extensionIds = std::move(newExtensionIds);
+	types = std::move(newTypes);
+	deadRows = 0;
+	++modifications;
+	++compactions;
+
+	for (auto &row: pinnedRows) {
+		row = row < renumbered.size() ? renumbered[row] : InvalidId;
+	}
+
+	trigrams.clear();
+	for (Id row = 0; row < static_cast<Id>(directoryIds.size()); ++row) {
+		trigrams.add(row, name(row));
+	}
+
+	rebuildBitmaps();
+}
+
+Index::ExtensionId Index::internExtension(const std::string_view foldedName)
+{
+	// NOTE: Everything past the last dot, the same part GetFileType() looks at, so the type only depends on the extension.
+	const auto dot = foldedName.rfind('.');
+	std::string extension{dot == std::string_view::npos ? std::string_view{} : foldedName.substr(dot + 1)};
+
+	if (auto it = extensionLookup.find(extension); it != extensionLookup.end()) {
+		return it->second;
+	}
+
+	const auto id = static_cast<ExtensionId>(extensions.size());
+	extensionTypes.push_back(GetFileType(foldedName));
+	extensionBitmaps.emplace_back();
+	extensionLookup.emplace(extension, id);
+	extensions.push_back(std::move(extension));
+	return id;
+}
+
+void Index::rebuildBitmaps()
+{
+	for (auto &&bitmap: extensionBitmaps) {
+		bitmap.clear();
+	}
+
+	for (auto &&bitmap: typeBitmaps) {
+		bitmap.clear();
+	}
+
+	for (Id row = 0; row < static_cast<Id>(directoryIds.size()); ++row) {
+		if (directoryIds[row] != InvalidId) {
+			extensionBitmaps[extensionIds[row]].add(row);
+			typeBitmaps[types[row]].add(row);
+		}
+	}
+}
+
+void Index::kill(const Id row)
+{
+	directoryIds[row] = InvalidId;
+	++deadRows;
+
+	if (pending[row]) {
+		pending[row] = false;
+		--pendingRows;
+	}
+
+	++modifications;
+	++rootModifications[rootIds[row]];
+}
+
+void Index::compactIfNeeded()
+{
+	if (deadRows >= CompactMinDeadRows && deadRows * 2 >= directoryIds.size()) {
+		compact();
+	}
+}
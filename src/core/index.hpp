@@ -0,0 +1,240 @@
+/*
+	Copyright (c) 2019 Kamil Chojnowski Y29udGFjdEBkaWF0aC5uZXQ=
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in the
+	Software without restriction, including without limitation the rights to use,
+	copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+	THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef NOTHING_INDEX_HPP
+#define NOTHING_INDEX_HPP
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "bitmap.hpp"
+#include "directories.hpp"
+#include "trigrams.hpp"
+#include "utils.hpp"
+
+/*
+	The in-memory file index.
+
+	File names are stored back to back in a single NUL-separated arena, every other attribute lives in its own
+	column indexed by the row id. Folders are interned in the directory table so a row only carries a directory id.
+	A second, ASCII lowercased copy of the arena backs the case-insensitive SIMD scans, names are also indexed by
+	their trigrams, which lets selective substring searches skip the full scan.
+
+	The extension (interned, id 0 stands for none) and the file type of every row are worked out once when it is
+	added. Both keep a bitmap of their rows, which turns extension and type filters into bitmap operations.
+	Rows can be added with only their name known, their size, permissions and modification time stay pending until
+	update() fills them in. Removed rows are tombstoned (their directory id is set to InvalidId) and reclaimed by compact() once they make
+	up a large enough share of the table.
+
+	The index itself is not thread-safe, the Database class serializes access to it.
+*/
+class Index
+{
+	public:
+		using Id = Directories::Id;
+		using ExtensionId = std::uint32_t;
+
+		static constexpr Id InvalidId = ~Id{0};
+
+		Index() = default;
+
+		Index(const Index &) = delete;
+		Index(Index &&) = delete;
+
+		Index &operator =(const Index &) = delete;
+		Index &operator =(Index &&) = delete;
+
+		Id internRoot(const std::string_view path);
+		Id findRoot(const std::string_view path) const;
+		// The root the directory lies in, the closest one if roots are nested, found by walking up its parents.
+		Id ownerRoot(const Id directory) const;
+		std::string rootPath(const Id root) const { return directories.path(roots[root]); }
+		std::vector<std::string> rootPaths() const;
+
+		// A root is complete once a full scan of it has been indexed, snapshots carry the flag so complete roots are not rescanned on startup.
+		bool isComplete(const Id root) const { return completeRoots[root]; }
+		void setComplete(const Id root, const bool complete) { completeRoots[root] = complete; }
+
+		/*
+			Hands the rows of the given roots over to another one they lie in, without touching the directories, their
+			stamps or their aliases. The roots given up are retired, their ids stay allocated but no longer stand for
+			any folder, and interning the same path again starts a new root.
+		*/
+		void mergeRoots(const Id root, const std::vector<Id> &children);
+
+		Id internDirectory(const Id parent, const std::string_view name) { return directories.intern(parent, name); }
+		Id internDirectory(const std::string_view path) { return directories.intern(path); }
+		Id findDirectory(const std::string_view path) const { return directories.find(path); }
+		std::string directoryPath(const Id directory) const { return directories.path(directory); }
+		std::size_t directoryCount() const { return directories.size(); }
+		Id directoryParent(const Id directory) const { return directories.parent(directory); }
+		const std::string &directoryName(const Id directory) const { return directories.name(directory); }
+
+		// A row added without metadata is pending, its size, permissions and mtime are placeholders until the first update().
+		Id add(const std::string_view name, const Id directory, const Id root, const std::uint64_t size, const std::uint16_t perms, const std::uint64_t mtime, const bool metadata = true);
+
+		bool remove(const std::string_view name, const Id directory);
+		std::size_t removeByRoot(const Id root);
+		std::size_t removeByDirectory(const Id directory) { return removeByDirectories({directory}); }
+		// Removes the files of every directory in the subtrees of the given directories and forgets their stamps and aliases.
+		std::size_t removeByDirectories(const std::vector<Id> &directories);
+		void removeRows(const std::vector<Id> &rows);
+		void update(const Id row, const std::uint64_t size, const std::uint16_t perms, const std::uint64_t mtime);
+
+		/*
+			The modification stamp of a directory as of its last listing, or zero if it has not been listed yet.
+			Reconciliation compares them against the filesystem to find the directories that have to be listed again.
+		*/
+		std::uint64_t directoryStamp(const Id directory) const {
+			return directory < directoryStamps.size() ? directoryStamps[directory] : 0;
+		}
+		void setDirectoryStamp(const Id directory, const std::uint64_t stamp);
+
+		/*
+			The directory another one is the same folder as, reached through a different path (a bind mount for
+			instance), or InvalidId. An alias is not listed, its files are only indexed under the folder it aliases.
+			Listing a directory clears its alias and aliasing one clears its stamp.
+		*/
+		Id directoryAlias(const Id directory) const {
+			return directory < directoryAliases.size() ? directoryAliases[directory] : InvalidId;
+		}
+		void setDirectoryAlias(const Id directory, const Id target);
+		// Returns every directory that is an alias along with the one it aliases.
+		std::vector<std::pair<Id, Id>> aliases() const;
+		// Returns the listed directories in the subtree of a root, parents always come before their children.
+		std::vector<Id> listedDirectories(const Id root) const;
+
+		/*
+			Both find functions expect an ASCII lowercased needle and append the ids of the live rows whose name contains it, in ascending order.
+			findIndexed() answers from the trigram index and returns false if the needle is too short for it, find() scans the given row range.
+		*/
+		bool findIndexed(const std::string_view needle, std::vector<Id> &out) const;
+		void find(const std::string_view needle, const Id begin, const Id end, std::vector<Id> &out) const;
+		// An upper bound for the number of rows findIndexed() would return, or the maximum value if it cannot be used.
+		std::size_t estimate(const std::string_view needle) const { return trigrams.estimate(needle); }
+
+		// The trigram candidates are only worth it when they cut the rows down to at most this fraction of the table.
+		static constexpr std::size_t CandidatesMaxShare = 4;
+
+		// Whether findIndexed() narrows the rows down enough to beat scanning them all in parallel.
+		bool isSelective(const std::string_view needle) const {
+			const auto count = estimate(needle);
+			return count != std::numeric_limits<std::size_t>::max() && count * CandidatesMaxShare <= liveRows();
+		}
+
+		// Bumped on every change to the rows, row ids remembered at one generation are only meaningful at that same generation.
+		std::uint64_t generation() const { return modifications; }
+		// Bumped whenever the size, permissions or mtime of a row change, which does not affect the names or the row ids.
+		std::uint64_t metadataGeneration() const { return metadataModifications; }
+
+		// Finer grained generations, the first is bumped when compaction renumbers the rows, the others when the rows of a given root change.
+		std::uint64_t layoutGeneration() const { return compactions; }
+		const std::vector<std::uint64_t> &rootGenerations() const { return rootModifications; }
+
+		std::size_t rows() const { return directoryIds.size(); }
+		std::size_t liveRows() const { return directoryIds.size() - deadRows; }
+
+		bool alive(const Id row) const { return directoryIds[row] != InvalidId; }
+
+		std::string_view name(const Id row) const {
+			return {names.data() + offsets[row], offsets[row + 1] - offsets[row] - 1};
+		}
+
+		std::string_view foldedName(const Id row) const {
+			return {folded.data() + offsets[row], offsets[row + 1] - offsets[row] - 1};
+		}
+
+		Id directory(const Id row) const { return directoryIds[row]; }
+		Id root(const Id row) const { return rootIds[row]; }
+		std::uint64_t size(const Id row) const { return sizes[row]; }
+		std::uint16_t perms(const Id row) const { return permissions[row]; }
+		// Nanoseconds since the Unix epoch.
+		std::uint64_t mtime(const Id row) const { return mtimes[row]; }
+		bool hasMetadata(const Id row) const { return !pending[row]; }
+		// The number of live rows still waiting for their metadata.
+		std::size_t pendingMetadata() const { return pendingRows; }
+		ExtensionId extension(const Id row) const { return extensionIds[row]; }
+		FileType type(const Id row) const { return static_cast<FileType>(types[row]); }
+
+		// Returns the id of a lowercased extension (without the dot), or InvalidId if no file has ever had it.
+		ExtensionId findExtension(const std::string_view extension) const;
+
+		// The bitmaps are not updated on removal, the rows they return have to be checked with alive().
+		const Bitmap &extensionBitmap(const ExtensionId extension) const { return extensionBitmaps[extension]; }
+		const Bitmap &typeBitmap(const FileType type) const { return typeBitmaps[static_cast<std::size_t>(type)]; }
+
+		void compact();
+
+		/*
+			A result set that compaction renumbers along with the rows, so that it can be paged through while the
+			index changes. Rows compacted away are left in place as InvalidId, removed ones are still checked with alive().
+		*/
+		void pin(std::vector<Id> rows) { pinnedRows = std::move(rows); }
+		const std::vector<Id> &pinned() const { return pinnedRows; }
+
+	private:
+		friend class Snapshot;
+
+		std::vector<char> names{};
+		std::vector<char> folded{};
+		std::vector<std::uint32_t> offsets{0};
+
+		std::vector<Id> directoryIds{};
+		std::vector<Id> rootIds{};
+		std::vector<std::uint64_t> sizes{};
+		std::vector<std::uint16_t> permissions{};
+		std::vector<std::uint64_t> mtimes{};
+		std::vector<std::uint8_t> pending{};
+		std::vector<ExtensionId> extensionIds{};
+		std::vector<std::uint8_t> types{};
+
+		Directories directories{};
+		Trigrams trigrams{};
+
+		std::vector<std::string> extensions{""};
+		std::unordered_map<std::string, ExtensionId> extensionLookup{{"", 0}};
+		std::vector<FileType> extensionTypes{FileType::Generic};
+		std::vector<Bitmap> extensionBitmaps = std::vector<Bitmap>(1);
+		std::vector<Bitmap> typeBitmaps = std::vector<Bitmap>(FileTypeCount);
+		// Maps root ids to the directory ids of the root folders, InvalidId for retired roots.
+		std::vector<Id> roots{};
+		// The other way around, maps the directory ids of the root folders to their root ids.
+		std::unordered_map<Id, Id> rootLookup{};
+		std::vector<bool> completeRoots{};
+		std::vector<std::uint64_t> directoryStamps{};
+		std::vector<Id> directoryAliases{};
+
+		std::size_t deadRows = 0;
+		std::size_t pendingRows = 0;
+		std::uint64_t modifications = 0;
+		std::uint64_t compactions = 0;
+		std::uint64_t metadataModifications = 0;
+		std::vector<std::uint64_t> rootModifications{};
+		std::vector<Id> pinnedRows{};
+
+		ExtensionId internExtension(const std::string_view foldedName);
+		void rebuildBitmaps();
+		void kill(const Id row);
+		void compactIfNeeded();
+};
+
+#endif // NOTHING_INDEX_HPP
@@ -0,0 +1,68 @@
+/*
+	Copyright (c) 2019 Kamil Chojnowski Y29udGFjdEBkaWF0aC5uZXQ=
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in the
+	Software without restriction, including without limitation the rights to use,
+	copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+	THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "inodeset.hpp"
+
+std::size_t InodeSet::Hash::operator ()(const Key &key) const
+{
+	// NOTE: Inodes are mostly sequential, the multiplications spread them over both the shards and the buckets.
+	auto hash = key.inode * 0x9E3779B97F4A7C15ull ^ key.device;
+	hash ^= hash >> 32;
+	hash *= 0xD6E8FEB86659FD93ull;
+	hash ^= hash >> 32;
+	return static_cast<std::size_t>(hash);
+}
+
+std::uint32_t InodeSet::insert(const std::uint64_t device, const std::uint64_t inode, const std::uint32_t value)
+{
+	const Key key{device, inode};
+	auto &shard = this->shard(key);
+
+	std::lock_guard<std::mutex> lock{shard.mutex};
+	return shard.values.try_emplace(key, value).first->second;
+}
+
+void InodeSet::assign(const std::uint64_t device, const std::uint64_t inode, const std::uint32_t value)
+{
+	const Key key{device, inode};
+	auto &shard = this->shard(key);
+
+	std::lock_guard<std::mutex> lock{shard.mutex};
+	shard.values[key] = value;
+}
+
+void InodeSet::erase(const std::vector<bool> &values)
+{
+	for (auto &shard: shards) {
+		std::lock_guard<std::mutex> lock{shard.mutex};
+		for (auto it = shard.values.begin(); it != shard.values.end();) {
+			if (it->second < values.size() && values[it->second]) {
+				it = shard.values.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+}
+
+void InodeSet::clear()
+{
+	for (auto &shard: shards) {
+		std::lock_guard<std::mutex> lock{shard.mutex};
+		shard.values.clear();
+	}
+}
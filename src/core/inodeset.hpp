@@ -0,0 +1,80 @@
+/*
+	Copyright (c) 2019 Kamil Chojnowski Y29udGFjdEBkaWF0aC5uZXQ=
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in the
+	Software without restriction, including without limitation the rights to use,
+	copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+	THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef NOTHING_INODESET_HPP
+#define NOTHING_INODESET_HPP
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/*
+	Remembers which directory was first seen under a given device and inode, shared by every scanning thread.
+
+	The same directory can be reached through several paths when a bind mount makes a tree show up twice or two
+	roots overlap that way. The set is split into shards with a lock each, picked by the hash of the key, so the
+	threads listing different directories rarely wait on one another.
+*/
+class InodeSet
+{
+	public:
+		InodeSet() = default;
+
+		InodeSet(const InodeSet &) = delete;
+		InodeSet(InodeSet &&) = delete;
+
+		InodeSet &operator =(const InodeSet &) = delete;
+		InodeSet &operator =(InodeSet &&) = delete;
+
+		// Returns the value stored for the inode, after storing the given one if there was none yet.
+		std::uint32_t insert(const std::uint64_t device, const std::uint64_t inode, const std::uint32_t value);
+		// Stores the value for the inode whether there was one or not.
+		void assign(const std::uint64_t device, const std::uint64_t inode, const std::uint32_t value);
+		// Drops the inodes whose value is set in the mask, values past its end are kept.
+		void erase(const std::vector<bool> &values);
+		void clear();
+
+	private:
+		static constexpr std::size_t ShardCount = 64;
+
+		struct Key
+		{
+			std::uint64_t device = 0;
+			std::uint64_t inode = 0;
+
+			bool operator ==(const Key &other) const { return device == other.device && inode == other.inode; }
+		};
+
+		struct Hash
+		{
+			std::size_t operator ()(const Key &key) const;
+		};
+
+		struct alignas(64) Shard
+		{
+			std::mutex mutex{};
+			std::unordered_map<Key, std::uint32_t, Hash> values{};
+		};
+
+		std::array<Shard, ShardCount> shards{};
+
+		Shard &shard(const Key &key) { return shards[Hash{}(key) % ShardCount]; }
+};
+
+#endif // NOTHING_INODESET_HPP
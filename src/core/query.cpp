@@ -0,0 +1,991 @@
+/*
+	Copyright (c) 2019 Kamil Chojnowski Y29udGFjdEBkaWF0aC5uZXQ=
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in the
+	Software without restriction, including without limitation the rights to use,
+	copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+	THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+
+#include "query.hpp"
+#include "search.hpp"
+
+namespace {
+
+constexpr int MaxDepth = 256;
+
+constexpr std::uint64_t Unbounded = std::numeric_limits<std::uint64_t>::max();
+// Relative to checking a name, what stat'ing a file costs.
+constexpr double StatCost = 100.0;
+
+inline bool IsSpace(const char ch)
+{
+	return std::isspace(static_cast<unsigned char>(ch)) != 0;
+}
+
+// Appends the rows of the bitmap that have not been removed since it was built.
+void AppendAlive(const Index &index, const Bitmap &rows, std::vector<Index::Id> &out)
+{
+	const auto start = out.size();
+	rows.toVector(out);
+	out.erase(std::remove_if(out.begin() + start, out.end(), [&index] (const Index::Id row) {
+		return !index.alive(row);
+	}), out.end());
+}
+
+std::string Fold(const std::string_view text)
+{
+	std::string result(text.size(), '\0');
+	FoldCase(text.data(), text.data() + text.size(), result.data());
+	return result;
+}
+
+// Parses a size such as 10, 1.5mb or 3k into bytes, units are powers of 1024.
+bool ParseSize(const std::string_view text, std::uint64_t &out)
+{
+	std::size_t index = 0;
+	double value = 0.0;
+	bool digits = false;
+
+	while (index < text.size() && std::isdigit(static_cast<unsigned char>(text[index]))) {
+		value = value * 10.0 + (text[index++] - '0');
+		digits = true;
+	}
+
+	if (index < text.size() && text[index] == '.') {
+		double scale = 0.1;
+		for (++index; index < text.size() && std::isdigit(static_cast<unsigned char>(text[index])); ++index) {
+			value += (text[index] - '0') * scale;
+			scale /= 10.0;
+			digits = true;
+		}
+	}
+
+	if (!digits) {
+		return false;
+	}
+
+	const auto unit = Fold(text.substr(index));
+	if (unit == "k" || unit == "kb") {
+		value *= 1024.0;
+	} else if (unit == "m" || unit == "mb") {
+		value *= 1024.0 * 1024.0;
+	} else if (unit == "g" || unit == "gb") {
+		value *= 1024.0 * 1024.0 * 1024.0;
+	} else if (unit == "t" || unit == "tb") {
+		value *= 1024.0 * 1024.0 * 1024.0 * 1024.0;
+	} else if (!unit.empty() && unit != "b") {
+		return false;
+	}
+
+	if (value >= 18446744073709551615.0) {
+		return false;
+	}
+
+	out = static_cast<std::uint64_t>(value);
+	return true;
+}
+
+} // namespace <anonymous>
+
+/*
+	Recursive descent parser for the query grammar:
+
+		or    := and (('|' | OR) and)*
+		and   := unary (AND? unary)*
+		unary := ('!' | NOT) unary | '(' or ')' | term
+		term  := word | "quoted text" | filter:value
+
+	The keywords are only recognized in upper case, so that lowercase words can still be searched for.
+*/
+class QueryParser
+{
+	public:
+		QueryParser(Query &query, const std::string_view text)
+		: query{query}
+		, text{text}
+		{
+		}
+
+		bool parse() {
+			skipSpace();
+			if (position == text.size()) {
+				Query::Node node{};
+				node.type = Query::NodeType::Name;
+				query.root = add(std::move(node));
+				return true;
+			}
+
+			const auto root = parseOr();
+			skipSpace();
+
+			if (root == -1 || position != text.size()) {
+				return false;
+			}
+
+			query.root = root;
+			return true;
+		}
+
+	private:
+		Query &query;
+		std::string_view text{};
+		std::size_t position = 0;
+		int depth = 0;
+
+		int add(Query::Node &&node) {
+			query.nodes.push_back(std::move(node));
+			return static_cast<int>(query.nodes.size() - 1);
+		}
+
+		int addComposite(const Query::NodeType type, std::vector<int> &&children) {
+			if (children.size() == 1 && type != Query::NodeType::Not) {
+				return children.front();
+			}
+
+			Query::Node node{};
+			node.type = type;
+			node.children = std::move(children);
+			return add(std::move(node));
+		}
+
+		void skipSpace() {
+			while (position < text.size() && IsSpace(text[position])) {
+				++position;
+			}
+		}
+
+		bool atKeyword(const std::string_view keyword) const {
+			if (text.substr(position, keyword.size()) != keyword) {
+				return false;
+			}
+
+			const auto next = position + keyword.size();
+			return next == text.size() || IsSpace(text[next]) || text[next] == '(' || text[next] == '"';
+		}
+
+		bool atEndOfAnd() const {
+			return position == text.size() || text[position] == '|' || (text[position] == ')' && depth > 0) || atKeyword("OR");
+		}
+
+		int parseOr() {
+			std::vector<int> children{};
+			while (true) {
+				const auto child = parseAnd();
+				if (child == -1) {
+					return -1;
+				}
+
+				children.push_back(child);
+
+				skipSpace();
+				if (position < text.size() && text[position] == '|') {
+					++position;
+				} else if (atKeyword("OR")) {
+					position += 2;
+				} else {
+					break;
+				}
+			}
+
+			return addComposite(Query::NodeType::Or, std::move(children));
+		}
+
+		int parseAnd() {
+			std::vector<int> children{};
+			while (true) {
+				skipSpace();
+				if (atEndOfAnd()) {
+					break;
+				}
+
+				if (atKeyword("AND")) {
+					position += 3;
+					continue;
+				}
+
+				const auto child = parseUnary();
+				if (child == -1) {
+					return -1;
+				}
+
+				children.push_back(child);
+			}
+
+			if (children.empty()) {
+				return -1;
+			}
+
+			return addComposite(Query::NodeType::And, std::move(children));
+		}
+
+		int parseUnary() {
+			if (depth >= MaxDepth) {
+				return -1;
+			}
+
+			skipSpace();
+			if (atEndOfAnd()) {
+				return -1;
+			}
+
+			if (text[position] == '!' || atKeyword("NOT")) {
+				position += text[position] == '!' ? 1 : 3;
+
+				++depth;
+				const auto child = parseUnary();
+				--depth;
+
+				if (child == -1) {
+					return -1;
+				}
+
+				return addComposite(Query::NodeType::Not, {child});
+			}
+
+			if (text[position] == '(') {
+				++position;
+
+				++depth;
+				const auto child = parseOr();
+				--depth;
+
+				skipSpace();
+				if (child == -1 || position == text.size() || text[position] != ')') {
+					return -1;
+				}
+
+				++position;
+				return child;
+			}
+
+			return parseTerm();
+		}
+
+		int parseTerm() {
+			std::string word{};
+			std::string prefix{};
+			bool hasPrefix = false;
+			bool quoted = false;
+
+			while (position < text.size()) {
+				const auto ch = text[position];
+				if (ch == '"') {
+					quoted = true;
+					++position;
+
+					while (position < text.size() && text[position] != '"') {
+						word += text[position++];
+					}
+
+					// NOTE: An unterminated quote runs to the end of the query, which is what happens while it is being typed.
+					if (position < text.size()) {
+						++position;
+					}
+
+					continue;
+				}
+
+				if (IsSpace(ch) || ch == '|' || (ch == ')' && depth > 0)) {
+					break;
+				}
+
+				// NOTE: Only an unquoted word followed by a colon can name a filter, "ext:" in quotes is searched for literally.
+				if (ch == ':' && !quoted && !hasPrefix) {
+					prefix = Fold(word);
+					hasPrefix = true;
+				}
+
+				word += ch;
+				++position;
+			}
+
+			if (hasPrefix) {
+				const auto value = std::string_view{word}.substr(prefix.size() + 1);
+				if (prefix == "ext") {
+					return parseExtension(value);
+				} else if (prefix == "size") {
+					return parseSize(value);
+				} else if (prefix == "path") {
+					Query::Node node{};
+					node.type = Query::NodeType::Path;
+					node.text = Fold(value);
+					return add(std::move(node));
+				} else if (prefix == "type") {
+					return parseType(value);
+				} else if (prefix == "perm") {
+					return parsePerms(value);
+				}
+			}
+
+			Query::Node node{};
+			node.type = Query::NodeType::Name;
+			node.text = Fold(word);
+			return add(std::move(node));
+		}
+
+		int parseExtension(const std::string_view value) {
+			Query::Node node{};
+			node.type = Query::NodeType::Extension;
+
+			std::size_t start = 0;
+			for (std::size_t i = 0; i <= value.size(); ++i) {
+				if (i != value.size() && value[i] != ';' && value[i] != ',') {
+					continue;
+				}
+
+				auto extension = value.substr(start, i - start);
+				if (!extension.empty() && extension.front() == '.') {
+					extension.remove_prefix(1);
+				}
+
+				node.extensions.push_back(Fold(extension));
+				start = i + 1;
+			}
+
+			return add(std::move(node));
+		}
+
+		int parseSize(const std::string_view value) {
+			Query::Node node{};
+			node.type = Query::NodeType::Size;
+
+			if (value.empty() || Fold(value) == "empty") {
+				node.maximum = 0;
+				return add(std::move(node));
+			}
+
+			if (const auto range = value.find(".."); range != std::string_view::npos) {
+				const auto first = value.substr(0, range);
+				const auto last = value.substr(range + 2);
+
+				if ((!first.empty() && !ParseSize(first, node.minimum)) || (!last.empty() && !ParseSize(last, node.maximum))) {
+					return -1;
+				}
+
+				return add(std::move(node));
+			}
+
+			auto operand = value;
+			std::string_view op{};
+			for (const std::string_view candidate: {"<=", ">=", "<", ">", "="}) {
+				if (operand.substr(0, candidate.size()) == candidate) {
+					op = candidate;
+					operand.remove_prefix(candidate.size());
+					break;
+				}
+			}
+
+			std::uint64_t size = 0;
+			if (!ParseSize(operand, size)) {
+				return -1;
+			}
+
+			if (op == "<") {
+				// NOTE: Nothing is smaller than zero, an empty range never matches.
+				node.minimum = size == 0 ? 1 : 0;
+				node.maximum = size == 0 ? 0 : size - 1;
+			} else if (op == "<=") {
+				node.maximum = size;
+			} else if (op == ">") {
+				node.minimum = size == Unbounded ? Unbounded : size + 1;
+			} else if (op == ">=") {
+				node.minimum = size;
+			} else {
+				node.minimum = size;
+				node.maximum = size;
+			}
+
+			return add(std::move(node));
+		}
+
+		int parseType(const std::string_view value) {
+			static const std::pair<std::string_view, FileType> Types[] = {
+				{"generic", FileType::Generic},
+				{"document", FileType::Document},
+				{"image", FileType::Image},
+				{"video", FileType::Video},
+				{"audio", FileType::Audio},
+				{"archive", FileType::Archive},
+				{"system", FileType::System},
+			};
+
+			const auto name = Fold(value);
+			for (const auto &[typeName, type]: Types) {
+				if (name == typeName) {
+					Query::Node node{};
+					node.type = Query::NodeType::Type;
+					node.fileType = type;
+					return add(std::move(node));
+				}
+			}
+
+			return -1;
+		}
+
+		int parsePerms(const std::string_view value) {
+			Query::Node node{};
+			node.type = Query::NodeType::Perms;
+
+			if (value.empty() || value.size() > 4) {
+				return -1;
+			}
+
+			if (std::all_of(value.begin(), value.end(), [] (const char ch) { return ch >= '0' && ch <= '7'; })) {
+				for (const auto ch: value) {
+					node.perms = static_cast<std::uint16_t>((node.perms << 3) | (ch - '0'));
+				}
+
+				node.permsMask = value.size() == 4 ? 07777 : 0777;
+				return add(std::move(node));
+			}
+
+			for (const auto ch: value) {
+				std::uint16_t bit = 0;
+				if (ch == 'r') {
+					bit = 0400;
+				} else if (ch == 'w') {
+					bit = 0200;
+				} else if (ch == 'x') {
+					bit = 0100;
+				}
+
+				if (bit == 0 || (node.perms & bit)) {
+					return -1;
+				}
+
+				node.perms |= bit;
+			}
+
+			node.permsMask = node.perms;
+			return add(std::move(node));
+		}
+};
+
+bool Query::usesMetadata() const
+{
+	return std::any_of(nodes.begin(), nodes.end(), [] (const Node &node) {
+		return node.type == NodeType::Size || node.type == NodeType::Perms;
+	});
+}
+
+bool Query::parse(const std::string_view text)
+{
+	nodes.clear();
+	root = -1;
+
+	QueryParser parser{*this, text};
+	if (!parser.parse()) {
+		nodes.clear();
+		root = -1;
+		return false;
+	}
+
+	return true;
+}
+
+void Query::prepare(const Index &index)
+{
+	if (root != -1) {
+		prepareNode(index, root);
+	}
+}
+
+void Query::prepareNode(const Index &index, const int id)
+{
+	auto &node = nodes[id];
+	const auto rows = static_cast<double>(std::max<std::size_t>(index.liveRows(), 1));
+	// NOTE: Checking the size or permissions of a row still waiting for its metadata costs a stat.
+	const auto pendingCost = StatCost * static_cast<double>(index.pendingMetadata()) / rows;
+
+	switch (node.type) {
+		case NodeType::And: {
+			for (const auto child: node.children) {
+				prepareNode(index, child);
+			}
+
+			/*
+				The classic predicate ordering: an operand is worth running early if it is cheap and rejects a lot of
+				rows, later operands only ever see the rows that passed all the ones before them.
+			*/
+			auto rank = [this] (const int child) {
+				const auto &node = nodes[child];
+				return node.selectivity >= 1.0 ? std::numeric_limits<double>::infinity() : node.cost / (1.0 - node.selectivity);
+			};
+
+			std::stable_sort(node.children.begin(), node.children.end(), [&rank] (const int lhs, const int rhs) {
+				return rank(lhs) < rank(rhs);
+			});
+
+			node.cost = 0.0;
+			node.selectivity = 1.0;
+			for (const auto child: node.children) {
+				node.cost += nodes[child].cost * node.selectivity;
+				node.selectivity *= nodes[child].selectivity;
+			}
+		} break;
+
+		case NodeType::Or: {
+			for (const auto child: node.children) {
+				prepareNode(index, child);
+			}
+
+			// NOTE: The other way around, operands likely to match go first since the rows they accept are not checked again.
+			std::stable_sort(node.children.begin(), node.children.end(), [this] (const int lhs, const int rhs) {
+				return nodes[lhs].selectivity / nodes[lhs].cost > nodes[rhs].selectivity / nodes[rhs].cost;
+			});
+
+			double remaining = 1.0;
+			node.cost = 0.0;
+			for (const auto child: node.children) {
+				node.cost += nodes[child].cost * remaining;
+				remaining *= 1.0 - nodes[child].selectivity;
+			}
+
+			node.selectivity = 1.0 - remaining;
+		} break;
+
+		case NodeType::Not: {
+			prepareNode(index, node.children.front());
+			node.cost = nodes[node.children.front()].cost;
+			node.selectivity = 1.0 - nodes[node.children.front()].selectivity;
+		} break;
+
+		case NodeType::Name: {
+			const auto estimate = index.estimate(node.text);
+			if (estimate != std::numeric_limits<std::size_t>::max()) {
+				node.selectivity = std::min(1.0, static_cast<double>(estimate) / rows);
+			} else {
+				node.selectivity = node.text.empty() ? 1.0 : (node.text.size() == 1 ? 0.5 : 0.2);
+			}
+
+			node.cost = 1.0;
+		} break;
+
+		case NodeType::Extension: {
+			node.extensionIds.clear();
+
+			std::size_t matched = 0;
+			for (const auto &extension: node.extensions) {
+				const auto id = index.findExtension(extension);
+				if (id != Index::InvalidId && std::find(node.extensionIds.begin(), node.extensionIds.end(), id) == node.extensionIds.end()) {
+					node.extensionIds.push_back(id);
+					matched += index.extensionBitmap(id).cardinality();
+				}
+			}
+
+			node.cost = 0.25;
+			node.selectivity = std::min(1.0, static_cast<double>(matched) / rows);
+		} break;
+
+		case NodeType::Size: {
+			node.cost = 0.25 + pendingCost;
+			node.selectivity = (node.minimum > 0 && node.maximum != Unbounded) ? 0.1 : 0.3;
+		} break;
+
+		case NodeType::Perms: {
+			node.cost = 0.25 + pendingCost;
+			node.selectivity = 0.3;
+		} break;
+
+		case NodeType::Type: {
+			node.cost = 0.25;
+			node.selectivity = std::min(1.0, static_cast<double>(index.typeBitmap(node.fileType).cardinality()) / rows);
+		} break;
+
+		case NodeType::Path: {
+			/*
+				Paths are never built per row. Directories are visited parents first, each one inherits the match
+				of its parent and otherwise only has to check the text against the tail of the parent path followed
+				by its own name. Rows then check their directory, and the tail followed by their name.
+			*/
+			const auto count = index.directoryCount();
+			const auto keep = node.text.empty() ? 0 : node.text.size() - 1;
+
+			node.directories.assign(count, false);
+			node.tails.assign(count, {});
+
+			std::size_t matched = 0;
+			for (Id directory = 0; directory < count; ++directory) {
+				const auto parent = index.directoryParent(directory);
+
+				std::string path = parent == Index::InvalidId ? std::string{} : node.tails[parent];
+				path += Fold(index.directoryName(directory));
+				path += '/';
+
+				node.directories[directory] = (parent != Index::InvalidId && node.directories[parent]) || path.find(node.text) != std::string::npos;
+				node.tails[directory] = path.substr(path.size() - std::min(path.size(), keep));
+				matched += node.directories[directory];
+			}
+
+			node.cost = 0.5;
+			node.selectivity = count == 0 ? 1.0 : std::max(0.01, static_cast<double>(matched) / static_cast<double>(count));
+		} break;
+	}
+}
+
+std::size_t Query::estimate(const Index &index, const int id) const
+{
+	constexpr auto Unknown = std::numeric_limits<std::size_t>::max();
+	const auto &node = nodes[id];
+
+	if (node.type == NodeType::Name) {
+		return index.estimate(node.text);
+	}
+
+	// NOTE: The bitmaps still count removed rows, which only makes the estimates a bit pessimistic.
+	if (node.type == NodeType::Extension) {
+		std::size_t result = 0;
+		for (const auto extension: node.extensionIds) {
+			result += index.extensionBitmap(extension).cardinality();
+		}
+
+		return result;
+	}
+
+	if (node.type == NodeType::Type) {
+		return index.typeBitmap(node.fileType).cardinality();
+	}
+
+	if (node.type == NodeType::And) {
+		std::size_t result = Unknown;
+		for (const auto child: node.children) {
+			result = std::min(result, estimate(index, child));
+		}
+
+		return result;
+	}
+
+	if (node.type == NodeType::Or) {
+		std::size_t result = 0;
+		for (const auto child: node.children) {
+			const auto count = estimate(index, child);
+			if (count == Unknown) {
+				return Unknown;
+			}
+
+			result += count;
+		}
+
+		return result;
+	}
+
+	return Unknown;
+}
+
+bool Query::candidates(const Index &index, std::vector<Id> &out) const
+{
+	if (root == -1) {
+		return false;
+	}
+
+	const auto count = estimate(index, root);
+	if (count == std::numeric_limits<std::size_t>::max() || count * Index::CandidatesMaxShare > index.liveRows()) {
+		return false;
+	}
+
+	return candidates(index, root, out);
+}
+
+bool Query::candidates(const Index &index, const int id, std::vector<Id> &out) const
+{
+	const auto &node = nodes[id];
+
+	if (node.type == NodeType::Name) {
+		return index.findIndexed(node.text, out);
+	}
+
+	Bitmap rows{};
+	if (node.type == NodeType::Extension || node.type == NodeType::Type) {
+		bitmap(index, id, rows);
+		AppendAlive(index, rows, out);
+		return true;
+	}
+
+	if (node.type == NodeType::And) {
+		int best = -1;
+		std::size_t bestCount = std::numeric_limits<std::size_t>::max();
+
+		for (const auto child: node.children) {
+			const auto count = estimate(index, child);
+			if (count < bestCount) {
+				best = child;
+				bestCount = count;
+			}
+		}
+
+		// NOTE: Several bitmap operands intersect to fewer rows than any one of them, use that if it beats the best single operand.
+		if (bitmap(index, id, rows) && rows.cardinality() <= bestCount) {
+			AppendAlive(index, rows, out);
+			return true;
+		}
+
+		return best != -1 && candidates(index, best, out);
+	}
+
+	if (node.type == NodeType::Or) {
+		std::vector<Id> merged{};
+		std::vector<Id> part{};
+		std::vector<Id> combined{};
+
+		for (const auto child: node.children) {
+			part.clear();
+			if (!candidates(index, child, part)) {
+				return false;
+			}
+
+			combined.clear();
+			std::set_union(merged.begin(), merged.end(), part.begin(), part.end(), std::back_inserter(combined));
+			merged.swap(combined);
+		}
+
+		out.insert(out.end(), merged.begin(), merged.end());
+		return true;
+	}
+
+	return false;
+}
+
+bool Query::bitmap(const Index &index, const int id, Bitmap &out) const
+{
+	const auto &node = nodes[id];
+
+	switch (node.type) {
+		case NodeType::Extension:
+			out.clear();
+			for (const auto extension: node.extensionIds) {
+				out |= index.extensionBitmap(extension);
+			}
+
+			return true;
+
+		case NodeType::Type:
+			out = index.typeBitmap(node.fileType);
+			return true;
+
+		case NodeType::And: {
+			// The operands without a bitmap are left to filter(), the result is a superset of the matches either way.
+			bool found = false;
+			Bitmap part{};
+
+			for (const auto child: node.children) {
+				if (!bitmap(index, child, part)) {
+					continue;
+				}
+
+				if (found) {
+					out &= part;
+				} else {
+					out = std::move(part);
+					found = true;
+				}
+			}
+
+			return found;
+		}
+
+		case NodeType::Or: {
+			Bitmap merged{};
+			Bitmap part{};
+
+			for (const auto child: node.children) {
+				if (!bitmap(index, child, part)) {
+					return false;
+				}
+
+				merged |= part;
+			}
+
+			out = std::move(merged);
+			return true;
+		}
+
+		default:
+			return false;
+	}
+}
+
+void Query::filter(const Index &index, const std::vector<Id> &rows, std::vector<Id> &out) const
+{
+	if (root != -1) {
+		evaluate(index, root, 0, 0, &rows, out);
+	}
+}
+
+void Query::scan(const Index &index, const Id begin, const Id end, std::vector<Id> &out) const
+{
+	if (root != -1) {
+		evaluate(index, root, begin, end, nullptr, out);
+	}
+}
+
+bool Query::matches(const Index &index, const Node &node, const Id row) const
+{
+	switch (node.type) {
+		case NodeType::Name:
+			return index.foldedName(row).find(node.text) != std::string_view::npos;
+
+		case NodeType::Extension:
+			return std::find(node.extensionIds.begin(), node.extensionIds.end(), index.extension(row)) != node.extensionIds.end();
+
+		case NodeType::Size: {
+			auto size = index.size(row);
+			if (!index.hasMetadata(row)) {
+				std::uint16_t perms = 0;
+				if (!resolver || !resolver(row, size, perms)) {
+					return false;
+				}
+			}
+
+			return size >= node.minimum && size <= node.maximum;
+		}
+
+		case NodeType::Path: {
+			const auto directory = index.directory(row);
+			if (node.directories[directory]) {
+				return true;
+			}
+
+			auto path = node.tails[directory];
+			path += index.foldedName(row);
+			return path.find(node.text) != std::string::npos;
+		}
+
+		case NodeType::Type:
+			return index.type(row) == node.fileType;
+
+		case NodeType::Perms: {
+			auto perms = index.perms(row);
+			if (!index.hasMetadata(row)) {
+				std::uint64_t size = 0;
+				if (!resolver || !resolver(row, size, perms)) {
+					return false;
+				}
+			}
+
+			return (perms & node.permsMask) == node.perms;
+		}
+
+		default:
+			return false;
+	}
+}
+
+void Query::evaluate(const Index &index, const int id, const Id begin, const Id end, const std::vector<Id> *input, std::vector<Id> &out) const
+{
+	const auto &node = nodes[id];
+
+	switch (node.type) {
+		case NodeType::And: {
+			std::vector<Id> rows{};
+			std::vector<Id> next{};
+
+			auto source = input;
+			for (const auto child: node.children) {
+				next.clear();
+				evaluate(index, child, begin, end, source, next);
+
+				rows.swap(next);
+				source = &rows;
+
+				if (rows.empty()) {
+					break;
+				}
+			}
+
+			out.insert(out.end(), rows.begin(), rows.end());
+		} break;
+
+		case NodeType::Or: {
+			std::vector<Id> result{};
+			std::vector<Id> matched{};
+			std::vector<Id> combined{};
+			std::vector<Id> remaining{};
+			std::vector<Id> rest{};
+
+			if (input) {
+				remaining = *input;
+			}
+
+			for (const auto child: node.children) {
+				matched.clear();
+				evaluate(index, child, begin, end, input ? &remaining : nullptr, matched);
+
+				combined.clear();
+				std::set_union(result.begin(), result.end(), matched.begin(), matched.end(), std::back_inserter(combined));
+				result.swap(combined);
+
+				// NOTE: When filtering, the rows an operand accepted do not have to be shown to the next ones.
+				if (input) {
+					rest.clear();
+					std::set_difference(remaining.begin(), remaining.end(), matched.begin(), matched.end(), std::back_inserter(rest));
+					remaining.swap(rest);
+
+					if (remaining.empty()) {
+						break;
+					}
+				}
+			}
+
+			out.insert(out.end(), result.begin(), result.end());
+		} break;
+
+		case NodeType::Not: {
+			std::vector<Id> excluded{};
+			evaluate(index, node.children.front(), begin, end, input, excluded);
+
+			if (input) {
+				std::set_difference(input->begin(), input->end(), excluded.begin(), excluded.end(), std::back_inserter(out));
+				break;
+			}
+
+			auto it = excluded.begin();
+			for (auto row = begin; row < end; ++row) {
+				if (it != excluded.end() && *it == row) {
+					++it;
+					continue;
+				}
+
+				if (index.alive(row)) {
+					out.push_back(row);
+				}
+			}
+		} break;
+
+		default: {
+			if (input) {
+				for (const auto row: *input) {
+					if (matches(index, node, row)) {
+						out.push_back(row);
+					}
+				}
+
+				break;
+			}
+
+			// NOTE: Name substrings over a whole range go through the SIMD scan instead of row by row checks.
+			if (node.type == NodeType::Name) {
+				index.find(node.text, begin, end, out);
+				break;
+			}
+
+			for (auto row = begin; row < end; ++row) {
+				if (index.alive(row) && matches(index, node, row)) {
+					out.push_back(row);
+				}
+			}
+		} break;
+	}
+}
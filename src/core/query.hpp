@@ -0,0 +1,143 @@
+/*
+	Copyright (c) 2019 Kamil Chojnowski Y29udGFjdEBkaWF0aC5uZXQ=
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in the
+	Software without restriction, including without limitation the rights to use,
+	copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+	THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef NOTHING_QUERY_HPP
+#define NOTHING_QUERY_HPP
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bitmap.hpp"
+#include "index.hpp"
+#include "utils.hpp"
+
+/*
+	Structured search queries.
+
+	A query is a list of terms that all have to match. A plain term matches a case-insensitive substring of the
+	file name (quote it to include spaces or operators), the others are filters:
+
+		ext:jpg;png     the extension (the text after the last dot) is one of the listed ones, an empty one stands for none
+		size:>10mb      the size compares against the value (<, <=, >, >=, = or a min..max range, empty for zero)
+		path:src/core   the full path contains the text
+		type:image      the file type is the given one, see GetFileType()
+		perm:755        the permission bits are exactly the given octal value, perm:rx checks the owner rights
+
+	Terms are negated with ! or NOT, joined with | or OR and grouped with parentheses.
+
+	The planner orders the operands of every AND so that the cheapest and most selective ones run first and
+	only see the rows that survived the earlier ones. When the query allows it the trigram index or the extension
+	and type bitmaps pick the candidate rows, otherwise the caller scans the table in partitions.
+*/
+class Query
+{
+	public:
+		using Id = Index::Id;
+		// Reads the size and permissions of a row the index has no metadata for yet, returns false if they cannot be read.
+		using MetadataResolver = std::function<bool(const Id, std::uint64_t &, std::uint16_t &)>;
+
+		Query() = default;
+
+		Query(const Query &) = delete;
+		Query(Query &&) = delete;
+
+		Query &operator =(const Query &) = delete;
+		Query &operator =(Query &&) = delete;
+
+		// Returns false if the text is not a valid query.
+		bool parse(const std::string_view text);
+
+		// True if the whole query is a single name substring, which callers can serve through the dedicated substring paths.
+		bool isSubstring() const { return root != -1 && nodes[root].type == NodeType::Name; }
+		// The lowercased substring of such a query.
+		const std::string &substring() const { return nodes[root].text; }
+		// True if the query filters on the size or permissions of the files, so its results change as the metadata is read.
+		bool usesMetadata() const;
+
+		// Computes the per-query lookup tables and the evaluation order, has to be called again whenever the index changes.
+		void prepare(const Index &index);
+
+		// Without a resolver, rows that have no metadata yet never match size and perm filters. It is called from several threads at once.
+		void setMetadataResolver(MetadataResolver resolver) { this->resolver = std::move(resolver); }
+
+		/*
+			Fills the sorted superset of the matching rows from the trigram index, returns false if the query cannot
+			be narrowed down that way or the candidates would not be much fewer than the rows.
+		*/
+		bool candidates(const Index &index, std::vector<Id> &out) const;
+
+		// Both append the matching rows in ascending order, filter() checks the given sorted rows, scan() the [begin, end) range.
+		void filter(const Index &index, const std::vector<Id> &rows, std::vector<Id> &out) const;
+		void scan(const Index &index, const Id begin, const Id end, std::vector<Id> &out) const;
+
+	private:
+		enum class NodeType
+		{
+			And,
+			Or,
+			Not,
+			Name,
+			Extension,
+			Size,
+			Path,
+			Type,
+			Perms,
+		};
+
+		struct Node
+		{
+			NodeType type = NodeType::And;
+			std::vector<int> children{};
+
+			std::string text{};
+			std::vector<std::string> extensions{};
+			// Filled by prepare() for extension filters, the ids of the listed extensions the index knows about.
+			std::vector<Index::ExtensionId> extensionIds{};
+			std::uint64_t minimum = 0;
+			std::uint64_t maximum = std::numeric_limits<std::uint64_t>::max();
+			FileType fileType = FileType::Generic;
+			std::uint16_t perms = 0;
+			std::uint16_t permsMask = 0;
+
+			// Filled by prepare(), the expected cost of checking a row and the expected share of rows that match.
+			double cost = 1.0;
+			double selectivity = 1.0;
+
+			// Filled by prepare() for path filters, which directories match and the tail of every directory path.
+			std::vector<bool> directories{};
+			std::vector<std::string> tails{};
+		};
+
+		std::vector<Node> nodes{};
+		int root = -1;
+		MetadataResolver resolver{};
+
+		void prepareNode(const Index &index, const int node);
+		std::size_t estimate(const Index &index, const int node) const;
+		bool candidates(const Index &index, const int node, std::vector<Id> &out) const;
+		bool bitmap(const Index &index, const int node, Bitmap &out) const;
+		bool matches(const Index &index, const Node &node, const Id row) const;
+		void evaluate(const Index &index, const int node, const Id begin, const Id end, const std::vector<Id> *input, std::vector<Id> &out) const;
+
+		friend class QueryParser;
+};
+
+#endif // NOTHING_QUERY_HPP
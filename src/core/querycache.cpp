@@ -0,0 +1,101 @@
+/*
+	Copyright (c) 2019 Kamil Chojnowski Y29udGFjdEBkaWF0aC5uZXQ=
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in the
+	Software without restriction, including without limitation the rights to use,
+	copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+	THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "querycache.hpp"
+
+QueryCache::QueryCache(const std::size_t capacity)
+: capacity{capacity}
+{
+}
+
+bool QueryCache::find(const Key &key, const Stamp &stamp, std::vector<Index::Id> &rows)
+{
+	std::lock_guard<std::mutex> lock{mutex};
+
+	auto it = lookup.find(makeKey(key));
+	if (it == lookup.end()) {
+		return false;
+	}
+
+	auto entry = it->second;
+	if (!(entry->stamp == stamp)) {
+		erase(entry);
+		return false;
+	}
+
+	entries.splice(entries.begin(), entries, entry);
+	rows = entry->rows;
+	return true;
+}
+
+void QueryCache::insert(const Key &key, const Stamp &stamp, const std::vector<Index::Id> &rows)
+{
+	std::lock_guard<std::mutex> lock{mutex};
+
+	auto name = makeKey(key);
+	if (auto it = lookup.find(name); it != lookup.end()) {
+		erase(it->second);
+	}
+
+	const auto cost = sizeof(Entry) + name.size() * 2 + rows.size() * sizeof(Index::Id) + stamp.roots.size() * sizeof(std::uint64_t);
+	if (cost > capacity) {
+		return;
+	}
+
+	while (used + cost > capacity && !entries.empty()) {
+		erase(std::prev(entries.end()));
+	}
+
+	entries.push_front({name, stamp, rows, cost});
+	lookup.emplace(std::move(name), entries.begin());
+	used += cost;
+}
+
+void QueryCache::clear()
+{
+	std::lock_guard<std::mutex> lock{mutex};
+
+	entries.clear();
+	lookup.clear();
+	used = 0;
+}
+
+std::size_t QueryCache::size() const
+{
+	std::lock_guard<std::mutex> lock{mutex};
+	return used;
+}
+
+std::string QueryCache::makeKey(const Key &key)
+{
+	switch (key.mode) {
+		case Mode::Substring:
+			return "p:" + key.pattern;
+		case Mode::Query:
+			return "q:" + key.pattern;
+		case Mode::Regexp:
+		default:
+			return "r:" + key.pattern;
+	}
+}
+
+void QueryCache::erase(std::list<Entry>::iterator it)
+{
+	used -= it->cost;
+	lookup.erase(it->key);
+	entries.erase(it);
+}
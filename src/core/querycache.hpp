@@ -0,0 +1,100 @@
+/*
+	Copyright (c) 2019 Kamil Chojnowski Y29udGFjdEBkaWF0aC5uZXQ=
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in the
+	Software without restriction, including without limitation the rights to use,
+	copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+	THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef NOTHING_QUERYCACHE_HPP
+#define NOTHING_QUERYCACHE_HPP
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "index.hpp"
+
+/*
+	A memory bounded LRU cache of query results.
+
+	Every entry remembers the index generations it was computed at, lookups pass the current ones and entries
+	computed against a different state of the index are dropped instead of being returned.
+*/
+class QueryCache
+{
+	public:
+		// The same text means something else in every mode, so the mode is a part of the key.
+		enum class Mode
+		{
+			Substring,
+			Query,
+			Regexp,
+		};
+
+		struct Key
+		{
+			std::string pattern{};
+			Mode mode = Mode::Substring;
+		};
+
+		struct Stamp
+		{
+			std::uint64_t layout = 0;
+			std::vector<std::uint64_t> roots{};
+			// The metadata generation for queries that filter on metadata, zero for those that only look at names.
+			std::uint64_t metadata = 0;
+
+			bool operator ==(const Stamp &other) const {
+				return layout == other.layout && roots == other.roots && metadata == other.metadata;
+			}
+		};
+
+		explicit QueryCache(const std::size_t capacity);
+
+		QueryCache(const QueryCache &) = delete;
+		QueryCache(QueryCache &&) = delete;
+
+		QueryCache &operator =(const QueryCache &) = delete;
+		QueryCache &operator =(QueryCache &&) = delete;
+
+		bool find(const Key &key, const Stamp &stamp, std::vector<Index::Id> &rows);
+		void insert(const Key &key, const Stamp &stamp, const std::vector<Index::Id> &rows);
+		void clear();
+
+		// The approximate amount of memory held by the cached entries, in bytes.
+		std::size_t size() const;
+
+	private:
+		struct Entry
+		{
+			std::string key{};
+			Stamp stamp{};
+			std::vector<Index::Id> rows{};
+			std::size_t cost = 0;
+		};
+
+		std::size_t capacity = 0;
+		std::size_t used = 0;
+
+		std::list<Entry> entries{};
+		std::unordered_map<std::string, std::list<Entry>::iterator> lookup{};
+		mutable std::mutex mutex{};
+
+		static std::string makeKey(const Key &key);
+		void erase(std::list<Entry>::iterator it);
+};
+
+#endif // NOTHING_QUERYCACHE_HPP
@@ -0,0 +1,824 @@
+/*
+	Copyright (c) 2019 Kamil Chojnowski Y29udGFjdEBkaWF0aC5uZXQ=
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in the
+	Software without restriction, including without limitation the rights to use,
+	copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+	THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <memory>
+
+#include "regex.hpp"
+
+namespace {
+
+constexpr int MaxRepeat = 1000;
+constexpr int MaxDepth = 256;
+constexpr std::size_t MaxStates = 32 * 1024;
+constexpr std::size_t MaxLiteralSize = 256;
+// NOTE: Each DFA state carries a full transition table, flush the cache once it grows past this many states.
+constexpr std::size_t MaxDStates = 2048;
+
+using CharSet = Regex::CharSet;
+
+inline void SetAdd(CharSet &set, const std::uint8_t ch)
+{
+	set[ch >> 6] |= std::uint64_t{1} << (ch & 63);
+}
+
+inline void SetAddRange(CharSet &set, const std::uint8_t first, const std::uint8_t last)
+{
+	for (unsigned ch = first; ch <= last; ++ch) {
+		SetAdd(set, static_cast<std::uint8_t>(ch));
+	}
+}
+
+inline bool SetHas(const CharSet &set, const std::uint8_t ch)
+{
+	return (set[ch >> 6] >> (ch & 63)) & 1;
+}
+
+inline void SetInvert(CharSet &set)
+{
+	for (auto &&word: set) {
+		word = ~word;
+	}
+}
+
+// Returns the only character of the set, or -1 if the set holds zero or more than one character.
+int SetSingle(const CharSet &set)
+{
+	int result = -1;
+	for (unsigned ch = 0; ch < 256; ++ch) {
+		if (SetHas(set, static_cast<std::uint8_t>(ch))) {
+			if (result != -1) {
+				return -1;
+			}
+
+			result = static_cast<int>(ch);
+		}
+	}
+
+	return result;
+}
+
+struct Node
+{
+	enum class Type
+	{
+		Empty,
+		Set,
+		Concat,
+		Alternate,
+		Repeat,
+		Begin,
+		End,
+	};
+
+	explicit Node(const Type type): type{type} {}
+
+	Type type;
+	CharSet set{};
+	std::vector<std::unique_ptr<Node>> children{};
+	int min = 0;
+	int max = 0; // -1 stands for no upper bound
+};
+
+using NodePtr = std::unique_ptr<Node>;
+
+/*
+	Recursive descent parser for the supported ECMAScript subset. Anything the parser is not sure about (including
+	plain syntax errors) yields a null node, letting std::regex make the final call on the pattern.
+*/
+class Parser
+{
+	public:
+		explicit Parser(const std::string_view pattern): pattern{pattern} {}
+
+		NodePtr parse() {
+			auto node = parseAlternation(0);
+			if (!node || position != pattern.size()) {
+				return nullptr;
+			}
+
+			return node;
+		}
+
+	private:
+		std::string_view pattern;
+		std::size_t position = 0;
+
+		bool atEnd() const { return position >= pattern.size(); }
+		char peek() const { return pattern[position]; }
+
+		static bool IsQuantifier(const char ch) {
+			return ch == '*' || ch == '+' || ch == '?' || ch == '{';
+		}
+
+		NodePtr parseAlternation(const int depth) {
+			if (depth > MaxDepth) {
+				return nullptr;
+			}
+
+			auto first = parseConcat(depth);
+			if (!first || atEnd() || peek() != '|') {
+				return first;
+			}
+
+			auto node = std::make_unique<Node>(Node::Type::Alternate);
+			node->children.push_back(std::move(first));
+
+			while (!atEnd() && peek() == '|') {
+				++position;
+
+				auto next = parseConcat(depth);
+				if (!next) {
+					return nullptr;
+				}
+
+				node->children.push_back(std::move(next));
+			}
+
+			return node;
+		}
+
+		NodePtr parseConcat(const int depth) {
+			auto node = std::make_unique<Node>(Node::Type::Concat);
+			while (!atEnd() && peek() != '|' && peek() != ')') {
+				auto atom = parseAtom(depth);
+				if (!atom) {
+					return nullptr;
+				}
+
+				atom = parseQuantifier(std::move(atom));
+				if (!atom) {
+					return nullptr;
+				}
+
+				node->children.push_back(std::move(atom));
+			}
+
+			return node;
+		}
+
+		NodePtr parseAtom(const int depth) {
+			const auto ch = pattern[position++];
+			switch (ch) {
+				case '(': {
+					if (!atEnd() && peek() == '?') {
+						if (position + 1 >= pattern.size() || pattern[position + 1] != ':') {
+							return nullptr;
+						}
+
+						position += 2;
+					}
+
+					auto inner = parseAlternation(depth + 1);
+					if (!inner || atEnd() || peek() != ')') {
+						return nullptr;
+					}
+
+					++position;
+					return inner;
+				}
+				case '[':
+					return parseClass();
+				case '.': {
+					auto node = std::make_unique<Node>(Node::Type::Set);
+					SetAdd(node->set, '\n');
+					SetAdd(node->set, '\r');
+					SetInvert(node->set);
+					return node;
+				}
+				case '^':
+					return std::make_unique<Node>(Node::Type::Begin);
+				case '$':
+					return std::make_unique<Node>(Node::Type::End);
+				case '\\': {
+					auto node = std::make_unique<Node>(Node::Type::Set);
+					const auto result = parseEscape(node->set);
+					if (result == -2) {
+						return nullptr;
+					} else if (result >= 0) {
+						SetAdd(node->set, static_cast<std::uint8_t>(result));
+					}
+
+					return node;
+				}
+				case '*': case '+': case '?': case '{': case ']': case '}':
+					return nullptr;
+				default: {
+					auto node = std::make_unique<Node>(Node::Type::Set);
+					SetAdd(node->set, static_cast<std::uint8_t>(ch));
+					return node;
+				}
+			}
+		}
+
+		NodePtr parseQuantifier(NodePtr atom) {
+			if (atEnd() || !IsQuantifier(peek())) {
+				return atom;
+			}
+
+			if (atom->type == Node::Type::Begin || atom->type == Node::Type::End) {
+				return nullptr;
+			}
+
+			int min = 0;
+			int max = 0;
+			switch (pattern[position++]) {
+				case '*': min = 0; max = -1; break;
+				case '+': min = 1; max = -1; break;
+				case '?': min = 0; max = 1;  break;
+				case '{':
+					if (!parseBraces(min, max)) {
+						return nullptr;
+					}
+					break;
+			}
+
+			// NOTE: Laziness does not change whether a name matches, so lazy quantifiers are treated as greedy ones.
+			if (!atEnd() && peek() == '?') {
+				++position;
+			}
+
+			if (!atEnd() && IsQuantifier(peek())) {
+				return nullptr;
+			}
+
+			auto node = std::make_unique<Node>(Node::Type::Repeat);
+			node->min = min;
+			node->max = max;
+			node->children.push_back(std::move(atom));
+			return node;
+		}
+
+		bool parseBraces(int &min, int &max) {
+			if (!parseNumber(min)) {
+				return false;
+			}
+
+			if (atEnd()) {
+				return false;
+			}
+
+			if (peek() == '}') {
+				++position;
+				max = min;
+				return true;
+			}
+
+			if (peek() != ',') {
+				return false;
+			}
+
+			++position;
+			if (!atEnd() && peek() == '}') {
+				++position;
+				max = -1;
+				return true;
+			}
+
+			if (!parseNumber(max) || atEnd() || peek() != '}' || max < min) {
+				return false;
+			}
+
+			++position;
+			return true;
+		}
+
+		bool parseNumber(int &out) {
+			out = 0;
+
+			const auto begin = position;
+			while (!atEnd() && peek() >= '0' && peek() <= '9') {
+				out = out * 10 + (peek() - '0');
+				if (out > MaxRepeat) {
+					return false;
+				}
+
+				++position;
+			}
+
+			return position != begin;
+		}
+
+		// Returns the escaped character, -1 if a character class was added to the set instead, or -2 if the escape is not supported.
+		int parseEscape(CharSet &set) {
+			if (atEnd()) {
+				return -2;
+			}
+
+			const auto ch = pattern[position++];
+			switch (ch) {
+				case 'd': SetAddRange(set, '0', '9'); return -1;
+				case 'D': {
+					CharSet digits{};
+					SetAddRange(digits, '0', '9');
+					SetInvert(digits);
+					for (std::size_t i = 0; i < set.size(); ++i) {
+						set[i] |= digits[i];
+					}
+					return -1;
+				}
+				case 'w': case 'W': {
+					CharSet word{};
+					SetAddRange(word, 'a', 'z');
+					SetAddRange(word, 'A', 'Z');
+					SetAddRange(word, '0', '9');
+					SetAdd(word, '_');
+					if (ch == 'W') {
+						SetInvert(word);
+					}
+
+					for (std::size_t i = 0; i < set.size(); ++i) {
+						set[i] |= word[i];
+					}
+					return -1;
+				}
+				case 's': case 'S': {
+					CharSet space{};
+					for (const auto c: {' ', '\t', '\n', '\v', '\f', '\r'}) {
+						SetAdd(space, static_cast<std::uint8_t>(c));
+					}
+
+					if (ch == 'S') {
+						SetInvert(space);
+					}
+
+					for (std::size_t i = 0; i < set.size(); ++i) {
+						set[i] |= space[i];
+					}
+					return -1;
+				}
+				case 't': return '\t';
+				case 'n': return '\n';
+				case 'r': return '\r';
+				case 'f': return '\f';
+				case 'v': return '\v';
+				case '0':
+					return (!atEnd() && peek() >= '0' && peek() <= '9') ? -2 : 0;
+				case 'x': {
+					if (position + 2 > pattern.size()) {
+						return -2;
+					}
+
+					int value = 0;
+					for (int i = 0; i < 2; ++i) {
+						const auto digit = pattern[position++];
+						value <<= 4;
+						if (digit >= '0' && digit <= '9') {
+							value |= digit - '0';
+						} else if (digit >= 'a' && digit <= 'f') {
+							value |= digit - 'a' + 10;
+						} else if (digit >= 'A' && digit <= 'F') {
+							value |= digit - 'A' + 10;
+						} else {
+							return -2;
+						}
+					}
+					return value;
+				}
+			}
+
+			// NOTE: Back references, word boundaries, unicode and control escapes are left to std::regex.
+			const auto byte = static_cast<unsigned char>(ch);
+			if ((byte >= '0' && byte <= '9') || (byte >= 'a' && byte <= 'z') || (byte >= 'A' && byte <= 'Z')) {
+				return -2;
+			}
+
+			return byte;
+		}
+
+		NodePtr parseClass() {
+			auto node = std::make_unique<Node>(Node::Type::Set);
+
+			bool negate = false;
+			if (!atEnd() && peek() == '^') {
+				negate = true;
+				++position;
+			}
+
+			// NOTE: ECMAScript treats "[]" and "[^]" specially, leave them to std::regex.
+			if (atEnd() || peek() == ']') {
+				return nullptr;
+			}
+
+			while (!atEnd() && peek() != ']') {
+				int first = readClassAtom(node->set);
+				if (first == -2) {
+					return nullptr;
+				}
+
+				if (first == -1 || atEnd() || peek() != '-' || position + 1 >= pattern.size() || pattern[position + 1] == ']') {
+					if (first >= 0) {
+						SetAdd(node->set, static_cast<std::uint8_t>(first));
+					}
+					continue;
+				}
+
+				++position;
+				const int last = readClassAtom(node->set);
+				if (last < 0 || last < first) {
+					return nullptr;
+				}
+
+				SetAddRange(node->set, static_cast<std::uint8_t>(first), static_cast<std::uint8_t>(last));
+			}
+
+			if (atEnd()) {
+				return nullptr;
+			}
+
+			++position;
+			if (negate) {
+				SetInvert(node->set);
+			}
+
+			return node;
+		}
+
+		int readClassAtom(CharSet &set) {
+			const auto ch = pattern[position++];
+			if (ch == '\\') {
+				// NOTE: Inside a class "\b" means backspace, that is rare enough in file names to not be worth supporting.
+				return parseEscape(set);
+			}
+
+			if (ch == '[' && !atEnd() && (peek() == ':' || peek() == '.' || peek() == '=')) {
+				return -2;
+			}
+
+			return static_cast<unsigned char>(ch);
+		}
+};
+
+struct LiteralInfo
+{
+	bool exact = false;
+	std::string value{};
+	std::string required{};
+};
+
+void Longest(std::string &best, const std::string &candidate)
+{
+	if (candidate.size() > best.size()) {
+		best = candidate;
+	}
+}
+
+// Works out the longest literal every match of the node contains, and the string it matches if there is exactly one.
+LiteralInfo AnalyzeLiterals(const Node &node)
+{
+	LiteralInfo info{};
+	switch (node.type) {
+		case Node::Type::Empty:
+		case Node::Type::Begin:
+		case Node::Type::End:
+			info.exact = true;
+			break;
+		case Node::Type::Set: {
+			const auto single = SetSingle(node.set);
+			if (single != -1) {
+				info.exact = true;
+				info.value = std::string(1, static_cast<char>(single));
+				info.required = info.value;
+			}
+		} break;
+		case Node::Type::Concat: {
+			std::string run{};
+			info.exact = true;
+
+			for (const auto &child: node.children) {
+				auto childInfo = AnalyzeLiterals(*child);
+				if (childInfo.exact && run.size() + childInfo.value.size() <= MaxLiteralSize) {
+					run += childInfo.value;
+					continue;
+				}
+
+				Longest(info.required, run);
+				Longest(info.required, childInfo.required);
+				run = childInfo.exact ? childInfo.value : std::string{};
+				info.exact = false;
+			}
+
+			Longest(info.required, run);
+			if (info.exact) {
+				info.value = run;
+			}
+		} break;
+		case Node::Type::Alternate: {
+			auto first = AnalyzeLiterals(*node.children.front());
+			bool same = true;
+			for (auto it = node.children.begin() + 1; it != node.children.end() && same; ++it) {
+				const auto other = AnalyzeLiterals(**it);
+				same = other.exact == first.exact && other.value == first.value && other.required == first.required;
+			}
+
+			if (same) {
+				info = std::move(first);
+			}
+		} break;
+		case Node::Type::Repeat: {
+			if (node.min == 0) {
+				info.exact = node.max == 0;
+				break;
+			}
+
+			auto child = AnalyzeLiterals(*node.children.front());
+			info.required = child.required;
+
+			if (child.exact && node.min == node.max && child.value.size() * node.min <= MaxLiteralSize) {
+				info.exact = true;
+				for (int i = 0; i < node.min; ++i) {
+					info.value += child.value;
+				}
+
+				info.required = info.value;
+			}
+		} break;
+	}
+
+	return info;
+}
+
+} // namespace <anonymous>
+
+/*
+	Builds the Thompson NFA from the syntax tree. States are emitted back to front, every node is compiled with
+	the index of the state that follows it and returns the index of its own entry state.
+*/
+class RegexCompiler
+{
+	public:
+		explicit RegexCompiler(Regex &regex): regex{regex} {}
+
+		bool compile(const Node &root) {
+			regex.states.clear();
+			regex.sets.clear();
+
+			const auto match = add({Regex::Kind::Match});
+			regex.start = compile(root, match);
+			return !failed;
+		}
+
+	private:
+		Regex &regex;
+		bool failed = false;
+
+		int add(const Regex::State &state) {
+			if (regex.states.size() >= MaxStates) {
+				failed = true;
+				return 0;
+			}
+
+			regex.states.push_back(state);
+			return static_cast<int>(regex.states.size() - 1);
+		}
+
+		int compile(const Node &node, int next) {
+			if (failed) {
+				return 0;
+			}
+
+			switch (node.type) {
+				case Node::Type::Empty:
+					return next;
+				case Node::Type::Set:
+					regex.sets.push_back(node.set);
+					return add({Regex::Kind::Set, next, -1, static_cast<int>(regex.sets.size() - 1)});
+				case Node::Type::Begin:
+					return add({Regex::Kind::Begin, next});
+				case Node::Type::End:
+					return add({Regex::Kind::End, next});
+				case Node::Type::Concat:
+					for (auto it = node.children.rbegin(); it != node.children.rend(); ++it) {
+						next = compile(**it, next);
+					}
+					return next;
+				case Node::Type::Alternate: {
+					std::vector<int> starts{};
+					for (const auto &child: node.children) {
+						starts.push_back(compile(*child, next));
+					}
+
+					auto result = starts.back();
+					for (auto it = starts.rbegin() + 1; it != starts.rend(); ++it) {
+						result = add({Regex::Kind::Split, *it, result});
+					}
+					return result;
+				}
+				case Node::Type::Repeat: {
+					const auto &child = *node.children.front();
+
+					auto current = next;
+					if (node.max == -1) {
+						const auto split = add({Regex::Kind::Split, -1, next});
+						const auto body = compile(child, split);
+						if (!failed) {
+							regex.states[split].out = body;
+						}
+
+						current = split;
+					} else {
+						for (int i = node.min; i < node.max; ++i) {
+							current = add({Regex::Kind::Split, compile(child, current), current});
+						}
+					}
+
+					for (int i = 0; i < node.min; ++i) {
+						current = compile(child, current);
+					}
+					return current;
+				}
+			}
+
+			return next;
+		}
+};
+
+bool Regex::compile(const std::string_view pattern)
+{
+	requiredLiteral.clear();
+
+	auto root = Parser{pattern}.parse();
+	if (!root) {
+		return false;
+	}
+
+	if (!RegexCompiler{*this}.compile(*root)) {
+		return false;
+	}
+
+	requiredLiteral = AnalyzeLiterals(*root).required;
+	return true;
+}
+
+Regex::Matcher::Matcher(const Regex &regex)
+: regex{regex}
+, marks(regex.states.size(), 0)
+{
+	++generation;
+	closure(regex.start, true, false, initialStates);
+	std::sort(initialStates.begin(), initialStates.end());
+
+	++generation;
+	closure(regex.start, false, false, restartStates);
+	std::sort(restartStates.begin(), restartStates.end());
+
+	reset();
+}
+
+bool Regex::Matcher::search(const std::string_view text)
+{
+	auto current = start;
+	if (dstates[current].match) {
+		return true;
+	}
+
+	for (const auto ch: text) {
+		if (dstates.size() >= MaxDStates) {
+			auto states = dstates[current].states;
+			reset();
+			current = addState(std::move(states));
+		}
+
+		current = step(current, static_cast<std::uint8_t>(ch));
+		if (dstates[current].match) {
+			return true;
+		}
+	}
+
+	return matchesAtEnd(current, text.empty());
+}
+
+void Regex::Matcher::reset()
+{
+	dstates.clear();
+	lookup.clear();
+	start = addState(std::vector<int>{initialStates});
+}
+
+int Regex::Matcher::addState(std::vector<int> &&states)
+{
+	if (auto it = lookup.find(states); it != lookup.end()) {
+		return it->second;
+	}
+
+	DState dstate{};
+	dstate.states = std::move(states);
+	dstate.next.fill(-1);
+	dstate.match = std::any_of(dstate.states.begin(), dstate.states.end(), [this] (const int state) {
+		return regex.states[state].kind == Kind::Match;
+	});
+
+	const auto id = static_cast<int>(dstates.size());
+	lookup.emplace(dstate.states, id);
+	dstates.push_back(std::move(dstate));
+	return id;
+}
+
+int Regex::Matcher::step(const int state, const std::uint8_t byte)
+{
+	if (const auto next = dstates[state].next[byte]; next != -1) {
+		return next;
+	}
+
+	scratch.clear();
+	++generation;
+
+	for (const auto id: dstates[state].states) {
+		const auto &nfaState = regex.states[id];
+		if (nfaState.kind == Kind::Set && SetHas(regex.sets[nfaState.set], byte)) {
+			closure(nfaState.out, false, false, scratch);
+		}
+	}
+
+	// NOTE: The search is unanchored, a match may begin at any position so the start state is always live.
+	for (const auto id: restartStates) {
+		if (marks[id] != generation) {
+			marks[id] = generation;
+			scratch.push_back(id);
+		}
+	}
+
+	std::sort(scratch.begin(), scratch.end());
+
+	const auto next = addState(std::vector<int>{scratch});
+	dstates[state].next[byte] = next;
+	return next;
+}
+
+bool Regex::Matcher::matchesAtEnd(const int state, const bool atBegin)
+{
+	if (!atBegin && dstates[state].matchAtEnd != -1) {
+		return dstates[state].matchAtEnd == 1;
+	}
+
+	scratch.clear();
+	++generation;
+
+	for (const auto id: dstates[state].states) {
+		closure(id, atBegin, true, scratch);
+	}
+
+	const auto result = std::any_of(scratch.begin(), scratch.end(), [this] (const int id) {
+		return regex.states[id].kind == Kind::Match;
+	});
+
+	if (!atBegin) {
+		dstates[state].matchAtEnd = result ? 1 : 0;
+	}
+
+	return result;
+}
+
+void Regex::Matcher::closure(const int state, const bool atBegin, const bool atEnd, std::vector<int> &out)
+{
+	std::vector<int> stack{state};
+	while (!stack.empty()) {
+		const auto id = stack.back();
+		stack.pop_back();
+
+		if (id < 0 || marks[id] == generation) {
+			continue;
+		}
+
+		marks[id] = generation;
+
+		const auto &nfaState = regex.states[id];
+		switch (nfaState.kind) {
+			case Kind::Set:
+			case Kind::Match:
+				out.push_back(id);
+				break;
+			case Kind::Split:
+				stack.push_back(nfaState.out1);
+				stack.push_back(nfaState.out);
+				break;
+			case Kind::Begin:
+				if (atBegin) {
+					stack.push_back(nfaState.out);
+				}
+				break;
+			case Kind::End:
+				// NOTE: Keep blocked end assertions around so that matchesAtEnd() can resume from them.
+				if (atEnd) {
+					stack.push_back(nfaState.out);
+				} else {
+					out.push_back(id);
+				}
+				break;
+		}
+	}
+}
@@ -0,0 +1,111 @@
+/*
+	Copyright (c) 2019 Kamil Chojnowski Y29udGFjdEBkaWF0aC5uZXQ=
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in the
+	Software without restriction, including without limitation the rights to use,
+	copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+	THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef NOTHING_REGEX_HPP
+#define NOTHING_REGEX_HPP
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+	A linear-time regular expression engine for file name searches.
+
+	The pattern is compiled once into a Thompson NFA, which Matcher objects turn into a DFA lazily as they see
+	input, so every byte of a name is looked at exactly once. Only the common subset of the ECMAScript grammar is
+	supported (literals, classes, escapes, groups, alternation, greedy and lazy quantifiers, ^ and $), compile()
+	rejects everything else and the caller is expected to fall back to std::regex for those patterns.
+
+	The compiled regex also exposes the longest literal every match has to contain, which lets the caller narrow
+	down the rows through the substring indexes before running the automaton.
+*/
+class Regex
+{
+	public:
+		using CharSet = std::array<std::uint64_t, 4>;
+
+		class Matcher
+		{
+			public:
+				explicit Matcher(const Regex &regex);
+
+				bool search(const std::string_view text);
+
+			private:
+				struct DState
+				{
+					std::vector<int> states{};
+					std::array<int, 256> next{};
+					bool match = false;
+					int matchAtEnd = -1;
+				};
+
+				const Regex &regex;
+				std::vector<DState> dstates{};
+				std::map<std::vector<int>, int> lookup{};
+				std::vector<int> initialStates{};
+				std::vector<int> restartStates{};
+				std::vector<int> scratch{};
+				std::vector<std::uint32_t> marks{};
+				std::uint32_t generation = 0;
+
+				int start = -1;
+
+				void reset();
+				int addState(std::vector<int> &&states);
+				int step(const int state, const std::uint8_t byte);
+				bool matchesAtEnd(const int state, const bool atBegin);
+				void closure(const int state, const bool atBegin, const bool atEnd, std::vector<int> &out);
+		};
+
+		Regex() = default;
+
+		bool compile(const std::string_view pattern);
+
+		const std::string &literal() const { return requiredLiteral; }
+
+	private:
+		enum class Kind: std::uint8_t
+		{
+			Set,
+			Split,
+			Begin,
+			End,
+			Match,
+		};
+
+		struct State
+		{
+			Kind kind = Kind::Match;
+			int out = -1;
+			int out1 = -1;
+			int set = -1;
+		};
+
+		std::vector<State> states{};
+		std::vector<CharSet> sets{};
+		int start = -1;
+
+		std::string requiredLiteral{};
+
+		friend class RegexCompiler;
+};
+
+#endif // NOTHING_REGEX_HPP
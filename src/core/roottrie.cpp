@@ -0,0 +1,229 @@
+/*
+	Copyright (c) 2019 Kamil Chojnowski Y29udGFjdEBkaWF0aC5uZXQ=
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in the
+	Software without restriction, including without limitation the rights to use,
+	copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+	THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <filesystem>
+
+#include "roottrie.hpp"
+
+namespace {
+
+inline bool IsSeparator(const char ch)
+{
+	return ch == '/' || ch == static_cast<char>(std::filesystem::path::preferred_separator);
+}
+
+// NOTE: Splits the same way as the directory table does, an absolute POSIX path starts with an empty component.
+template <typename Callback>
+bool SplitPath(const std::string_view path, Callback &&callback)
+{
+	std::size_t start = 0;
+	bool first = true;
+
+	for (std::size_t i = 0; i <= path.size(); ++i) {
+		if (i != path.size() && !IsSeparator(path[i])) {
+			continue;
+		}
+
+		const auto component = path.substr(start, i - start);
+		if (!component.empty() || first) {
+			if (!callback(component)) {
+				return false;
+			}
+		}
+
+		first = false;
+		start = i + 1;
+	}
+
+	return true;
+}
+
+} // namespace <anonymous>
+
+bool RootTrie::insert(const std::string_view path, const Value value)
+{
+	if (path.empty()) {
+		return false;
+	}
+
+	Node *node = &top;
+	SplitPath(path, [&node] (const std::string_view component) {
+		auto &child = node->children[std::string{component}];
+		if (!child) {
+			child = std::make_unique<Node>();
+		}
+
+		node = child.get();
+		return true;
+	});
+
+	if (node->isRoot()) {
+		return false;
+	}
+
+	node->path = path;
+	node->value = value;
+	++count;
+	return true;
+}
+
+bool RootTrie::remove(const std::string_view path)
+{
+	// The nodes along the path along with the key of the next one, so that the branch can be pruned afterwards.
+	std::vector<std::pair<Node *, std::string>> chain{};
+
+	Node *node = &top;
+	const auto found = SplitPath(path, [&node, &chain] (const std::string_view component) {
+		auto it = node->children.find(std::string{component});
+		if (it == node->children.end()) {
+			return false;
+		}
+
+		chain.emplace_back(node, it->first);
+		node = it->second.get();
+		return true;
+	});
+
+	if (!found || !node->isRoot()) {
+		return false;
+	}
+
+	node->path.clear();
+	node->value = InvalidValue;
+	--count;
+
+	// NOTE: Only the nodes that have neither a root nor anything below them are dropped.
+	for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+		auto &[parent, key] = *it;
+		const auto &child = parent->children[key];
+		if (child->isRoot() || !child->children.empty()) {
+			break;
+		}
+
+		parent->children.erase(key);
+	}
+
+	return true;
+}
+
+void RootTrie::clear()
+{
+	top.children.clear();
+	count = 0;
+}
+
+RootTrie::Value RootTrie::find(const std::string_view path) const
+{
+	const auto node = findNode(path);
+	return node ? node->value : InvalidValue;
+}
+
+std::string RootTrie::owner(const std::string_view path) const
+{
+	const auto node = findOwner(path, true);
+	return node ? node->path : std::string{};
+}
+
+std::string RootTrie::parent(const std::string_view path) const
+{
+	const auto node = findOwner(path, false);
+	return node ? node->path : std::string{};
+}
+
+std::vector<std::string> RootTrie::descendants(const std::string_view path) const
+{
+	std::vector<std::string> result{};
+
+	const auto node = findNode(path);
+	if (node) {
+		for (const auto &[_, child]: node->children) {
+			collect(*child, result);
+		}
+	}
+
+	return result;
+}
+
+std::vector<std::string> RootTrie::paths() const
+{
+	std::vector<std::string> result{};
+	result.reserve(count);
+	collect(top, result);
+	return result;
+}
+
+const RootTrie::Node *RootTrie::findNode(const std::string_view path) const
+{
+	if (path.empty()) {
+		return nullptr;
+	}
+
+	const Node *node = &top;
+	const auto found = SplitPath(path, [&node] (const std::string_view component) {
+		auto it = node->children.find(std::string{component});
+		if (it == node->children.end()) {
+			return false;
+		}
+
+		node = it->second.get();
+		return true;
+	});
+
+	return found ? node : nullptr;
+}
+
+const RootTrie::Node *RootTrie::findOwner(const std::string_view path, const bool inclusive) const
+{
+	if (path.empty()) {
+		return nullptr;
+	}
+
+	const Node *node = &top;
+	const Node *owner = nullptr;
+
+	// NOTE: A root is only an owner once the walk has gone past it, the last node reached is the path itself.
+	const auto found = SplitPath(path, [&node, &owner] (const std::string_view component) {
+		if (node->isRoot()) {
+			owner = node;
+		}
+
+		auto it = node->children.find(std::string{component});
+		if (it == node->children.end()) {
+			return false;
+		}
+
+		node = it->second.get();
+		return true;
+	});
+
+	if (found && inclusive && node->isRoot()) {
+		return node;
+	}
+
+	return owner;
+}
+
+void RootTrie::collect(const Node &node, std::vector<std::string> &out) const
+{
+	if (node.isRoot()) {
+		out.push_back(node.path);
+	}
+
+	for (const auto &[_, child]: node.children) {
+		collect(*child, out);
+	}
+}
@@ -0,0 +1,92 @@
+/*
+	Copyright (c) 2019 Kamil Chojnowski Y29udGFjdEBkaWF0aC5uZXQ=
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in the
+	Software without restriction, including without limitation the rights to use,
+	copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+	THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef NOTHING_ROOTTRIE_HPP
+#define NOTHING_ROOTTRIE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/*
+	The set of root folders, kept as a tree of path components.
+
+	Looking up a path walks it one component at a time, so finding the root that owns a path, whether a new root
+	would be nested in another one and which roots a new parent would take over costs one step per component
+	rather than a comparison against every root. Repeated and trailing separators do not matter, "/a/b/" and
+	"/a//b" are the same root as "/a/b". Every root carries a value for the caller, a watch descriptor for instance.
+*/
+class RootTrie
+{
+	public:
+		using Value = std::uint32_t;
+
+		static constexpr Value InvalidValue = ~Value{0};
+
+		RootTrie() = default;
+
+		RootTrie(const RootTrie &) = delete;
+		RootTrie(RootTrie &&) = delete;
+
+		RootTrie &operator =(const RootTrie &) = delete;
+		RootTrie &operator =(RootTrie &&) = delete;
+
+		// Returns false if the path is already a root, its value is left as it was.
+		bool insert(const std::string_view path, const Value value = 0);
+		bool remove(const std::string_view path);
+		void clear();
+
+		bool contains(const std::string_view path) const { return find(path) != InvalidValue; }
+		// The value of the root at exactly the given path, or InvalidValue.
+		Value find(const std::string_view path) const;
+
+		// The root the path lies in, the path itself if it is one, or an empty string if there is none.
+		std::string owner(const std::string_view path) const;
+		// The closest root strictly above the path, the one it would be nested in, or an empty string.
+		std::string parent(const std::string_view path) const;
+		// The roots strictly below the path, the ones it would take over.
+		std::vector<std::string> descendants(const std::string_view path) const;
+
+		// Every root, as it was inserted.
+		std::vector<std::string> paths() const;
+		std::size_t size() const { return count; }
+		bool empty() const { return count == 0; }
+
+	private:
+		struct Node
+		{
+			std::unordered_map<std::string, std::unique_ptr<Node>> children{};
+			// The path as it was inserted, empty unless the node is a root.
+			std::string path{};
+			Value value = InvalidValue;
+
+			bool isRoot() const { return !path.empty(); }
+		};
+
+		Node top{};
+		std::size_t count = 0;
+
+		const Node *findNode(const std::string_view path) const;
+		// Walks down to the deepest node along the path, returns the closest root on the way or nullptr.
+		const Node *findOwner(const std::string_view path, const bool inclusive) const;
+		void collect(const Node &node, std::vector<std::string> &out) const;
+};
+
+#endif // NOTHING_ROOTTRIE_HPP
@@ -16,15 +16,66 @@
 */
 
 #include <algorithm>
-#include <filesystem>
-
 #include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "scanner.hpp"
 #include "database.hpp"
+#include "directoryreader.hpp"
 
 namespace fs = std::filesystem;
 
+namespace {
+
+constexpr auto BatchSize = 32 * 1024u;
+// NOTE: Also flushed every so often, so that the results of a large scan keep showing up while it runs.
+constexpr auto FlushInterval = std::chrono::milliseconds(250);
+
+inline bool IsSeparator(const char ch)
+{
+	return ch == '/' || ch == static_cast<char>(fs::path::preferred_separator);
+}
+
+// Whether the path is the given folder or lies below it.
+bool IsWithin(const std::string &path, const std::string &folder)
+{
+	if (folder.empty() || path.compare(0, folder.size(), folder) != 0) {
+		return false;
+	}
+
+	return path.size() == folder.size() || IsSeparator(folder.back()) || IsSeparator(path[folder.size()]);
+}
+
+inline std::int64_t Now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline std::uint64_t Since(const std::int64_t start)
+{
+	return static_cast<std::uint64_t>(Now() - start);
+}
+
+// NOTE: A thread that backs off waits this many times as long as the slow operation took, at most MaxBackoff.
+constexpr std::uint64_t BackoffFactor = 4;
+constexpr auto MaxBackoff = std::chrono::seconds(1);
+
+inline bool IsDenied(const std::error_code &error)
+{
+	return error == std::errc::permission_denied || error == std::errc::operation_not_permitted;
+}
+
+// NOTE: A folder removed or replaced while the scan runs is not an error.
+inline bool IsMissing(const std::error_code &error)
+{
+	return error == std::errc::no_such_file_or_directory || error == std::errc::not_a_directory;
+}
+
+} // namespace <anonymous>
+
 Scanner::Scanner(Database *database)
 : database{database}
 {
@@ -41,14 +92,55 @@ void Scanner::run()
 		return;
 	}
 
+	// NOTE: A snapshot may hold roots that are no longer added, their rows must not come back with it.
+	for (const auto &path: database->getRootPaths()) {
+		if (!roots.contains(path)) {
+			database->removeEntries(path);
+		}
+	}
+
 	for (auto &&path: paths) {
 		enqueue(path);
 	}
 
 	running = true;
+
+	ingestThread = std::thread([this] () {
+		applyPolicy();
+		ingester();
+	});
+
+	const auto count = std::max(1u, std::thread::hardware_concurrency());
+	for (std::size_t i = 0; i < count; ++i) {
+		workers.push_back(std::make_unique<Worker>());
+	}
+
+	for (std::size_t i = 0; i < count; ++i) {
+		threads.emplace_back([this, i] () {
+			applyPolicy();
+			poolWorker(i);
+		});
+	}
+
 	thread = std::thread([this] () {
+		// NOTE: Reported by one thread only, the others are refused for the same reason.
+		if (!applyPolicy()) {
+			std::fprintf(stderr, "Failed to lower the priority of the scanner threads.\n");
+		}
+
 		worker();
 	});
+
+	// NOTE: A snapshot may have been saved before all the metadata was read, the jobs started above may already be done.
+	{
+		std::lock_guard<std::mutex> lock{fillMutex};
+		fillRequested = true;
+	}
+
+	fillThread = std::thread([this] () {
+		applyPolicy();
+		filler();
+	});
 }
 
 void Scanner::stop()
@@ -59,19 +151,112 @@ void Scanner::stop()
 
 	running = false;
 
-	queue.clear();
+	{
+		std::lock_guard<std::mutex> lock{mutex};
+		queue.clear();
+	}
 	cv.notify_one();
 
+	{
+		std::lock_guard<std::mutex> lock{idleMutex};
+	}
+	idleCv.notify_all();
+
+	{
+		std::lock_guard<std::mutex> lock{ingestMutex};
+	}
+	ingestCv.notify_one();
+	spaceCv.notify_all();
+
+	{
+		std::lock_guard<std::mutex> lock{fillMutex};
+	}
+	fillCv.notify_one();
+
+	{
+		std::lock_guard<std::mutex> lock{pauseMutex};
+	}
+	pauseCv.notify_all();
+
 	if (thread.joinable()) {
 		thread.join();
 	}
 
+	if (fillThread.joinable()) {
+		fillThread.join();
+	}
+
 	for (auto &&thread: threads) {
 		if (thread.joinable()) {
 			thread.join();
 		}
 	}
 	threads.clear();
+
+	if (ingestThread.joinable()) {
+		ingestThread.join();
+	}
+
+	// NOTE: Like everything else of a stopped scan, the batches that were not ingested yet are dropped.
+	Batch batch{};
+	while (ingestQueue.tryPop(batch)) {
+	}
+
+	// NOTE: An interrupted scan of new folders would leave them half indexed for good, the whole root is scanned again next time instead.
+	for (const auto &job: jobs) {
+		if (job.reconciling) {
+			database->setRootComplete(job.root, false);
+		}
+	}
+
+	jobs.clear();
+	workers.clear();
+	nextWorker = 0;
+	queuedTasks = 0;
+}
+
+void Scanner::setPolicy(const Policy &policy)
+{
+	this->policy = policy;
+	directoryLimiter.setRate(policy.directoriesPerSecond);
+	statLimiter.setRate(policy.statsPerSecond);
+}
+
+bool Scanner::applyPolicy()
+{
+	return !policy.background || LowerThreadPriority();
+}
+
+void Scanner::throttle(RateLimiter &limiter, const std::uint32_t count)
+{
+	if (!limiter.isLimited()) {
+		return;
+	}
+
+	if (const auto wait = limiter.take(count); wait.count() > 0) {
+		pause(wait);
+		throttleNanoseconds.fetch_add(static_cast<std::uint64_t>(wait.count()), std::memory_order_relaxed);
+	}
+}
+
+void Scanner::backoff(const std::uint64_t latency)
+{
+	const auto threshold = static_cast<std::uint64_t>(std::chrono::nanoseconds{policy.backoffLatency}.count());
+	if (threshold == 0 || latency <= threshold) {
+		return;
+	}
+
+	const auto wait = std::min<std::chrono::nanoseconds>(std::chrono::nanoseconds{latency * BackoffFactor}, MaxBackoff);
+	pause(wait);
+	backoffNanoseconds.fetch_add(static_cast<std::uint64_t>(wait.count()), std::memory_order_relaxed);
+}
+
+void Scanner::pause(const std::chrono::nanoseconds duration)
+{
+	std::unique_lock<std::mutex> lock{pauseMutex};
+	pauseCv.wait_for(lock, duration, [this] {
+		return !running;
+	});
 }
 
 void Scanner::worker()
@@ -86,124 +271,1184 @@ void Scanner::worker()
 			break;
 		}
 
-		for (auto &&path: queue) {
-			threads.emplace_back([this, path] () {
-				workerTask(path);
-			});
+		// NOTE: Starting a root can take a while when it has to be reconciled, paths can still be queued meanwhile.
+		auto pending = std::move(queue);
+		queue.clear();
+		lock.unlock();
+
+		for (const auto &path: pending) {
+			if (!running) {
+				break;
+			}
+
+			scanRoot(path);
 		}
 
-		queue.clear();
+		lock.lock();
+	}
+}
+
+void Scanner::scanRoot(const std::string &path)
+{
+	std::vector<std::string> children{};
+	{
+		std::lock_guard<std::mutex> lock{mutex};
+		if (auto it = absorbed.find(path); it != absorbed.end()) {
+			children = std::move(it->second);
+			absorbed.erase(it);
+		}
+	}
+
+	/*
+		NOTE: A root restored complete from a snapshot only has to be reconciled, a partially indexed one is dropped
+		and scanned again. So is one that took over other roots, whatever it held before does not account for them.
+	*/
+	if (children.empty() && database->isRootComplete(path)) {
+		reconcile(path);
+		return;
+	}
+
+	// NOTE: A scan still running for the same root, if the root was removed and added back meanwhile, is cancelled.
+	purgeRoot(path, false);
+	const auto root = database->internRoot(path);
+	resetCounters(root, path);
+
+	auto job = createJob(path, root, false);
+	if (!children.empty()) {
+		mergeRoots(job, children);
 	}
+
+	std::vector<Task> tasks{};
+	tasks.push_back({path, internDirectory(path), nullptr, loadIgnoreRules(path, path)});
+	queueTasks(job, std::move(tasks));
+	releaseJob(job, 1);
 }
 
-void Scanner::workerTask(const std::string &path)
+Scanner::Counters &Scanner::getCounters(const Index::Id root)
 {
-	constexpr auto BatchSize = 32 * 1024u;
+	std::lock_guard<std::mutex> lock{countersMutex};
 
-	std::vector<Database::Entry> entries{};
-	entries.reserve(BatchSize);
+	auto &counters = this->counters[root];
+	if (!counters) {
+		counters = std::make_unique<Counters>();
+	}
 
-	std::size_t counter = 0;
-	for (auto &&entry: fs::recursive_directory_iterator{path, fs::directory_options::skip_permission_denied}) {
-		if (!running) {
-			break;
+	return *counters;
+}
+
+Scanner::Counters &Scanner::resetCounters(const Index::Id root, const std::string &path)
+{
+	auto &counters = getCounters(root);
+	{
+		std::lock_guard<std::mutex> lock{countersMutex};
+		counters.path = path;
+		counters.removed = false;
+	}
+
+	counters.directories = 0;
+	counters.files = 0;
+	counters.bytes = 0;
+	counters.errors = 0;
+	counters.denied = 0;
+	counters.finished = 0;
+	counters.started = Now();
+	return counters;
+}
+
+void Scanner::reconcile(const std::string &path)
+{
+	const auto root = database->internRoot(path);
+	auto &counters = resetCounters(root, path);
+	auto job = createJob(path, root, true);
+
+	std::vector<Database::Listing> listings{};
+	std::vector<Index::Id> removed{};
+	std::vector<Task> added{};
+
+	/*
+		Only the directories are checked, a file being created, removed or renamed always updates the stamp of its
+		folder. Unchanged folders are not even listed, the changed ones are listed in full and diffed by the database.
+	*/
+	const auto directories = database->getListedDirectories(root);
+
+	std::unordered_set<std::string> known{};
+	for (const auto &directory: directories) {
+		known.insert(directory.path);
+	}
+
+	// NOTE: The parents come first, whatever lies below a dropped folder goes with it and is not looked at.
+	std::unordered_set<Index::Id> dropped{};
+	// The ignore rules in effect inside every folder checked so far, only kept while .gitignore files are honoured.
+	std::unordered_map<Index::Id, std::shared_ptr<const IgnoreRules>> rules{};
+	const auto gitIgnore = exclusions && exclusions->isGitIgnoreEnabled();
+
+	DirectoryReader reader{};
+	std::string scratch{};
+
+	for (const auto &directory: directories) {
+		// NOTE: Nothing has been changed yet, an interrupted reconciliation leaves the root as it was.
+		if (!running || job->cancelled) {
+			releaseJob(job, 1);
+			return;
+		}
+
+		if (dropped.find(directory.parent) != dropped.end()) {
+			dropped.insert(directory.id);
+			continue;
+		}
+
+		std::shared_ptr<const IgnoreRules> ignore{};
+
+		// NOTE: Folders indexed before a rule or a .gitignore excluding them was added are dropped like removed ones.
+		if (exclusions && directory.path != path) {
+			const auto parentPath = fs::path{directory.path}.parent_path().string();
+			const auto name = fs::path{directory.path}.filename().string();
+
+			if (gitIgnore) {
+				const auto it = rules.find(directory.parent);
+				ignore = it != rules.end() ? it->second : loadIgnoreRules(path, parentPath);
+			}
+
+			if (isExcluded(parentPath, name, true, ignore.get(), scratch)) {
+				removed.push_back(directory.id);
+				dropped.insert(directory.id);
+				continue;
+			}
+		}
+
+		const auto stamp = DirectoryStamp(directory.path);
+		if (stamp == 0) {
+			removed.push_back(directory.id);
+			dropped.insert(directory.id);
+			continue;
+		}
+
+		if (gitIgnore) {
+			ignore = directory.path != path ? IgnoreRules::load(directory.path, std::move(ignore)) : loadIgnoreRules(path, path);
+			rules.emplace(directory.id, ignore);
+		}
+
+		if (stamp == directory.stamp) {
+			continue;
 		}
 
-		// TODO: This should be interrupted when a path has been removed.
+		throttle(directoryLimiter, 1);
+
+		// NOTE: A folder that cannot be listed keeps its old contents and stamp, it is retried on the next run.
+		const auto opening = Now();
+		const auto opened = reader.open(directory.path);
+		backoff(Since(opening));
+
+		if (!opened) {
+			if (IsDenied(reader.openError())) {
+				++counters.denied;
+			} else {
+				++counters.errors;
+			}
 
-		if (entry.is_directory()) {
 			continue;
 		}
 
-		std::error_code ec{};
+		Database::Listing listing{directory.id, stamp, {}};
+
+		DirectoryReader::Entry entry{};
+		while (reader.next(entry)) {
+			if (exclusions && isExcluded(directory.path, entry.name, entry.directory, ignore.get(), scratch)) {
+				continue;
+			}
+
+			if (entry.directory) {
+				scratch.assign(directory.path);
+				if (scratch.empty() || scratch.back() != '/') {
+					scratch += '/';
+				}
+				scratch += entry.name;
 
-		auto &filePath = entry.path();
-		entries.emplace_back(
-			filePath.filename().string(),
-			filePath.parent_path().string(),
-			path,
-			entry.file_size(ec),
-			entry.status().permissions()
-		);
+				if (!entry.symlink && known.find(scratch) == known.end()) {
+					added.push_back({scratch, internDirectory(scratch), nullptr, ignore, reader.device()});
+				}
+
+				continue;
+			}
+
+			listing.files.push_back({std::string{entry.name}, directory.id, root, entry.size, entry.perms, FileType::Generic, entry.mtime, entry.metadata});
+		}
 
-		if (++counter == BatchSize) {
-			database->addEntries(entries);
-			entries.clear();
-			counter = 0;
+		if (reader.failed()) {
+			++counters.errors;
+			continue;
 		}
+
+		++counters.directories;
+		counters.files += listing.files.size();
+		throttle(statLimiter, static_cast<std::uint32_t>(listing.files.size()));
+		listings.push_back(std::move(listing));
 	}
 
-	if (running && !entries.empty()) {
-		database->addEntries(entries);
+	const auto start = Now();
+	{
+		std::lock_guard<std::mutex> lock{purgeMutex};
+		if (!job->cancelled) {
+			database->reconcile(listings, removed);
+		}
 	}
+	insertNanoseconds += Since(start);
+
+	queueTasks(job, std::move(added));
+	releaseJob(job, 1);
 }
 
-Scanner::AddPathResult Scanner::addPath(const std::string &path)
+Scanner::Job *Scanner::createJob(const std::string &path, const Index::Id root, const bool reconciling)
 {
-	if (!fs::exists(path)) {
-		return AddPathResult::PathDoesNotExist;
+	auto &counters = getCounters(root);
+
+	std::lock_guard<std::mutex> lock{jobsMutex};
+	auto &job = jobs.emplace_back();
+	job.path = path;
+	job.root = root;
+	job.counters = &counters;
+	job.reconciling = reconciling;
+	job.cancelled = removedRoots.find(path) != removedRoots.end();
+	job.pending = 1;
+	return &job;
+}
+
+void Scanner::queueTasks(Job *job, std::vector<Task> &&tasks)
+{
+	job->pending += tasks.size();
+
+	for (auto &&task: tasks) {
+		task.job = job;
+		push(nextWorker++ % workers.size(), std::move(task));
 	}
+}
 
-	if (!fs::is_directory(path)) {
-		return AddPathResult::PathNotDirectory;
+void Scanner::releaseJob(Job *job, const std::size_t directories)
+{
+	if (job->pending.fetch_sub(directories) == directories) {
+		finishJob(job);
 	}
+}
 
-	if (std::find(paths.begin(), paths.end(), path) != paths.end()) {
-		return AddPathResult::PathAlreadyAdded;
+void Scanner::finishJob(Job *job)
+{
+	if (!job->reconciling && !job->cancelled) {
+		database->setRootComplete(job->root, true);
+	}
+
+	job->counters->finished = Now();
+
+	{
+		std::lock_guard<std::mutex> lock{jobsMutex};
+		jobs.remove_if([job] (const Job &entry) {
+			return &entry == job;
+		});
 	}
 
-	fs::path added = path;
-	for (const auto &path: paths) {
-		fs::path base = path;
-		while (added.has_parent_path() && added != added.root_path()) {
-			const auto parent = added.parent_path();
-			if (base == added) {
-				return AddPathResult::ParentPathAlreadyAdded;
+	requestFill();
+}
+
+void Scanner::poolWorker(const std::size_t index)
+{
+	auto &worker = *workers[index];
+	worker.batch.entries.reserve(BatchSize);
+	worker.flushed = std::chrono::steady_clock::now();
+
+	Task task{};
+	while (running) {
+		if (pop(index, task)) {
+			scanDirectory(index, task);
+
+			const auto &batch = worker.batch;
+			if (batch.entries.size() >= BatchSize || batch.stamps.size() >= BatchSize || std::chrono::steady_clock::now() - worker.flushed >= FlushInterval) {
+				flush(worker);
 			}
 
-			added = parent;
+			continue;
 		}
+
+		// NOTE: Nothing left to steal either, whatever the thread has batched up is handed over before it goes to sleep.
+		flush(worker);
+
+		std::unique_lock<std::mutex> lock{idleMutex};
+		++idleWorkers;
+		idleCv.wait(lock, [this] {
+			return queuedTasks > 0 || !running;
+		});
+		--idleWorkers;
 	}
+}
 
-	paths.push_back(path);
+void Scanner::push(const std::size_t index, Task &&task)
+{
+	{
+		std::lock_guard<std::mutex> lock{workers[index]->mutex};
+		workers[index]->tasks.push_back(std::move(task));
+	}
 
-	if (running) {
-		enqueue(path);
+	// NOTE: Both counters are sequentially consistent, either the sleeping thread sees the task or this one sees the thread.
+	++queuedTasks;
+	if (idleWorkers > 0) {
+		std::lock_guard<std::mutex> lock{idleMutex};
+		idleCv.notify_one();
+	}
+}
+
+bool Scanner::pop(const std::size_t index, Task &task)
+{
+	{
+		auto &worker = *workers[index];
+		std::lock_guard<std::mutex> lock{worker.mutex};
+		if (!worker.tasks.empty()) {
+			task = std::move(worker.tasks.back());
+			worker.tasks.pop_back();
+			--queuedTasks;
+			return true;
+		}
 	}
 
-	return AddPathResult::Ok;
+	for (std::size_t offset = 1; offset < workers.size(); ++offset) {
+		auto &victim = *workers[(index + offset) % workers.size()];
+		std::lock_guard<std::mutex> lock{victim.mutex};
+		if (!victim.tasks.empty()) {
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			--queuedTasks;
+			return true;
+		}
+	}
+
+	return false;
 }
 
-void Scanner::enqueue(const std::string &path)
+void Scanner::scanDirectory(const std::size_t index, const Task &task)
 {
-	std::lock_guard<std::mutex> lock{mutex};
+	auto &worker = *workers[index];
+	auto &reader = worker.reader;
+	auto &counters = *task.job->counters;
+	const auto root = task.job->root;
 
-	if (std::find(queue.begin(), queue.end(), path) != queue.end()) {
+	// NOTE: The tasks of a cancelled job are not taken out of the deques, they are skipped as they come up.
+	if (task.job->cancelled) {
+		endTask(worker, task.job);
 		return;
 	}
 
-	queue.push_back(path);
-	cv.notify_one();
+	throttle(directoryLimiter, 1);
+	const auto start = Now();
+
+	/*
+		NOTE: A directory is stamped before it is listed, so that anything changing while it is being listed is
+		caught by the next reconciliation. One that cannot be listed is still stamped, it stays empty until it changes.
+		One that is skipped by visit() is not, a reconciliation finds it again once its parent changes.
+	*/
+	const auto opened = reader.open(task.path, false);
+	const auto latency = Since(start);
+	const auto listed = opened && visit(worker, task);
+	if (listed || !opened) {
+		worker.batch.stamps.emplace_back(task.directory, opened ? reader.stamp() : DirectoryStamp(task.path));
+	}
+
+	if (!opened && IsDenied(reader.openError())) {
+		counters.denied.fetch_add(1, std::memory_order_relaxed);
+	} else if (!opened && !IsMissing(reader.openError())) {
+		counters.errors.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// NOTE: The subdirectories inherit the patterns, a .gitignore of their own is read once they are listed.
+	auto ignore = task.ignore;
+	if (listed && exclusions && exclusions->isGitIgnoreEnabled()) {
+		ignore = IgnoreRules::load(task.path, std::move(ignore));
+	}
+
+	const auto directoryPath = exclusions ? task.path.generic_string() : std::string{};
+	auto &path = worker.path;
+	auto &subdirectories = worker.subdirectories;
+	subdirectories.clear();
+	std::uint64_t files = 0;
+	std::uint64_t bytes = 0;
+
+	DirectoryReader::Entry entry{};
+	while (listed && reader.next(entry)) {
+		if (!running) {
+			return;
+		}
+
+		if (task.job->cancelled) {
+			break;
+		}
+
+		if (exclusions && isExcluded(directoryPath, entry.name, entry.directory, ignore.get(), path)) {
+			continue;
+		}
+
+		// NOTE: Symlinked folders are not descended into, so there is nothing to reconcile in them either.
+		if (entry.directory) {
+			if (!entry.symlink) {
+				subdirectories.emplace_back(entry.name);
+			}
+
+			continue;
+		}
+
+		worker.batch.entries.push_back({std::string{entry.name}, task.directory, root, entry.size, entry.perms, FileType::Generic, entry.mtime, entry.metadata});
+		++files;
+		bytes += entry.size;
+	}
+
+	// NOTE: The subdirectories are interned all at once, the table is shared by every pool thread.
+	if (!subdirectories.empty() && !task.job->cancelled) {
+		auto &ids = worker.subdirectoryIds;
+		ids.clear();
+		{
+			std::lock_guard<std::mutex> lock{directoriesMutex};
+			for (const auto &name: subdirectories) {
+				ids.push_back(directories.intern(task.directory, name));
+			}
+		}
+
+		for (std::size_t i = 0; i < ids.size(); ++i) {
+			if (task.job->merged.empty() || task.job->merged.find(ids[i]) == task.job->merged.end()) {
+				++task.job->pending;
+				push(index, {task.path / subdirectories[i], ids[i], task.job, ignore, reader.device()});
+			}
+		}
+	}
+
+	// NOTE: The counters are shared by every thread scanning the root, they are only touched once per folder.
+	if (listed) {
+		counters.directories.fetch_add(1, std::memory_order_relaxed);
+		counters.files.fetch_add(files, std::memory_order_relaxed);
+		counters.bytes.fetch_add(bytes, std::memory_order_relaxed);
+
+		if (reader.failed()) {
+			counters.errors.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	reader.close();
+	listNanoseconds.fetch_add(Since(start), std::memory_order_relaxed);
+
+	// NOTE: Opening the folder is the one call that always goes to the storage when it is not cached.
+	backoff(latency);
+
+	endTask(worker, task.job);
+}
+
+void Scanner::endTask(Worker &worker, Job *job)
+{
+	auto &batch = worker.batch;
+	if (batch.spans.empty() || batch.spans.back().job != job) {
+		batch.spans.push_back({job, 0, 0, 0, 0});
+	}
+
+	auto &span = batch.spans.back();
+	++span.directories;
+	span.entries = batch.entries.size();
+	span.stamps = batch.stamps.size();
+	span.aliases = batch.aliases.size();
 }
 
-bool Scanner::removePath(const std::string &path)
+bool Scanner::visit(Worker &worker, const Task &task)
 {
-	if (auto it = std::find(paths.begin(), paths.end(), path); it != paths.end()) {
-		paths.erase(it);
-	} else {
+	const auto &reader = worker.reader;
+
+	// NOTE: The root of a job sets the filesystem for everything below it, so it is never skipped itself.
+	if (oneFilesystem && task.device != 0 && reader.device() != task.device) {
 		return false;
 	}
 
-	std::lock_guard<std::mutex> lock{mutex};
-	if (auto it = std::find(queue.begin(), queue.end(), path); it != queue.end()) {
-		queue.erase(it);
+	if (reader.inode() == 0) {
+		return true;
 	}
 
-	database->removeEntries(path);
-	return true;
+	const auto first = visited.insert(reader.device(), reader.inode(), task.directory);
+	if (first == task.directory) {
+		return true;
+	}
+
+	/*
+		NOTE: The folder first seen under the inode may have been removed since and the inode reused by this one,
+		it is only an alias if the other path still leads to the same device and inode.
+	*/
+	std::uint64_t device = 0;
+	std::uint64_t inode = 0;
+	if (!DirectoryIdentity(directoryPath(first), device, inode) || device != reader.device() || inode != reader.inode()) {
+		visited.assign(reader.device(), reader.inode(), task.directory);
+		return true;
+	}
+
+	worker.batch.aliases.emplace_back(task.directory, first);
+	return false;
+}
+
+bool Scanner::isExcluded(const std::string &directory, const std::string_view name, const bool isDirectory, const IgnoreRules *ignore, std::string &path) const
+{
+	if (!isDirectory && !ignore && !exclusions->hasFileRules()) {
+		return false;
+	}
+
+	if (isDirectory || ignore) {
+		path.assign(directory);
+		if (path.empty() || path.back() != '/') {
+			path += '/';
+		}
+		path += name;
+	}
+
+	if (isDirectory ? exclusions->excludesDirectory(path, name) : exclusions->excludesFile(directory, name)) {
+		return true;
+	}
+
+	return ignore && ignore->isIgnored(path, name, isDirectory);
+}
+
+std::shared_ptr<const IgnoreRules> Scanner::loadIgnoreRules(const std::string &root, const std::string &directory) const
+{
+	if (!exclusions || !exclusions->isGitIgnoreEnabled()) {
+		return {};
+	}
+
+	fs::path current{root};
+	auto rules = IgnoreRules::load(current, nullptr);
+
+	const auto relative = fs::path{directory}.lexically_relative(root);
+	for (const auto &component: relative) {
+		if (component.empty() || component == ".") {
+			continue;
+		}
+
+		current /= component;
+		rules = IgnoreRules::load(current, std::move(rules));
+	}
+
+	return rules;
+}
+
+void Scanner::flush(Worker &worker)
+{
+	worker.flushed = std::chrono::steady_clock::now();
+
+	// NOTE: A stopped scan is dropped as a whole, its roots are not marked complete and get scanned again.
+	if (!running) {
+		return;
+	}
+
+	auto &batch = worker.batch;
+	if (batch.entries.empty() && batch.stamps.empty() && batch.aliases.empty() && batch.spans.empty()) {
+		return;
+	}
+
+	if (!ingestQueue.tryPush(batch)) {
+		const auto start = std::chrono::steady_clock::now();
+		{
+			std::unique_lock<std::mutex> lock{ingestMutex};
+			++waitingProducers;
+			spaceCv.wait(lock, [this, &batch] {
+				return ingestQueue.tryPush(batch) || !running;
+			});
+			--waitingProducers;
+		}
+
+		++stalls;
+		stallNanoseconds += static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+
+		if (!running) {
+			return;
+		}
+	}
+
+	const auto depth = ingestQueue.size();
+	for (auto max = maxQueueDepth.load(); depth > max && !maxQueueDepth.compare_exchange_weak(max, depth);) {
+	}
+
+	// NOTE: The fence orders the push before the check, the ingest thread fences between announcing that it waits and looking at the queue.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (ingestWaiting) {
+		std::lock_guard<std::mutex> lock{ingestMutex};
+		ingestCv.notify_one();
+	}
+
+	batch = {};
+	batch.entries.reserve(BatchSize);
+}
+
+void Scanner::ingester()
+{
+	Batch batch{};
+	while (running) {
+		if (!ingestQueue.tryPop(batch)) {
+			std::unique_lock<std::mutex> lock{ingestMutex};
+			ingestWaiting = true;
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+
+			bool popped = false;
+			ingestCv.wait(lock, [this, &batch, &popped] {
+				popped = ingestQueue.tryPop(batch);
+				return popped || !running;
+			});
+
+			ingestWaiting = false;
+			if (!popped) {
+				break;
+			}
+		}
+
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (waitingProducers > 0) {
+			std::lock_guard<std::mutex> lock{ingestMutex};
+			spaceCv.notify_all();
+		}
+
+		ingest(batch);
+	}
+}
+
+void Scanner::ingest(Batch &batch)
+{
+	const auto start = Now();
+	{
+		// NOTE: A root is purged either before the batch is checked or after it has been written, never in between.
+		std::lock_guard<std::mutex> lock{purgeMutex};
+		dropCancelled(batch);
+		resolveDirectories(batch);
+
+		if (!batch.entries.empty()) {
+			database->addEntries(batch.entries);
+			ingestedEntries += batch.entries.size();
+		}
+
+		if (!batch.stamps.empty()) {
+			database->setDirectoryStamps(batch.stamps);
+		}
+
+		if (!batch.aliases.empty()) {
+			database->setDirectoryAliases(batch.aliases);
+		}
+	}
+	insertNanoseconds += Since(start);
+
+	// NOTE: The queue is first in first out, every batch of a job pushed before this one has already been ingested.
+	for (const auto &span: batch.spans) {
+		releaseJob(span.job, span.directories);
+	}
+
+	++ingestedBatches;
+	batch = {};
+}
+
+void Scanner::dropCancelled(Batch &batch)
+{
+	const auto cancelled = std::any_of(batch.spans.begin(), batch.spans.end(), [] (const Span &span) {
+		return span.job->cancelled.load();
+	});
+
+	if (!cancelled) {
+		return;
+	}
+
+	// NOTE: Moves the parts of the jobs that are still wanted to the front, the spans keep their counts for releaseJob().
+	auto keep = [] (auto &items, const std::size_t begin, const std::size_t end, std::size_t &size) {
+		if (begin != size) {
+			std::move(items.begin() + begin, items.begin() + end, items.begin() + size);
+		}
+
+		size += end - begin;
+	};
+
+	std::size_t entries = 0;
+	std::size_t stamps = 0;
+	std::size_t aliases = 0;
+	Span previous{};
+
+	for (const auto &span: batch.spans) {
+		if (!span.job->cancelled) {
+			keep(batch.entries, previous.entries, span.entries, entries);
+			keep(batch.stamps, previous.stamps, span.stamps, stamps);
+			keep(batch.aliases, previous.aliases, span.aliases, aliases);
+		}
+
+		previous = span;
+	}
+
+	batch.entries.resize(entries);
+	batch.stamps.resize(stamps);
+	batch.aliases.resize(aliases);
+}
+
+Index::Id Scanner::internDirectory(const std::string &path)
+{
+	std::lock_guard<std::mutex> lock{directoriesMutex};
+	return directories.intern(path);
+}
+
+std::string Scanner::directoryPath(const Index::Id directory) const
+{
+	std::lock_guard<std::mutex> lock{directoriesMutex};
+	return directories.path(directory);
+}
+
+void Scanner::resolveDirectories(Batch &batch)
+{
+	std::vector<Index::Id> missing{};
+	auto collect = [this, &missing] (const Index::Id directory) {
+		if (directory >= resolved.size() || resolved[directory] == Index::InvalidId) {
+			missing.push_back(directory);
+		}
+	};
+
+	for (const auto &entry: batch.entries) {
+		collect(entry.directory);
+	}
+
+	for (const auto &[directory, _]: batch.stamps) {
+		collect(directory);
+	}
+
+	for (const auto &[alias, target]: batch.aliases) {
+		collect(alias);
+		collect(target);
+	}
+
+	if (!missing.empty()) {
+		std::vector<Index::Id> chain{};
+		std::vector<Database::NewDirectory> requests{};
+		{
+			std::lock_guard<std::mutex> lock{directoriesMutex};
+			resolved.resize(directories.size(), Index::InvalidId);
+
+			// NOTE: The parents the index does not know yet either are interned along, they all come before their children.
+			std::unordered_set<Index::Id> seen{};
+			for (auto directory: missing) {
+				while (directory != Index::InvalidId && resolved[directory] == Index::InvalidId && seen.insert(directory).second) {
+					chain.push_back(directory);
+					directory = directories.parent(directory);
+				}
+			}
+
+			std::sort(chain.begin(), chain.end());
+
+			std::unordered_map<Index::Id, std::size_t> positions{};
+			requests.reserve(chain.size());
+
+			for (const auto directory: chain) {
+				const auto parent = directories.parent(directory);
+
+				Database::NewDirectory request{};
+				request.name = directories.name(directory);
+				if (parent != Index::InvalidId && resolved[parent] == Index::InvalidId) {
+					request.parentIndex = positions.at(parent);
+				} else if (parent != Index::InvalidId) {
+					request.parent = resolved[parent];
+				}
+
+				positions.emplace(directory, requests.size());
+				requests.push_back(std::move(request));
+			}
+		}
+
+		const auto ids = database->internDirectories(requests);
+		for (std::size_t i = 0; i < chain.size(); ++i) {
+			resolved[chain[i]] = ids[i];
+		}
+	}
+
+	for (auto &entry: batch.entries) {
+		entry.directory = resolved[entry.directory];
+	}
+
+	for (auto &[directory, _]: batch.stamps) {
+		directory = resolved[directory];
+	}
+
+	for (auto &[alias, target]: batch.aliases) {
+		alias = resolved[alias];
+		target = resolved[target];
+	}
+}
+
+void Scanner::filler()
+{
+	std::unique_lock<std::mutex> lock{fillMutex};
+	while (running) {
+		fillCv.wait(lock, [this] {
+			return fillRequested || !running;
+		});
+
+		if (!running) {
+			break;
+		}
+
+		fillRequested = false;
+		lock.unlock();
+
+		// NOTE: A pass interrupted by a scan is requested again when that scan finishes.
+		fillMetadata();
+
+		lock.lock();
+	}
+}
+
+void Scanner::requestFill()
+{
+	{
+		std::lock_guard<std::mutex> lock{fillMutex};
+		fillRequested = true;
+	}
+
+	fillCv.notify_one();
+}
+
+void Scanner::fillMetadata()
+{
+	constexpr std::size_t BatchSize = 4096;
+
+	DirectoryReader reader{};
+	std::vector<std::pair<Index::Id, Database::Entry>> files{};
+	Index::Id next = 0;
+	std::uint64_t layout = 0;
+
+	// NOTE: Listing comes first, the metadata only has to be there eventually.
+	while (running && !isScanning()) {
+		files.clear();
+		next = database->getPendingFiles(next, BatchSize, files, layout);
+		if (files.empty()) {
+			return;
+		}
+
+		// NOTE: Rows are stored in listing order, so files of the same folder mostly come in runs and each folder is opened once per run.
+		std::stable_sort(files.begin(), files.end(), [] (const auto &lhs, const auto &rhs) {
+			return lhs.second.directory < rhs.second.directory;
+		});
+
+		auto directory = Index::InvalidId;
+		bool opened = false;
+
+		for (auto &[row, file]: files) {
+			if (!running) {
+				return;
+			}
+
+			throttle(statLimiter, 1);
+			const auto start = Now();
+
+			if (file.directory != directory) {
+				directory = file.directory;
+				opened = reader.open(database->getPath(directory));
+			}
+
+			// NOTE: A file that is gone or cannot be stat'ed keeps empty metadata, it is not retried until it changes.
+			DirectoryReader::Entry entry{};
+			if (opened && reader.readMetadata(file.name, entry)) {
+				file.size = entry.size;
+				file.perms = entry.perms;
+				file.mtime = entry.mtime;
+			}
+
+			const auto latency = Since(start);
+			statNanoseconds.fetch_add(latency, std::memory_order_relaxed);
+			backoff(latency);
+		}
+
+		reader.close();
+
+		if (!database->setMetadata(files, layout)) {
+			continue;
+		}
+
+		// NOTE: The files come sorted by folder, which keeps the files of a root together as well.
+		auto root = Index::InvalidId;
+		Counters *rootCounters = nullptr;
+		for (const auto &[row, file]: files) {
+			if (file.root != root) {
+				root = file.root;
+				rootCounters = &getCounters(root);
+			}
+
+			rootCounters->bytes.fetch_add(file.size, std::memory_order_relaxed);
+		}
+	}
+}
+
+bool Scanner::isScanning()
+{
+	std::lock_guard<std::mutex> lock{jobsMutex};
+	return !jobs.empty();
+}
+
+Scanner::AddPathResult Scanner::addPath(const std::string &path)
+{
+	if (!fs::exists(path)) {
+		return AddPathResult::PathDoesNotExist;
+	}
+
+	if (!fs::is_directory(path)) {
+		return AddPathResult::PathNotDirectory;
+	}
+
+	if (roots.contains(path)) {
+		return AddPathResult::PathAlreadyAdded;
+	}
+
+	if (!roots.parent(path).empty()) {
+		return AddPathResult::ParentPathAlreadyAdded;
+	}
+
+	const auto children = roots.descendants(path);
+	for (const auto &child: children) {
+		roots.remove(child);
+		paths.erase(std::find(paths.begin(), paths.end(), child));
+	}
+
+	roots.insert(path);
+	paths.push_back(path);
+
+	if (!children.empty()) {
+		std::lock_guard<std::mutex> lock{mutex};
+		auto &merged = absorbed[path];
+
+		for (const auto &child: children) {
+			if (auto it = std::find(queue.begin(), queue.end(), child); it != queue.end()) {
+				queue.erase(it);
+			}
+
+			// NOTE: A child that had not been scanned yet may have taken over roots of its own meanwhile, they are passed on.
+			if (auto it = absorbed.find(child); it != absorbed.end()) {
+				merged.insert(merged.end(), it->second.begin(), it->second.end());
+				absorbed.erase(it);
+			}
+
+			merged.push_back(child);
+		}
+	}
+
+	if (running) {
+		enqueue(path);
+	}
+
+	return children.empty() ? AddPathResult::Ok : AddPathResult::ChildPathsMerged;
+}
+
+void Scanner::purgeRoot(const std::string &path, const bool removed)
+{
+	{
+		std::lock_guard<std::mutex> lock{jobsMutex};
+		for (auto &job: jobs) {
+			if (job.path == path) {
+				job.cancelled = true;
+			}
+		}
+
+		if (removed) {
+			removedRoots.insert(path);
+		}
+	}
+
+	std::lock_guard<std::mutex> lock{purgeMutex};
+	database->removeEntries(path);
+}
+
+void Scanner::mergeRoots(Job *job, const std::vector<std::string> &children)
+{
+	// NOTE: Nothing of the children may be ingested in between, and the purge mutex comes before the jobs mutex.
+	std::lock_guard<std::mutex> lock{purgeMutex};
+
+	std::vector<std::string> idle{};
+	{
+		std::lock_guard<std::mutex> jobsLock{jobsMutex};
+		for (const auto &child: children) {
+			bool busy = false;
+			for (auto &other: jobs) {
+				if (other.path == child) {
+					other.cancelled = true;
+					busy = true;
+				}
+			}
+
+			if (!busy) {
+				idle.push_back(child);
+			}
+		}
+	}
+
+	// NOTE: A child still being scanned or reconciled is not known to be complete, it is listed again as part of the job.
+	for (const auto &child: children) {
+		if (std::find(idle.begin(), idle.end(), child) == idle.end()) {
+			database->removeEntries(child);
+		}
+	}
+
+	const auto merged = database->mergeRoots(job->root, idle);
+	for (const auto &child: merged) {
+		job->merged.insert(internDirectory(child));
+	}
+
+	// NOTE: The statistics of the job carry on from those of the roots it took over.
+	std::lock_guard<std::mutex> countersLock{countersMutex};
+	for (auto &[root, counters]: this->counters) {
+		if (counters->removed || std::find(merged.begin(), merged.end(), counters->path) == merged.end()) {
+			continue;
+		}
+
+		job->counters->directories += counters->directories;
+		job->counters->files += counters->files;
+		job->counters->bytes += counters->bytes;
+		job->counters->errors += counters->errors;
+		job->counters->denied += counters->denied;
+		counters->removed = true;
+	}
+}
+
+void Scanner::enqueue(const std::string &path)
+{
+	{
+		std::lock_guard<std::mutex> lock{jobsMutex};
+		removedRoots.erase(path);
+	}
+
+	std::lock_guard<std::mutex> lock{mutex};
+
+	if (std::find(queue.begin(), queue.end(), path) != queue.end()) {
+		return;
+	}
+
+	queue.push_back(path);
+	cv.notify_one();
+}
+
+bool Scanner::removePath(const std::string &removed)
+{
+	if (!roots.contains(removed)) {
+		return false;
+	}
+
+	// NOTE: The path may be spelled differently than when it was added, the one it was added as is the one known elsewhere.
+	const auto path = roots.owner(removed);
+	roots.remove(path);
+	paths.erase(std::find(paths.begin(), paths.end(), path));
+
+	// NOTE: Folders that were only indexed as aliases of the removed ones have to be listed now, their roots are scanned again.
+	std::vector<std::string> rescans{};
+	for (const auto &[alias, target]: database->getAliases()) {
+		if (!IsWithin(target, path)) {
+			continue;
+		}
+
+		const auto root = roots.owner(alias);
+		if (!root.empty() && std::find(rescans.begin(), rescans.end(), root) == rescans.end()) {
+			rescans.push_back(root);
+		}
+	}
+
+	std::lock_guard<std::mutex> lock{mutex};
+	if (auto it = std::find(queue.begin(), queue.end(), path); it != queue.end()) {
+		queue.erase(it);
+	}
+
+	// NOTE: Roots taken over by the removed one before it got to scan them still hold their rows, they go with it.
+	if (auto it = absorbed.find(path); it != absorbed.end()) {
+		for (const auto &child: it->second) {
+			purgeRoot(child, true);
+		}
+
+		absorbed.erase(it);
+	}
+
+	purgeRoot(path, true);
+
+	// NOTE: Only the folders of the removed root are forgotten, those of the other roots still stand for their inodes.
+	std::vector<bool> subtree{};
+	{
+		std::lock_guard<std::mutex> directoriesLock{directoriesMutex};
+		if (const auto directory = directories.find(path); directory != Index::InvalidId) {
+			subtree = directories.subtree(directory);
+		}
+	}
+
+	visited.erase(subtree);
+
+	{
+		std::lock_guard<std::mutex> countersLock{countersMutex};
+		for (auto &[root, counters]: this->counters) {
+			if (IsWithin(counters->path, path)) {
+				counters->removed = true;
+			}
+		}
+	}
+
+	for (const auto &root: rescans) {
+		purgeRoot(root, false);
+		if (running && std::find(queue.begin(), queue.end(), root) == queue.end()) {
+			queue.push_back(root);
+			cv.notify_one();
+		}
+	}
+
+	return true;
 }
 
 bool Scanner::isRunning() const
 {
 	return running;
 }
+
+Scanner::IngestStats Scanner::getIngestStats() const
+{
+	IngestStats stats{};
+	stats.queueDepth = ingestQueue.size();
+	stats.maxQueueDepth = maxQueueDepth;
+	stats.queueCapacity = ingestQueue.capacity();
+	stats.batches = ingestedBatches;
+	stats.entries = ingestedEntries;
+	stats.stalls = this->stalls;
+	stats.stallTime = std::chrono::nanoseconds{stallNanoseconds.load()};
+	return stats;
+}
+
+Scanner::Stats Scanner::getStats() const
+{
+	Stats stats{};
+	stats.queuedDirectories = queuedTasks;
+	stats.pendingMetadata = database->getPendingCount();
+	stats.listTime = std::chrono::nanoseconds{listNanoseconds.load()};
+	stats.statTime = std::chrono::nanoseconds{statNanoseconds.load()};
+	stats.insertTime = std::chrono::nanoseconds{insertNanoseconds.load()};
+	stats.throttleTime = std::chrono::nanoseconds{throttleNanoseconds.load()};
+	stats.backoffTime = std::chrono::nanoseconds{backoffNanoseconds.load()};
+	stats.ingest = getIngestStats();
+
+	const auto now = Now();
+	{
+		std::lock_guard<std::mutex> lock{countersMutex};
+		for (const auto &[id, counters]: this->counters) {
+			if (counters->removed) {
+				continue;
+			}
+
+			RootStats root{};
+			root.path = counters->path;
+			root.directories = counters->directories;
+			root.files = counters->files;
+			root.bytes = counters->bytes;
+			root.errors = counters->errors;
+			root.denied = counters->denied;
+
+			const auto finished = counters->finished.load();
+			root.scanning = finished == 0;
+			root.elapsed = std::chrono::nanoseconds{(root.scanning ? now : finished) - counters->started};
+
+			stats.directories += root.directories;
+			stats.files += root.files;
+			stats.bytes += root.bytes;
+			stats.errors += root.errors;
+			stats.denied += root.denied;
+			stats.roots.push_back(std::move(root));
+		}
+	}
+
+	std::sort(stats.roots.begin(), stats.roots.end(), [] (const RootStats &lhs, const RootStats &rhs) {
+		return lhs.path < rhs.path;
+	});
+
+	return stats;
+}
@@ -19,14 +19,66 @@
 #define NOTHING_SCANNER_HPP
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <list>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
-class Database;
+#include "boundedqueue.hpp"
+#include "database.hpp"
+#include "directories.hpp"
+#include "directoryreader.hpp"
+#include "exclusions.hpp"
+#include "index.hpp"
+#include "inodeset.hpp"
+#include "roottrie.hpp"
+#include "throttle.hpp"
 
+/*
+	Indexes the added paths in the background.
+
+	Every directory is a task that lists its entries and queues its subdirectories. The tasks run on a fixed pool
+	of threads, each with its own deque: a thread works depth-first off the back of its deque and, once it runs
+	dry, steals from the front of the others, where the oldest and usually largest subtrees are. A single large
+	tree keeps every thread busy, while any number of roots shares the same threads.
+
+	The listed entries are not added to the database by the pool threads. They hand them over in batches through a
+	bounded queue to a single ingest thread, so listing carries on while the database is locked for an insert. A
+	full queue blocks the pool threads until the ingest thread catches up, which keeps the memory held by pending
+	batches bounded.
+
+	The pool threads never lock the database. The directories they find are interned in a table of the scanner's
+	own and the ingest thread maps them to the directories of the index, once per batch.
+
+	Scanning happens in two phases. The pool lists directories by name only, which makes the files searchable as
+	soon as possible, and a single low priority thread then stats the files in the background to fill in their
+	size, permissions and mtime. It stays idle while there are directories left to list.
+
+	Excluded folders are dropped while their parent is listed, they are never opened and nothing below them is
+	looked at. See the Exclusions class for the rules.
+
+	Every listed folder is remembered by its device and inode. A folder reached again through another path, by a
+	bind mount or a root overlapping another one that way, is not listed a second time but recorded as an alias
+	of the first. Optionally the scan also stays on the filesystem of each root and skips the mount points below it.
+
+	On a busy machine the scan can be made to yield to everything else, see the Policy structure.
+
+	Roots never overlap. A path below an existing root is refused, while a path above existing roots takes them
+	over: their rows are handed to the new root as they are, and its scan lists everything but the folders already
+	indexed under them.
+
+	Every scan of a root is a job that can be cancelled on its own. Removing a root cancels its jobs: the threads
+	stop listing its folders, the ingest thread drops whatever was already listed and the rows are purged in one go,
+	so that nothing of the root makes it into the database afterwards.
+*/
 class Scanner
 {
 	public:
@@ -37,6 +89,77 @@ class Scanner
 			PathAlreadyAdded,
 			ParentPathAlreadyAdded,
 			Ok,
+			// Added, and the paths below it that had been added before are merged into it.
+			ChildPathsMerged,
+		};
+
+		struct IngestStats
+		{
+			// The batches waiting for the ingest thread right now, and the most there ever were.
+			std::size_t queueDepth = 0;
+			std::size_t maxQueueDepth = 0;
+			std::size_t queueCapacity = 0;
+			std::uint64_t batches = 0;
+			std::uint64_t entries = 0;
+			// How often and for how long in total the pool threads waited on a full queue.
+			std::uint64_t stalls = 0;
+			std::chrono::nanoseconds stallTime{};
+		};
+
+		struct Policy
+		{
+			// Runs every thread of the scanner at idle I/O priority and the lowest CPU priority.
+			bool background = false;
+			// Caps on the folders listed and the files stat'ed per second, zero for none.
+			std::uint32_t directoriesPerSecond = 0;
+			std::uint32_t statsPerSecond = 0;
+			/*
+				A thread that takes longer than this to open a folder or stat a file pauses for a multiple of the time
+				it took, so the scan backs off while the storage is busy. Zero never pauses.
+			*/
+			std::chrono::milliseconds backoffLatency{};
+		};
+
+		struct RootStats
+		{
+			std::string path{};
+			// Counted since the last scan of the root started, a reconciliation only counts the folders it lists again.
+			std::uint64_t directories = 0;
+			std::uint64_t files = 0;
+			// The size of the files whose metadata has been read so far.
+			std::uint64_t bytes = 0;
+			// Folders that could not be listed, other than those the permissions keep out.
+			std::uint64_t errors = 0;
+			std::uint64_t denied = 0;
+			bool scanning = false;
+			// From the start of the scan to its end, or to now while it is still running.
+			std::chrono::nanoseconds elapsed{};
+
+			double filesPerSecond() const {
+				return elapsed.count() > 0 ? static_cast<double>(files) * 1e9 / static_cast<double>(elapsed.count()) : 0.0;
+			}
+		};
+
+		struct Stats
+		{
+			// The sums over every root.
+			std::uint64_t directories = 0;
+			std::uint64_t files = 0;
+			std::uint64_t bytes = 0;
+			std::uint64_t errors = 0;
+			std::uint64_t denied = 0;
+			// The folders waiting to be listed and the files waiting for their metadata.
+			std::size_t queuedDirectories = 0;
+			std::size_t pendingMetadata = 0;
+			// Summed over all the threads: the pool listing folders, the filler reading metadata and the ingest thread inserting.
+			std::chrono::nanoseconds listTime{};
+			std::chrono::nanoseconds statTime{};
+			std::chrono::nanoseconds insertTime{};
+			// Summed over all the threads as well, the time spent waiting on the rate limits and backing off.
+			std::chrono::nanoseconds throttleTime{};
+			std::chrono::nanoseconds backoffTime{};
+			IngestStats ingest{};
+			std::vector<RootStats> roots{};
 		};
 
 		Scanner(Database *database);
@@ -58,26 +181,240 @@ class Scanner
 
 		bool isRunning() const;
 
+		IngestStats getIngestStats() const;
+		// A snapshot of the counters, they are updated while scanning without taking any locks.
+		Stats getStats() const;
+
+		// The rules are not copied and have to outlive the scanner, they can only be changed while it is stopped.
+		void setExclusions(const Exclusions *exclusions) { this->exclusions = exclusions; }
+		// Whether folders on another filesystem than their root are skipped, can only be changed while stopped.
+		void setOneFilesystem(const bool oneFilesystem) { this->oneFilesystem = oneFilesystem; }
+		// Can only be changed while stopped.
+		void setPolicy(const Policy &policy);
+
 		std::vector<std::string> getPaths() const {
 			return paths;
 		}
 
 	private:
 		Database *database = nullptr;
+		const Exclusions *exclusions = nullptr;
+		bool oneFilesystem = false;
+		Policy policy{};
+
+		RateLimiter directoryLimiter{};
+		RateLimiter statLimiter{};
+		// Only used to sleep, so that a stopping scan does not wait out a pause.
+		std::mutex pauseMutex{};
+		std::condition_variable pauseCv{};
 
 		std::atomic<bool> running = false;
+		// The paths in the order they were added, the trie answers the lookups.
 		std::vector<std::string> paths{};
+		RootTrie roots{};
 
 		std::vector<std::string> queue{};
+		// Guarded by the mutex, maps the paths waiting to be scanned to the roots they took over.
+		std::unordered_map<std::string, std::vector<std::string>> absorbed{};
 		std::mutex mutex{};
 
 		std::thread thread{};
 		std::condition_variable cv{};
 
+		struct Counters
+		{
+			// Both guarded by the counters mutex, a removed root is left out of the stats until it is scanned again.
+			std::string path{};
+			bool removed = false;
+
+			std::atomic<std::uint64_t> directories = 0;
+			std::atomic<std::uint64_t> files = 0;
+			std::atomic<std::uint64_t> bytes = 0;
+			std::atomic<std::uint64_t> errors = 0;
+			std::atomic<std::uint64_t> denied = 0;
+			// Steady clock nanoseconds, finished stays zero while the root is being scanned.
+			std::atomic<std::int64_t> started = 0;
+			std::atomic<std::int64_t> finished = 0;
+		};
+
+		// One per root that has been scanned, they are never freed so the jobs and threads can hold on to them.
+		std::unordered_map<Index::Id, std::unique_ptr<Counters>> counters{};
+		mutable std::mutex countersMutex{};
+
+		std::atomic<std::uint64_t> listNanoseconds = 0;
+		std::atomic<std::uint64_t> statNanoseconds = 0;
+		std::atomic<std::uint64_t> insertNanoseconds = 0;
+		std::atomic<std::uint64_t> throttleNanoseconds = 0;
+		std::atomic<std::uint64_t> backoffNanoseconds = 0;
+
+		struct Job
+		{
+			std::string path{};
+			Index::Id root = Index::InvalidId;
+			Counters *counters = nullptr;
+			// A reconciliation only scans the folders that appeared since, the root itself is already complete.
+			bool reconciling = false;
+			// Set once the root is removed, see purgeRoot(). Whatever the job still finds is dropped.
+			std::atomic<bool> cancelled = false;
+			// The directories of the job that are queued, or listed but not flushed to the database yet.
+			std::atomic<std::size_t> pending = 0;
+			// The folders of the roots merged into this one, they are already indexed and not listed again. In the directory table of the scanner.
+			std::unordered_set<Index::Id> merged{};
+		};
+
+		struct Task
+		{
+			std::filesystem::path path{};
+			// In the directory table of the scanner.
+			Index::Id directory = Index::InvalidId;
+			Job *job = nullptr;
+			// The .gitignore patterns in effect for the directory, if they are honored.
+			std::shared_ptr<const IgnoreRules> ignore{};
+			// The device of the parent folder, zero for the root of a job.
+			std::uint64_t device = 0;
+		};
+
+		struct Span
+		{
+			Job *job = nullptr;
+			// The number of directories the job listed, a job is done once all of its directories have been ingested.
+			std::size_t directories = 0;
+			// Where the entries, stamps and aliases of the job end in the batch.
+			std::size_t entries = 0;
+			std::size_t stamps = 0;
+			std::size_t aliases = 0;
+		};
+
+		// What a number of listed directories found, handed to the ingest thread as a whole. The directory ids are those of the scanner.
+		struct Batch
+		{
+			std::vector<Database::Entry> entries{};
+			std::vector<std::pair<Index::Id, std::uint64_t>> stamps{};
+			std::vector<std::pair<Index::Id, Index::Id>> aliases{};
+			// Which job every part of the batch belongs to, in order.
+			std::vector<Span> spans{};
+		};
+
+		struct Worker
+		{
+			// Only the owning thread pushes and pops at the back, the other threads steal from the front.
+			std::deque<Task> tasks{};
+			std::mutex mutex{};
+
+			Batch batch{};
+			std::chrono::steady_clock::time_point flushed{};
+			// Scratch space for the paths the exclusion rules are checked against.
+			std::string path{};
+			// Scratch space for the subdirectories of the folder being listed, and their ids.
+			std::vector<std::string> subdirectories{};
+			std::vector<Index::Id> subdirectoryIds{};
+
+			DirectoryReader reader{};
+		};
+
+		// The pool threads, one per worker.
 		std::vector<std::thread> threads{};
+		std::vector<std::unique_ptr<Worker>> workers{};
+		std::size_t nextWorker = 0;
+
+		// Every directory found since the scanner started, the ids are not those of the index.
+		Directories directories{};
+		mutable std::mutex directoriesMutex{};
+		// Only used by the ingest thread, maps the directories of the scanner to those of the index.
+		std::vector<Index::Id> resolved{};
+
+		// The directory every folder listed since the scanner started was first seen as, keyed by device and inode.
+		InodeSet visited{};
+
+		std::list<Job> jobs{};
+		// Guarded by the jobs mutex, a job started for a removed root is cancelled from the start.
+		std::unordered_set<std::string> removedRoots{};
+		std::mutex jobsMutex{};
+		// Held by the ingest thread while it writes to the database, and by purgeRoot() while it cancels and purges.
+		std::mutex purgeMutex{};
+
+		std::atomic<std::size_t> queuedTasks = 0;
+		std::atomic<std::size_t> idleWorkers = 0;
+		std::mutex idleMutex{};
+		std::condition_variable idleCv{};
+
+		static constexpr std::size_t IngestQueueCapacity = 8;
+
+		BoundedQueue<Batch> ingestQueue{IngestQueueCapacity};
+		std::thread ingestThread{};
+		// Only used to sleep, the queue itself is lock-free.
+		std::mutex ingestMutex{};
+		std::condition_variable ingestCv{};
+		std::condition_variable spaceCv{};
+		std::atomic<std::size_t> waitingProducers = 0;
+		std::atomic<bool> ingestWaiting = false;
+
+		std::atomic<std::size_t> maxQueueDepth = 0;
+		std::atomic<std::uint64_t> ingestedBatches = 0;
+		std::atomic<std::uint64_t> ingestedEntries = 0;
+		std::atomic<std::uint64_t> stalls = 0;
+		std::atomic<std::uint64_t> stallNanoseconds = 0;
+
+		std::thread fillThread{};
+		std::mutex fillMutex{};
+		std::condition_variable fillCv{};
+		bool fillRequested = false;
+
+		// Lowers the priority of the calling thread if the policy asks for it.
+		bool applyPolicy();
+		// Waits for the rate limit to allow the given number of operations.
+		void throttle(RateLimiter &limiter, const std::uint32_t count);
+		// Pauses if an operation took longer than the policy allows.
+		void backoff(const std::uint64_t latency);
+		void pause(const std::chrono::nanoseconds duration);
 
 		void worker();
-		void workerTask(const std::string &path);
+		void scanRoot(const std::string &path);
+		Counters &getCounters(const Index::Id root);
+		// Starts counting a new scan of a root from zero.
+		Counters &resetCounters(const Index::Id root, const std::string &path);
+		// Brings a root restored from a snapshot up to date by listing only the directories that changed since.
+		void reconcile(const std::string &path);
+
+		// The job starts with a single pending directory that stands for the caller, releaseJob() lets go of it.
+		Job *createJob(const std::string &path, const Index::Id root, const bool reconciling);
+		// Queues the given directories, which have already been interned, to be indexed with everything below them.
+		void queueTasks(Job *job, std::vector<Task> &&tasks);
+		void releaseJob(Job *job, const std::size_t directories);
+		void finishJob(Job *job);
+		// Cancels the jobs of a root and removes its rows, atomically with respect to the ingest thread.
+		void purgeRoot(const std::string &path, const bool removed);
+		// Hands the complete roots below the one of a job over to it, those still being scanned are purged instead.
+		void mergeRoots(Job *job, const std::vector<std::string> &children);
+
+		Index::Id internDirectory(const std::string &path);
+		std::string directoryPath(const Index::Id directory) const;
+		// Maps the directories of a batch to those of the index, interning the ones it does not know yet.
+		void resolveDirectories(Batch &batch);
+
+		void poolWorker(const std::size_t index);
+		void push(const std::size_t index, Task &&task);
+		bool pop(const std::size_t index, Task &task);
+		void scanDirectory(const std::size_t index, const Task &task);
+		// Records that a task is done along with the entries it added to the batch.
+		void endTask(Worker &worker, Job *job);
+		// Returns false if the opened directory lies on another filesystem than allowed or was already listed through another path.
+		bool visit(Worker &worker, const Task &task);
+		// Whether an entry of the given directory is excluded, the path is a scratch buffer.
+		bool isExcluded(const std::string &directory, const std::string_view name, const bool isDirectory, const IgnoreRules *ignore, std::string &path) const;
+		// Loads the .gitignore files from the root down to the given directory, if they are honored.
+		std::shared_ptr<const IgnoreRules> loadIgnoreRules(const std::string &root, const std::string &directory) const;
+		void flush(Worker &worker);
+		void ingester();
+		void ingest(Batch &batch);
+		// Drops the parts of a batch that belong to cancelled jobs, called with the purge mutex held.
+		void dropCancelled(Batch &batch);
+
+		void filler();
+		void requestFill();
+		// Reads the metadata of the files that were indexed by name only, until there are none left or a scan starts.
+		void fillMetadata();
+		bool isScanning();
 };
 
 #endif
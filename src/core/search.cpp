@@ -0,0 +1,205 @@
+/*
+	Copyright (c) 2019 Kamil Chojnowski Y29udGFjdEBkaWF0aC5uZXQ=
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in the
+	Software without restriction, including without limitation the rights to use,
+	copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+	THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+	#include <immintrin.h>
+	#define NOTHING_SEARCH_X86
+#endif
+
+#include "search.hpp"
+
+namespace {
+
+/*
+	Maps match positions back to rows. Only the first match of a row is relevant, so after reporting one the
+	kernels resume scanning at the start of the next name.
+*/
+struct RowSink
+{
+	const std::uint32_t *offsets;
+	std::uint32_t row;
+	std::vector<std::uint32_t> &out;
+
+	std::size_t operator ()(const std::size_t position) {
+		while (offsets[row + 1] <= position) {
+			++row;
+		}
+
+		out.push_back(row);
+		return offsets[row + 1];
+	}
+};
+
+void FindScalar(const char *data, std::size_t index, const std::size_t end, const std::string_view needle, RowSink &sink)
+{
+	const auto size = needle.size();
+	while (index + size <= end) {
+		const auto hit = static_cast<const char *>(std::memchr(data + index, needle[0], end - size + 1 - index));
+		if (!hit) {
+			return;
+		}
+
+		const auto position = static_cast<std::size_t>(hit - data);
+		if (std::memcmp(hit + 1, needle.data() + 1, size - 1) == 0) {
+			index = sink(position);
+		} else {
+			index = position + 1;
+		}
+	}
+}
+
+#if defined(NOTHING_SEARCH_X86)
+
+/*
+	Both SIMD kernels compare a block against the first and the last byte of the needle at once and only run the
+	full comparison on positions where both match, which is rare for real file names.
+*/
+__attribute__((target("sse2")))
+void FindSse2(const char *data, std::size_t index, const std::size_t end, const std::string_view needle, RowSink &sink)
+{
+	constexpr std::size_t BlockSize = 16;
+
+	const auto size = needle.size();
+	const auto first = _mm_set1_epi8(needle.front());
+	const auto last = _mm_set1_epi8(needle.back());
+
+	while (index + size - 1 + BlockSize <= end) {
+		const auto blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + index));
+		const auto blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + index + size - 1));
+
+		auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_and_si128(
+			_mm_cmpeq_epi8(blockFirst, first),
+			_mm_cmpeq_epi8(blockLast, last)
+		)));
+
+		auto next = index + BlockSize;
+		while (mask != 0) {
+			const auto position = index + static_cast<std::size_t>(__builtin_ctz(mask));
+			if (size <= 2 || std::memcmp(data + position + 1, needle.data() + 1, size - 2) == 0) {
+				const auto resume = sink(position);
+				if (resume >= index + BlockSize) {
+					next = resume;
+					break;
+				}
+
+				mask &= ~((1u << (resume - index)) - 1);
+			} else {
+				mask &= mask - 1;
+			}
+		}
+
+		index = next;
+	}
+
+	FindScalar(data, index, end, needle, sink);
+}
+
+__attribute__((target("avx2")))
+void FindAvx2(const char *data, std::size_t index, const std::size_t end, const std::string_view needle, RowSink &sink)
+{
+	constexpr std::size_t BlockSize = 32;
+
+	const auto size = needle.size();
+	const auto first = _mm256_set1_epi8(needle.front());
+	const auto last = _mm256_set1_epi8(needle.back());
+
+	while (index + size - 1 + BlockSize <= end) {
+		const auto blockFirst = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + index));
+		const auto blockLast = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + index + size - 1));
+
+		auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(
+			_mm256_cmpeq_epi8(blockFirst, first),
+			_mm256_cmpeq_epi8(blockLast, last)
+		)));
+
+		auto next = index + BlockSize;
+		while (mask != 0) {
+			const auto position = index + static_cast<std::size_t>(__builtin_ctz(mask));
+			if (size <= 2 || std::memcmp(data + position + 1, needle.data() + 1, size - 2) == 0) {
+				const auto resume = sink(position);
+				if (resume >= index + BlockSize) {
+					next = resume;
+					break;
+				}
+
+				mask &= ~((1u << (resume - index)) - 1);
+			} else {
+				mask &= mask - 1;
+			}
+		}
+
+		index = next;
+	}
+
+	FindScalar(data, index, end, needle, sink);
+}
+
+#endif
+
+using FindFunction = void (*)(const char *, std::size_t, const std::size_t, const std::string_view, RowSink &);
+
+FindFunction SelectFind()
+{
+	#if defined(NOTHING_SEARCH_X86)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) {
+			return &FindAvx2;
+		}
+
+		if (__builtin_cpu_supports("sse2")) {
+			return &FindSse2;
+		}
+	#endif
+
+	return &FindScalar;
+}
+
+} // namespace <anonymous>
+
+void FindMatchingRows(
+	const char *buffer, const std::uint32_t *offsets,
+	const std::uint32_t begin, const std::uint32_t end,
+	const std::string_view needle, std::vector<std::uint32_t> &out
+)
+{
+	if (begin >= end) {
+		return;
+	}
+
+	if (needle.empty()) {
+		for (auto row = begin; row < end; ++row) {
+			out.push_back(row);
+		}
+
+		return;
+	}
+
+	static const FindFunction Find = SelectFind();
+
+	RowSink sink{offsets, begin, out};
+	Find(buffer, offsets[begin], offsets[end], needle, sink);
+}
+
+void FoldCase(const char *first, const char *last, char *out)
+{
+	for (; first != last; ++first, ++out) {
+		const auto ch = *first;
+		*out = (ch >= 'A' && ch <= 'Z') ? static_cast<char>(ch + ('a' - 'A')) : ch;
+	}
+}
@@ -0,0 +1,41 @@
+/*
+	Copyright (c) 2019 Kamil Chojnowski Y29udGFjdEBkaWF0aC5uZXQ=
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in the
+	Software without restriction, including without limitation the rights to use,
+	copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+	THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef NOTHING_SEARCH_HPP
+#define NOTHING_SEARCH_HPP
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+/*
+	Appends the id of every row in [begin, end) whose name contains the needle.
+
+	The buffer holds the NUL-separated names, row n spans [offsets[n], offsets[n + 1]) including the terminator.
+	Matching is a plain byte comparison, case-insensitive searches are expected to pass a pre-lowercased buffer
+	and needle. The implementation is picked at runtime (AVX2, SSE2 or scalar) based on the CPU.
+*/
+void FindMatchingRows(
+	const char *buffer, const std::uint32_t *offsets,
+	const std::uint32_t begin, const std::uint32_t end,
+	const std::string_view needle, std::vector<std::uint32_t> &out
+);
+
+// Lowercases ASCII characters, leaves every other byte as is.
+void FoldCase(const char *first, const char *last, char *out);
+
+#endif // NOTHING_SEARCH_HPP
@@ -0,0 +1,649 @@
+/*
+	Copyright (c) 2019 Kamil Chojnowski Y29udGFjdEBkaWF0aC5uZXQ=
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in the
+	Software without restriction, including without limitation the rights to use,
+	copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+	THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+
+#if defined(PLATFORM_LINUX)
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#else
+	#include <fstream>
+#endif
+
+#if defined(PLATFORM_WINDOWS)
+	#include <io.h>
+#endif
+
+#include "snapshot.hpp"
+#include "index.hpp"
+#include "search.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char Magic[8] = {'N', 'O', 'T', 'H', 'I', 'N', 'G', '\0'};
+constexpr std::uint64_t Alignment = 64;
+
+enum class SectionType: std::uint32_t
+{
+	Names,
+	Offsets,
+	DirectoryIds,
+	RootIds,
+	Sizes,
+	Permissions,
+	Mtimes,
+	Pending,
+	ExtensionIds,
+	Types,
+	ExtensionNames,
+	Roots,
+	CompleteRoots,
+	DirectoryParents,
+	DirectoryNames,
+	DirectoryStamps,
+	DirectoryAliases,
+	TrigramKeys,
+	TrigramCounts,
+	TrigramLasts,
+	TrigramOffsets,
+	TrigramData,
+	Count,
+};
+
+struct Header
+{
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t sections;
+	std::uint64_t fileSize;
+	// Covers the section table, which in turn holds the checksum of every section.
+	std::uint64_t checksum;
+};
+
+struct Section
+{
+	std::uint32_t type;
+	std::uint32_t reserved;
+	std::uint64_t offset;
+	std::uint64_t size;
+	std::uint64_t checksum;
+};
+
+static_assert(sizeof(Header) == 32 && sizeof(Section) == 32, "The snapshot header layout must not depend on padding.");
+
+struct Blob
+{
+	SectionType type;
+	const void *data;
+	std::uint64_t size;
+};
+
+template <typename T>
+Blob MakeBlob(const SectionType type, const std::vector<T> &values)
+{
+	return {type, values.data(), values.size() * sizeof(T)};
+}
+
+inline std::uint64_t Align(const std::uint64_t value)
+{
+	return (value + Alignment - 1) & ~(Alignment - 1);
+}
+
+/*
+	A simple 64-bit checksum that consumes 32 bytes per step over four independent lanes, it only has to catch
+	truncated or otherwise damaged files and is fast enough not to dominate the load time.
+*/
+std::uint64_t Checksum(const void *data, const std::uint64_t size)
+{
+	constexpr std::uint64_t Prime = 0x9E3779B97F4A7C15ull;
+
+	auto bytes = static_cast<const std::uint8_t *>(data);
+	std::uint64_t lanes[4] = {Prime, Prime ^ 1, Prime ^ 2, Prime ^ 3};
+
+	auto mix = [] (std::uint64_t lane, const std::uint64_t word) {
+		lane = (lane ^ word) * Prime;
+		return lane ^ (lane >> 29);
+	};
+
+	std::uint64_t index = 0;
+	for (; index + 32 <= size; index += 32) {
+		for (int lane = 0; lane < 4; ++lane) {
+			std::uint64_t word = 0;
+			std::memcpy(&word, bytes + index + lane * 8, sizeof(word));
+			lanes[lane] = mix(lanes[lane], word);
+		}
+	}
+
+	std::uint64_t result = mix(size, lanes[0]);
+	for (int lane = 1; lane < 4; ++lane) {
+		result = mix(result, lanes[lane]);
+	}
+
+	for (; index < size; ++index) {
+		result = mix(result, bytes[index]);
+	}
+
+	return result;
+}
+
+// A read-only view of the whole snapshot file, memory mapped where the platform allows it.
+class MappedFile
+{
+	public:
+		MappedFile() = default;
+		~MappedFile() {
+#if defined(PLATFORM_LINUX)
+			if (mapping) {
+				munmap(mapping, length);
+			}
+#endif
+		}
+
+		MappedFile(const MappedFile &) = delete;
+		MappedFile(MappedFile &&) = delete;
+
+		MappedFile &operator =(const MappedFile &) = delete;
+		MappedFile &operator =(MappedFile &&) = delete;
+
+		bool open(const std::string &path) {
+#if defined(PLATFORM_LINUX)
+			const auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+			if (fd == -1) {
+				return false;
+			}
+
+			struct stat info{};
+			if (fstat(fd, &info) == -1 || info.st_size <= 0) {
+				close(fd);
+				return false;
+			}
+
+			length = static_cast<std::size_t>(info.st_size);
+			auto result = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+			close(fd);
+
+			if (result == MAP_FAILED) {
+				return false;
+			}
+
+			// NOTE: The columns are copied front to back right after, let the kernel read ahead aggressively. The advice values are not flags.
+			madvise(result, length, MADV_SEQUENTIAL);
+			madvise(result, length, MADV_WILLNEED);
+
+			mapping = result;
+			bytes = static_cast<const std::uint8_t *>(result);
+			return true;
+#else
+			std::ifstream file{path, std::ios::binary | std::ios::ate};
+			if (!file) {
+				return false;
+			}
+
+			buffer.resize(static_cast<std::size_t>(file.tellg()));
+			file.seekg(0);
+			if (!file.read(reinterpret_cast<char *>(buffer.data()), buffer.size())) {
+				return false;
+			}
+
+			length = buffer.size();
+			bytes = buffer.data();
+			return true;
+#endif
+		}
+
+		const std::uint8_t *data() const { return bytes; }
+		std::size_t size() const { return length; }
+
+	private:
+		const std::uint8_t *bytes = nullptr;
+		std::size_t length = 0;
+
+#if defined(PLATFORM_LINUX)
+		void *mapping = nullptr;
+#else
+		std::vector<std::uint8_t> buffer{};
+#endif
+};
+
+struct View
+{
+	const std::uint8_t *data = nullptr;
+	std::uint64_t size = 0;
+};
+
+template <typename T>
+bool Read(const View &view, std::vector<T> &out)
+{
+	if (view.size % sizeof(T) != 0) {
+		return false;
+	}
+
+	out.resize(view.size / sizeof(T));
+	if (!out.empty()) {
+		std::memcpy(out.data(), view.data, view.size);
+	}
+
+	return true;
+}
+
+bool WriteAll(std::FILE *file, const void *data, const std::uint64_t size)
+{
+	return size == 0 || std::fwrite(data, 1, size, file) == size;
+}
+
+// Waits until what has been flushed to the file is on the disk.
+bool SyncFile(std::FILE *file)
+{
+#if defined(PLATFORM_LINUX)
+	return fsync(fileno(file)) == 0;
+#elif defined(PLATFORM_WINDOWS)
+	return _commit(_fileno(file)) == 0;
+#else
+	return true;
+#endif
+}
+
+} // namespace <anonymous>
+
+bool Snapshot::save(const Index &index, const std::string &path)
+{
+	const std::vector<std::uint8_t> completeRoots(index.completeRoots.begin(), index.completeRoots.end());
+
+	std::vector<char> directoryNames{};
+	for (const auto &name: index.directories.names) {
+		directoryNames.insert(directoryNames.end(), name.begin(), name.end());
+		directoryNames.push_back('\0');
+	}
+
+	std::vector<char> extensionNames{};
+	for (const auto &extension: index.extensions) {
+		extensionNames.insert(extensionNames.end(), extension.begin(), extension.end());
+		extensionNames.push_back('\0');
+	}
+
+	std::vector<std::uint32_t> trigramKeys{};
+	std::vector<std::uint32_t> trigramCounts{};
+	std::vector<std::uint32_t> trigramLasts{};
+	std::vector<std::uint64_t> trigramOffsets{0};
+	std::vector<std::uint8_t> trigramData{};
+
+	const auto &lists = index.trigrams.lists;
+	trigramKeys.reserve(lists.size());
+	trigramCounts.reserve(lists.size());
+	trigramLasts.reserve(lists.size());
+	trigramOffsets.reserve(lists.size() + 1);
+
+	for (const auto &[key, list]: lists) {
+		trigramKeys.push_back(key);
+		trigramCounts.push_back(list.count);
+		trigramLasts.push_back(list.last);
+		trigramData.insert(trigramData.end(), list.data.begin(), list.data.end());
+		trigramOffsets.push_back(trigramData.size());
+	}
+
+	// NOTE: The folded names are not stored, folding the arena on load is cheaper than reading it from disk.
+	const std::vector<Blob> blobs = {
+		MakeBlob(SectionType::Names, index.names),
+		MakeBlob(SectionType::Offsets, index.offsets),
+		MakeBlob(SectionType::DirectoryIds, index.directoryIds),
+		MakeBlob(SectionType::RootIds, index.rootIds),
+		MakeBlob(SectionType::Sizes, index.sizes),
+		MakeBlob(SectionType::Permissions, index.permissions),
+		MakeBlob(SectionType::Mtimes, index.mtimes),
+		MakeBlob(SectionType::Pending, index.pending),
+		MakeBlob(SectionType::ExtensionIds, index.extensionIds),
+		MakeBlob(SectionType::Types, index.types),
+		MakeBlob(SectionType::ExtensionNames, extensionNames),
+		MakeBlob(SectionType::Roots, index.roots),
+		MakeBlob(SectionType::CompleteRoots, completeRoots),
+		MakeBlob(SectionType::DirectoryParents, index.directories.parents),
+		MakeBlob(SectionType::DirectoryNames, directoryNames),
+		MakeBlob(SectionType::DirectoryStamps, index.directoryStamps),
+		MakeBlob(SectionType::DirectoryAliases, index.directoryAliases),
+		MakeBlob(SectionType::TrigramKeys, trigramKeys),
+		MakeBlob(SectionType::TrigramCounts, trigramCounts),
+		MakeBlob(SectionType::TrigramLasts, trigramLasts),
+		MakeBlob(SectionType::TrigramOffsets, trigramOffsets),
+		MakeBlob(SectionType::TrigramData, trigramData),
+	};
+
+	std::vector<Section> table(blobs.size());
+	std::uint64_t offset = Align(sizeof(Header) + sizeof(Section) * blobs.size());
+	for (std::size_t i = 0; i < blobs.size(); ++i) {
+		table[i] = {static_cast<std::uint32_t>(blobs[i].type), 0, offset, blobs[i].size, Checksum(blobs[i].data, blobs[i].size)};
+		offset = Align(offset + blobs[i].size);
+	}
+
+	Header header{};
+	std::memcpy(header.magic, Magic, sizeof(Magic));
+	header.version = Version;
+	header.sections = static_cast<std::uint32_t>(table.size());
+	header.fileSize = offset;
+	header.checksum = Checksum(table.data(), table.size() * sizeof(Section));
+
+	std::error_code ec{};
+	if (const auto parent = fs::path{path}.parent_path(); !parent.empty()) {
+		fs::create_directories(parent, ec);
+	}
+
+	// NOTE: The snapshot is written next to the old one and renamed over it, a crash never leaves a torn file behind.
+	const auto temporary = path + ".tmp";
+	auto file = std::fopen(temporary.c_str(), "wb");
+	if (!file) {
+		std::fprintf(stderr, "Failed to open the snapshot file %s for writing.\n", temporary.c_str());
+		return false;
+	}
+
+	static const std::uint8_t Padding[Alignment] = {};
+
+	bool ok = WriteAll(file, &header, sizeof(header)) && WriteAll(file, table.data(), table.size() * sizeof(Section));
+	std::uint64_t position = sizeof(Header) + sizeof(Section) * table.size();
+
+	for (std::size_t i = 0; ok && i < blobs.size(); ++i) {
+		ok = WriteAll(file, Padding, table[i].offset - position) && WriteAll(file, blobs[i].data, blobs[i].size);
+		position = table[i].offset + blobs[i].size;
+	}
+
+	ok = ok && WriteAll(file, Padding, header.fileSize - position);
+
+	// NOTE: The data has to reach the disk before the rename does, or a power loss could leave the new name on a torn file.
+	ok = ok && std::fflush(file) == 0 && SyncFile(file);
+	ok = (std::fclose(file) == 0) && ok;
+
+	if (!ok) {
+		std::fprintf(stderr, "Failed to write the snapshot file %s.\n", temporary.c_str());
+		fs::remove(temporary, ec);
+		return false;
+	}
+
+	fs::rename(temporary, path, ec);
+	if (ec) {
+		std::fprintf(stderr, "Failed to replace the snapshot file %s, reason: %s.\n", path.c_str(), ec.message().c_str());
+		fs::remove(temporary, ec);
+		return false;
+	}
+
+	return true;
+}
+
+bool Snapshot::load(Index &index, const std::string &path)
+{
+	MappedFile file{};
+	if (!file.open(path)) {
+		return false;
+	}
+
+	const auto data = file.data();
+	const auto size = static_cast<std::uint64_t>(file.size());
+
+	Header header{};
+	if (size < sizeof(Header)) {
+		std::fprintf(stderr, "Ignoring the snapshot file %s, reason: file truncated.\n", path.c_str());
+		return false;
+	}
+
+	std::memcpy(&header, data, sizeof(header));
+	if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0) {
+		std::fprintf(stderr, "Ignoring the snapshot file %s, reason: not a snapshot.\n", path.c_str());
+		return false;
+	}
+
+	if (header.version != Version) {
+		std::fprintf(stderr, "Ignoring the snapshot file %s, reason: unsupported version %u.\n", path.c_str(), header.version);
+		return false;
+	}
+
+	const auto tableSize = static_cast<std::uint64_t>(header.sections) * sizeof(Section);
+	if (header.fileSize != size || tableSize > size - sizeof(Header) || Checksum(data + sizeof(Header), tableSize) != header.checksum) {
+		std::fprintf(stderr, "Ignoring the snapshot file %s, reason: corrupted header.\n", path.c_str());
+		return false;
+	}
+
+	View views[static_cast<std::size_t>(SectionType::Count)] = {};
+	for (std::uint32_t i = 0; i < header.sections; ++i) {
+		Section section{};
+		std::memcpy(&section, data + sizeof(Header) + i * sizeof(Section), sizeof(section));
+
+		if (section.offset > size || section.size > size - section.offset || Checksum(data + section.offset, section.size) != section.checksum) {
+			std::fprintf(stderr, "Ignoring the snapshot file %s, reason: corrupted section %u.\n", path.c_str(), section.type);
+			return false;
+		}
+
+		// NOTE: Unknown sections are skipped, they can only come from a newer writer that kept the format compatible.
+		if (section.type < static_cast<std::uint32_t>(SectionType::Count)) {
+			views[section.type] = {data + section.offset, section.size};
+		}
+	}
+
+	auto view = [&views] (const SectionType type) -> const View & {
+		return views[static_cast<std::size_t>(type)];
+	};
+
+	std::vector<char> names{};
+	std::vector<std::uint32_t> offsets{};
+	std::vector<Index::Id> directoryIds{};
+	std::vector<Index::Id> rootIds{};
+	std::vector<std::uint64_t> sizes{};
+	std::vector<std::uint16_t> permissions{};
+	std::vector<std::uint64_t> mtimes{};
+	std::vector<std::uint8_t> pending{};
+	std::vector<Index::ExtensionId> extensionIds{};
+	std::vector<std::uint8_t> types{};
+	std::vector<char> extensionNames{};
+	std::vector<Index::Id> roots{};
+	std::vector<std::uint8_t> completeRoots{};
+	std::vector<Directories::Id> directoryParents{};
+	std::vector<char> directoryNames{};
+	std::vector<std::uint64_t> directoryStamps{};
+	std::vector<Index::Id> directoryAliases{};
+	std::vector<std::uint32_t> trigramKeys{};
+	std::vector<std::uint32_t> trigramCounts{};
+	std::vector<std::uint32_t> trigramLasts{};
+	std::vector<std::uint64_t> trigramOffsets{};
+
+	bool ok = Read(view(SectionType::Names), names)
+		&& Read(view(SectionType::Offsets), offsets)
+		&& Read(view(SectionType::DirectoryIds), directoryIds)
+		&& Read(view(SectionType::RootIds), rootIds)
+		&& Read(view(SectionType::Sizes), sizes)
+		&& Read(view(SectionType::Permissions), permissions)
+		&& Read(view(SectionType::Mtimes), mtimes)
+		&& Read(view(SectionType::Pending), pending)
+		&& Read(view(SectionType::ExtensionIds), extensionIds)
+		&& Read(view(SectionType::Types), types)
+		&& Read(view(SectionType::ExtensionNames), extensionNames)
+		&& Read(view(SectionType::Roots), roots)
+		&& Read(view(SectionType::CompleteRoots), completeRoots)
+		&& Read(view(SectionType::DirectoryParents), directoryParents)
+		&& Read(view(SectionType::DirectoryNames), directoryNames)
+		&& Read(view(SectionType::DirectoryStamps), directoryStamps)
+		&& Read(view(SectionType::DirectoryAliases), directoryAliases)
+		&& Read(view(SectionType::TrigramKeys), trigramKeys)
+		&& Read(view(SectionType::TrigramCounts), trigramCounts)
+		&& Read(view(SectionType::TrigramLasts), trigramLasts)
+		&& Read(view(SectionType::TrigramOffsets), trigramOffsets);
+
+	/*
+		The checksums only prove that the file is the one that was written, the ids are still checked against the
+		table sizes so that a snapshot from a buggy writer cannot send the index out of bounds.
+	*/
+	const auto rows = directoryIds.size();
+	const auto directoryCount = directoryParents.size();
+	const auto extensionCount = static_cast<std::size_t>(std::count(extensionNames.begin(), extensionNames.end(), '\0'));
+	const auto trigramData = view(SectionType::TrigramData);
+
+	ok = ok
+		&& offsets.size() == rows + 1 && offsets.front() == 0 && offsets.back() == names.size()
+		&& rootIds.size() == rows && sizes.size() == rows && permissions.size() == rows
+		&& mtimes.size() == rows && pending.size() == rows
+		&& extensionIds.size() == rows && types.size() == rows
+		&& !extensionNames.empty() && extensionNames.front() == '\0' && extensionNames.back() == '\0'
+		&& completeRoots.size() == roots.size()
+		&& (directoryNames.empty() || directoryNames.back() == '\0')
+		&& static_cast<std::size_t>(std::count(directoryNames.begin(), directoryNames.end(), '\0')) == directoryCount
+		&& directoryStamps.size() <= directoryCount && directoryAliases.size() <= directoryCount
+		&& trigramCounts.size() == trigramKeys.size() && trigramLasts.size() == trigramKeys.size()
+		&& trigramOffsets.size() == trigramKeys.size() + 1 && trigramOffsets.front() == 0 && trigramOffsets.back() == trigramData.size;
+
+	for (std::size_t row = 0; ok && row < rows; ++row) {
+		ok = offsets[row] < offsets[row + 1] && rootIds[row] < roots.size()
+			&& extensionIds[row] < extensionCount && types[row] < FileTypeCount && pending[row] <= 1
+			&& (directoryIds[row] == Index::InvalidId || directoryIds[row] < directoryCount);
+	}
+
+	for (std::size_t root = 0; ok && root < roots.size(); ++root) {
+		ok = roots[root] < directoryCount || roots[root] == Index::InvalidId;
+	}
+
+	for (std::size_t directory = 0; ok && directory < directoryCount; ++directory) {
+		ok = directoryParents[directory] == Directories::InvalidId || directoryParents[directory] < directory;
+	}
+
+	for (std::size_t directory = 0; ok && directory < directoryAliases.size(); ++directory) {
+		ok = directoryAliases[directory] == Index::InvalidId || directoryAliases[directory] < directoryCount;
+	}
+
+	// NOTE: The row ids of the posting lists are used as they are by the queries, every list is decoded once here.
+	for (std::size_t i = 0; ok && i < trigramKeys.size(); ++i) {
+		ok = trigramOffsets[i] <= trigramOffsets[i + 1]
+			&& Trigrams::isValidList(trigramData.data + trigramOffsets[i], trigramOffsets[i + 1] - trigramOffsets[i], trigramCounts[i], trigramLasts[i], rows);
+	}
+
+	if (!ok) {
+		std::fprintf(stderr, "Ignoring the snapshot file %s, reason: inconsistent sections.\n", path.c_str());
+		return false;
+	}
+
+	index.directoryStamps = std::move(directoryStamps);
+	index.directoryAliases = std::move(directoryAliases);
+
+	auto &directories = index.directories;
+	directories.parents = std::move(directoryParents);
+	directories.names.clear();
+	directories.lookup.clear();
+	directories.lookup.reserve(directoryCount);
+
+	std::size_t start = 0;
+	for (std::size_t i = 0; i < directoryNames.size(); ++i) {
+		if (directoryNames[i] == '\0') {
+			directories.names.emplace_back(directoryNames.data() + start, i - start);
+			start = i + 1;
+		}
+	}
+
+	for (Directories::Id id = 0; id < directoryCount; ++id) {
+		directories.lookup.emplace(Directories::Key{directories.parents[id], directories.names[id]}, id);
+	}
+
+	auto &lists = index.trigrams.lists;
+	lists.clear();
+	lists.reserve(trigramKeys.size());
+
+	for (std::size_t i = 0; i < trigramKeys.size(); ++i) {
+		auto &list = lists[trigramKeys[i]];
+		list.data.assign(trigramData.data + trigramOffsets[i], trigramData.data + trigramOffsets[i + 1]);
+		list.count = trigramCounts[i];
+		list.last = trigramLasts[i];
+	}
+
+	index.extensions.clear();
+	index.extensionLookup.clear();
+	index.extensionTypes.clear();
+
+	start = 0;
+	for (std::size_t i = 0; i < extensionNames.size(); ++i) {
+		if (extensionNames[i] == '\0') {
+			std::string extension{extensionNames.data() + start, i - start};
+			index.extensionLookup.emplace(extension, static_cast<Index::ExtensionId>(index.extensions.size()));
+			index.extensionTypes.push_back(extension.empty() ? FileType::Generic : GetFileType("." + extension));
+			index.extensions.push_back(std::move(extension));
+			start = i + 1;
+		}
+	}
+
+	index.extensionBitmaps.assign(index.extensions.size(), {});
+
+	index.folded.resize(names.size());
+	FoldCase(names.data(), names.data() + names.size(), index.folded.data());
+
+	index.names = std::move(names);
+	index.offsets = std::move(offsets);
+	index.directoryIds = std::move(directoryIds);
+	index.pinnedRows.clear();
+	index.rootIds = std::move(rootIds);
+	index.sizes = std::move(sizes);
+	index.permissions = std::move(permissions);
+	index.mtimes = std::move(mtimes);
+	index.pending = std::move(pending);
+	index.extensionIds = std::move(extensionIds);
+	index.types = std::move(types);
+	index.roots = std::move(roots);
+	index.rootLookup.clear();
+	for (std::size_t root = 0; root < index.roots.size(); ++root) {
+		if (index.roots[root] != Index::InvalidId) {
+			index.rootLookup.emplace(index.roots[root], static_cast<Index::Id>(root));
+		}
+	}
+
+	index.completeRoots.assign(completeRoots.begin(), completeRoots.end());
+
+	index.deadRows = 0;
+	index.pendingRows = 0;
+	for (std::size_t row = 0; row < rows; ++row) {
+		if (index.directoryIds[row] == Index::InvalidId) {
+			index.pending[row] = false;
+			++index.deadRows;
+		} else {
+			index.pendingRows += index.pending[row];
+		}
+	}
+
+	index.rebuildBitmaps();
+
+	// NOTE: Every row id changes meaning, treat the load like a compaction so that no cached result survives it.
+	++index.modifications;
+	++index.compactions;
+	index.rootModifications.assign(index.roots.size(), 0);
+	return true;
+}
+
+std::string Snapshot::defaultPath()
+{
+#if defined(PLATFORM_WINDOWS)
+	if (const auto base = std::getenv("LOCALAPPDATA"); base && *base) {
+		return (fs::path{base} / "nothing" / "index.snapshot").string();
+	}
+#else
+	if (const auto base = std::getenv("XDG_CACHE_HOME"); base && *base) {
+		return (fs::path{base} / "nothing" / "index.snapshot").string();
+	}
+
+	if (const auto home = std::getenv("HOME"); home && *home) {
+		return (fs::path{home} / ".cache" / "nothing" / "index.snapshot").string();
+	}
+#endif
+
+	return "index.snapshot";
+}
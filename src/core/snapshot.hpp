@@ -0,0 +1,51 @@
+/*
+	Copyright (c) 2019 Kamil Chojnowski Y29udGFjdEBkaWF0aC5uZXQ=
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in the
+	Software without restriction, including without limitation the rights to use,
+	copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+	THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef NOTHING_SNAPSHOT_HPP
+#define NOTHING_SNAPSHOT_HPP
+
+#include <cstdint>
+#include <string>
+
+class Index;
+
+/*
+	On-disk snapshot of the index.
+
+	The file starts with a fixed header followed by a table of sections, every section is a raw dump of one of the
+	index columns (or of the directory table and trigram posting lists) aligned to 64 bytes and guarded by its own
+	checksum. Loading maps the file and copies the columns back in bulk, nothing is parsed row by row except for
+	rebuilding the directory lookup table and the extension and type bitmaps.
+
+	The format is versioned, a snapshot written by a different version is ignored and the index is simply rebuilt
+	by the scanner.
+*/
+class Snapshot
+{
+	public:
+		static constexpr std::uint32_t Version = 5;
+
+		Snapshot() = delete;
+
+		static bool save(const Index &index, const std::string &path);
+		static bool load(Index &index, const std::string &path);
+
+		// The default snapshot location in the per-user cache folder.
+		static std::string defaultPath();
+};
+
+#endif // NOTHING_SNAPSHOT_HPP
@@ -0,0 +1,82 @@
+/*
+	Copyright (c) 2019 Kamil Chojnowski Y29udGFjdEBkaWF0aC5uZXQ=
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in the
+	Software without restriction, including without limitation the rights to use,
+	copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+	THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <algorithm>
+
+#if defined(PLATFORM_LINUX)
+	#include <sys/resource.h>
+	#include <sys/syscall.h>
+	#include <unistd.h>
+#elif defined(PLATFORM_WINDOWS)
+	#include <windows.h>
+#endif
+
+#include "throttle.hpp"
+
+#if defined(PLATFORM_LINUX)
+namespace {
+
+// NOTE: From linux/ioprio.h, which is not always installed and has no glibc wrapper.
+constexpr int IoprioWhoProcess = 1;
+constexpr int IoprioClassIdle = 3;
+constexpr int IoprioClassShift = 13;
+
+} // namespace <anonymous>
+#endif
+
+bool LowerThreadPriority()
+{
+#if defined(PLATFORM_LINUX)
+	// NOTE: Both are per thread on Linux when given the thread id, zero stands for the calling thread in ioprio_set().
+	const auto tid = static_cast<id_t>(syscall(SYS_gettid));
+	const auto niced = setpriority(PRIO_PROCESS, tid, 19) == 0;
+	const auto idle = syscall(SYS_ioprio_set, IoprioWhoProcess, 0, IoprioClassIdle << IoprioClassShift) == 0;
+	return niced && idle;
+#elif defined(PLATFORM_WINDOWS)
+	// NOTE: Background mode lowers the I/O and memory priority along with the CPU one.
+	return SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN) != 0;
+#else
+	return false;
+#endif
+}
+
+void RateLimiter::setRate(const std::uint32_t perSecond)
+{
+	rate = perSecond;
+	tokens = static_cast<double>(perSecond);
+	refilled = std::chrono::steady_clock::now();
+}
+
+std::chrono::nanoseconds RateLimiter::take(const std::uint32_t count)
+{
+	if (rate == 0) {
+		return {};
+	}
+
+	std::lock_guard<std::mutex> lock{mutex};
+
+	const auto now = std::chrono::steady_clock::now();
+	const auto elapsed = std::chrono::duration<double>(now - refilled).count();
+	refilled = now;
+
+	tokens = std::min(static_cast<double>(rate), tokens + elapsed * rate) - count;
+	if (tokens >= 0.0) {
+		return {};
+	}
+
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double>(-tokens / rate));
+}
@@ -0,0 +1,61 @@
+/*
+	Copyright (c) 2019 Kamil Chojnowski Y29udGFjdEBkaWF0aC5uZXQ=
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in the
+	Software without restriction, including without limitation the rights to use,
+	copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+	THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef NOTHING_THROTTLE_HPP
+#define NOTHING_THROTTLE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+// Moves the calling thread to the idle I/O class and the lowest CPU priority, returns false if either was refused.
+bool LowerThreadPriority();
+
+/*
+	Token bucket shared by any number of threads, it allows a given number of operations per second with bursts of
+	up to a second's worth.
+
+	Taking tokens never blocks, it may put the bucket in debt and returns how long the caller should wait before
+	doing the work instead. The threads sleep on their own terms then, a stopping scan does not have to wait out
+	the limiter.
+*/
+class RateLimiter
+{
+	public:
+		RateLimiter() = default;
+
+		RateLimiter(const RateLimiter &) = delete;
+		RateLimiter(RateLimiter &&) = delete;
+
+		RateLimiter &operator =(const RateLimiter &) = delete;
+		RateLimiter &operator =(RateLimiter &&) = delete;
+
+		// Zero lifts the limit. Not thread-safe, the rate can only be changed while nothing takes tokens.
+		void setRate(const std::uint32_t perSecond);
+		bool isLimited() const { return rate > 0; }
+
+		std::chrono::nanoseconds take(const std::uint32_t count);
+
+	private:
+		std::uint32_t rate = 0;
+
+		std::mutex mutex{};
+		double tokens = 0.0;
+		std::chrono::steady_clock::time_point refilled{};
+};
+
+#endif // NOTHING_THROTTLE_HPP
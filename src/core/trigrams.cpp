@@ -0,0 +1,219 @@
+/*
+	Copyright (c) 2019 Kamil Chojnowski Y29udGFjdEBkaWF0aC5uZXQ=
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in the
+	Software without restriction, including without limitation the rights to use,
+	copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+	THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <limits>
+
+#include "trigrams.hpp"
+
+namespace {
+
+inline std::uint8_t FoldCase(const char ch)
+{
+	const auto byte = static_cast<std::uint8_t>(ch);
+	return (byte >= 'A' && byte <= 'Z') ? static_cast<std::uint8_t>(byte + ('a' - 'A')) : byte;
+}
+
+void Append(std::vector<std::uint8_t> &data, std::uint32_t value)
+{
+	while (value >= 0x80) {
+		data.push_back(static_cast<std::uint8_t>(value | 0x80));
+		value >>= 7;
+	}
+
+	data.push_back(static_cast<std::uint8_t>(value));
+}
+
+template <typename Callback>
+void Decode(const std::vector<std::uint8_t> &data, Callback &&callback)
+{
+	std::uint32_t value = 0;
+	std::size_t index = 0;
+
+	while (index < data.size()) {
+		std::uint32_t delta = 0;
+		std::uint32_t shift = 0;
+		std::uint8_t byte = 0;
+
+		do {
+			byte = data[index++];
+			delta |= static_cast<std::uint32_t>(byte & 0x7F) << shift;
+			shift += 7;
+		} while (byte & 0x80);
+
+		value += delta;
+		if (!callback(value)) {
+			return;
+		}
+	}
+}
+
+} // namespace <anonymous>
+
+void Trigrams::add(const Id row, const std::string_view name)
+{
+	extract(name, scratch);
+
+	for (const auto trigram: scratch) {
+		auto &list = lists[trigram];
+		Append(list.data, list.count == 0 ? row : row - list.last);
+		list.last = row;
+		++list.count;
+	}
+}
+
+void Trigrams::clear()
+{
+	lists.clear();
+}
+
+bool Trigrams::candidates(const std::string_view pattern, std::vector<Id> &out) const
+{
+	out.clear();
+	if (pattern.size() < MinPatternSize) {
+		return false;
+	}
+
+	std::vector<std::uint32_t> trigrams{};
+	extract(pattern, trigrams);
+
+	std::vector<const PostingList *> selected{};
+	selected.reserve(trigrams.size());
+
+	for (const auto trigram: trigrams) {
+		auto it = lists.find(trigram);
+		if (it == lists.end()) {
+			return true;
+		}
+
+		selected.push_back(&it->second);
+	}
+
+	std::sort(selected.begin(), selected.end(), [] (const PostingList *lhs, const PostingList *rhs) {
+		return lhs->count < rhs->count;
+	});
+
+	out.reserve(selected.front()->count);
+	Decode(selected.front()->data, [&out] (const Id row) {
+		out.push_back(row);
+		return true;
+	});
+
+	std::vector<Id> merged{};
+	for (auto it = selected.begin() + 1; it != selected.end() && !out.empty(); ++it) {
+		merged.clear();
+
+		auto current = out.begin();
+		const auto last = out.back();
+
+		Decode((*it)->data, [&] (const Id row) {
+			while (current != out.end() && *current < row) {
+				++current;
+			}
+
+			if (current == out.end()) {
+				return false;
+			}
+
+			if (*current == row) {
+				merged.push_back(row);
+			}
+
+			return row < last;
+		});
+
+		out.swap(merged);
+	}
+
+	return true;
+}
+
+std::size_t Trigrams::estimate(const std::string_view pattern) const
+{
+	if (pattern.size() < MinPatternSize) {
+		return std::numeric_limits<std::size_t>::max();
+	}
+
+	std::vector<std::uint32_t> trigrams{};
+	extract(pattern, trigrams);
+
+	std::size_t result = std::numeric_limits<std::size_t>::max();
+	for (const auto trigram: trigrams) {
+		auto it = lists.find(trigram);
+		if (it == lists.end()) {
+			return 0;
+		}
+
+		result = std::min<std::size_t>(result, it->second.count);
+	}
+
+	return result;
+}
+
+bool Trigrams::isValidList(const std::uint8_t *data, const std::size_t size, const std::uint32_t count, const Id last, const std::size_t rows)
+{
+	if (count == 0 || size == 0 || last >= rows || (data[size - 1] & 0x80)) {
+		return false;
+	}
+
+	std::uint64_t value = 0;
+	std::uint32_t decoded = 0;
+	std::size_t index = 0;
+
+	while (index < size) {
+		std::uint64_t delta = 0;
+		std::uint32_t shift = 0;
+		std::uint8_t byte = 0;
+
+		do {
+			byte = data[index++];
+			delta |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+			shift += 7;
+		} while ((byte & 0x80) && shift < 35);
+
+		// NOTE: Only the first row may be zero, every other one is a step up from the previous row.
+		if ((byte & 0x80) || (decoded != 0 && delta == 0)) {
+			return false;
+		}
+
+		value += delta;
+		if (value > last || ++decoded > count) {
+			return false;
+		}
+	}
+
+	return decoded == count && value == last;
+}
+
+void Trigrams::extract(const std::string_view text, std::vector<std::uint32_t> &out)
+{
+	out.clear();
+	if (text.size() < MinPatternSize) {
+		return;
+	}
+
+	for (std::size_t i = 0; i + MinPatternSize <= text.size(); ++i) {
+		out.push_back(
+			(static_cast<std::uint32_t>(FoldCase(text[i])) << 16) |
+			(static_cast<std::uint32_t>(FoldCase(text[i + 1])) << 8) |
+			static_cast<std::uint32_t>(FoldCase(text[i + 2]))
+		);
+	}
+
+	std::sort(out.begin(), out.end());
+	out.erase(std::unique(out.begin(), out.end()), out.end());
+}
@@ -0,0 +1,77 @@
+/*
+	Copyright (c) 2019 Kamil Chojnowski Y29udGFjdEBkaWF0aC5uZXQ=
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy of
+	this software and associated documentation files (the "Software"), to deal in the
+	Software without restriction, including without limitation the rights to use,
+	copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+	the Software, and to permit persons to whom the Software is furnished to do so,
+	subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+	THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef NOTHING_TRIGRAMS_HPP
+#define NOTHING_TRIGRAMS_HPP
+
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/*
+	Trigram posting-list index over file names.
+
+	Every ASCII case-folded trigram of a name maps to the sorted list of rows containing it. The lists are stored
+	as varint-encoded deltas, rows are only ever appended with increasing ids so adding a name is a cheap append.
+	Removed rows are not purged from the lists, the caller has to verify candidates against the live table anyway
+	and the whole index is rebuilt when the table gets compacted.
+*/
+class Trigrams
+{
+	public:
+		using Id = std::uint32_t;
+
+		static constexpr std::size_t MinPatternSize = 3;
+
+		Trigrams() = default;
+
+		Trigrams(const Trigrams &) = delete;
+		Trigrams(Trigrams &&) = delete;
+
+		Trigrams &operator =(const Trigrams &) = delete;
+		Trigrams &operator =(Trigrams &&) = delete;
+
+		void add(const Id row, const std::string_view name);
+		void clear();
+
+		// Fills the output with the sorted superset of rows that can contain the pattern, returns false if the pattern is too short to use the index.
+		bool candidates(const std::string_view pattern, std::vector<Id> &out) const;
+
+		// Returns an upper bound for the number of candidates of a pattern, or the maximum value if the index cannot be used.
+		std::size_t estimate(const std::string_view pattern) const;
+
+		// Checks that an encoded list holds the given number of increasing rows, ending with the given last one and all below the row count.
+		static bool isValidList(const std::uint8_t *data, const std::size_t size, const std::uint32_t count, const Id last, const std::size_t rows);
+
+	private:
+		friend class Snapshot;
+
+		struct PostingList
+		{
+			std::vector<std::uint8_t> data{};
+			Id last = 0;
+			std::uint32_t count = 0;
+		};
+
+		std::unordered_map<std::uint32_t, PostingList> lists{};
+		std::vector<std::uint32_t> scratch{};
+
+		static void extract(const std::string_view text, std::vector<std::uint32_t> &out);
+};
+
+#endif // NOTHING_TRIGRAMS_HPP
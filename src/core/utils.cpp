@@ -15,15 +15,161 @@
 	THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
-#include <algorithm>
+#include <array>
 #include <sstream>
-#include <tuple>
 #include <vector>
 
 #include "utils.hpp"
 
 namespace fs = std::filesystem;
 
+namespace {
+
+struct FileExtension
+{
+	std::string_view name;
+	FileType type;
+};
+
+constexpr FileExtension FileExtensions[] = {
+	// Document
+	{"txt", FileType::Document},
+	{"doc", FileType::Document},
+	{"pdf", FileType::Document},
+	{"tex", FileType::Document},
+	{"rtf", FileType::Document},
+	// Image
+	{"jpg", FileType::Image},
+	{"jpeg", FileType::Image},
+	{"png", FileType::Image},
+	{"bmp", FileType::Image},
+	{"gif", FileType::Image},
+	{"tiff", FileType::Image},
+	{"ppm", FileType::Image},
+	// Video
+	{"webm", FileType::Video},
+	{"mkv", FileType::Video},
+	{"flv", FileType::Video},
+	{"avi", FileType::Video},
+	{"mp4", FileType::Video},
+	// Audio
+	{"3gp", FileType::Audio},
+	{"aac", FileType::Audio},
+	{"m4a", FileType::Audio},
+	{"mp3", FileType::Audio},
+	{"ogg", FileType::Audio},
+	{"opus", FileType::Audio},
+	{"wav", FileType::Audio},
+	// Archive
+	{"zip", FileType::Archive},
+	{"rar", FileType::Archive},
+	{"tar", FileType::Archive},
+	{"gz", FileType::Archive},
+	{"xz", FileType::Archive},
+	{"bz2", FileType::Archive},
+	{"7z", FileType::Archive},
+	{"z", FileType::Archive},
+	{"tgz", FileType::Archive},
+	{"tbz2", FileType::Archive},
+	// System
+	{"exe", FileType::System},
+	{"dll", FileType::System},
+	{"sys", FileType::System},
+	{"so", FileType::System},
+};
+
+/*
+	The extensions are looked up in a perfect hash table generated at compile time. An extension of up to four
+	characters is packed into a 32-bit key, the table slot is the top bits of the key times a multiplier, and the
+	multiplier is the first one that sends every known extension to its own slot. A lookup is then a single hash
+	and compare, without lowercasing the name into a copy or searching the list.
+*/
+constexpr std::size_t MaxExtensionSize = 4;
+constexpr unsigned ExtensionTableBits = 7;
+
+struct ExtensionSlot
+{
+	// Zero marks an empty slot, no extension packs to it.
+	std::uint32_t key = 0;
+	FileType type = FileType::Generic;
+};
+
+using ExtensionSlots = std::array<ExtensionSlot, std::size_t{1} << ExtensionTableBits>;
+
+constexpr std::uint32_t PackExtension(const std::string_view extension)
+{
+	std::uint32_t key = 0;
+	for (const auto ch: extension) {
+		key = (key << 8) | static_cast<std::uint8_t>((ch >= 'A' && ch <= 'Z') ? ch - 'A' + 'a' : ch);
+	}
+
+	return key;
+}
+
+constexpr std::size_t HashExtension(const std::uint32_t key, const std::uint32_t multiplier)
+{
+	return static_cast<std::uint32_t>(key * multiplier) >> (32 - ExtensionTableBits);
+}
+
+constexpr bool IsPerfect(const std::uint32_t multiplier)
+{
+	bool used[std::size_t{1} << ExtensionTableBits] = {};
+	for (const auto &extension: FileExtensions) {
+		auto &slot = used[HashExtension(PackExtension(extension.name), multiplier)];
+		if (slot) {
+			return false;
+		}
+
+		slot = true;
+	}
+
+	return true;
+}
+
+constexpr std::uint32_t FindMultiplier()
+{
+	// NOTE: Odd multipliers starting from the golden ratio one, a handful of tries is usually enough.
+	for (std::uint32_t multiplier = 0x9E3779B1; multiplier < 0x9E3779B1 + 2 * 4096; multiplier += 2) {
+		if (IsPerfect(multiplier)) {
+			return multiplier;
+		}
+	}
+
+	return 0;
+}
+
+constexpr std::uint32_t ExtensionMultiplier = FindMultiplier();
+static_assert(ExtensionMultiplier != 0, "No perfect hash multiplier found for the file extensions, grow the table.");
+
+constexpr ExtensionSlots MakeExtensionTable()
+{
+	ExtensionSlots slots{};
+	for (const auto &extension: FileExtensions) {
+		auto &slot = slots[HashExtension(PackExtension(extension.name), ExtensionMultiplier)];
+		slot.key = PackExtension(extension.name);
+		slot.type = extension.type;
+	}
+
+	return slots;
+}
+
+constexpr ExtensionSlots ExtensionTable = MakeExtensionTable();
+
+constexpr bool CheckExtensions()
+{
+	for (const auto &extension: FileExtensions) {
+		if (extension.name.empty() || extension.name.size() > MaxExtensionSize) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static_assert(CheckExtensions(), "File extensions have to be between 1 and MaxExtensionSize characters long.");
+
+} // namespace <anonymous>
+
 std::string HumanReadablePerms(const fs::perms perms)
 {
 	std::stringstream s{};
@@ -143,80 +289,19 @@ std::string HumanReadableTime(const std::time_t time)
 	return buffer;
 }
 
-FileType GetFileType(std::string name)
+FileType GetFileType(const std::string_view name)
 {
-	static const std::tuple<std::string, FileType> FileTypes[] = {
-		// Document
-		{".txt", FileType::Document},
-		{".doc", FileType::Document},
-		{".pdf", FileType::Document},
-		{".tex", FileType::Document},
-		{".rtf", FileType::Document},
-		// Image
-		{".jpg", FileType::Image},
-		{".jpeg", FileType::Image},
-		{".png", FileType::Image},
-		{".bmp", FileType::Image},
-		{".gif", FileType::Image},
-		{".tiff", FileType::Image},
-		{".ppm", FileType::Image},
-		// Video
-		{".webm", FileType::Video},
-		{".mkv", FileType::Video},
-		{".flv", FileType::Video},
-		{".avi", FileType::Video},
-		{".mp4", FileType::Video},
-		{".flv", FileType::Video},
-		// Audio
-		{".3gp", FileType::Audio},
-		{".aac", FileType::Audio},
-		{".m4a", FileType::Audio},
-		{".mp3", FileType::Audio},
-		{".ogg", FileType::Audio},
-		{".opus", FileType::Audio},
-		{".wav", FileType::Audio},
-		// Archive
-		{".zip", FileType::Archive},
-		{".rar", FileType::Archive},
-		{".tar", FileType::Archive},
-		{".gz", FileType::Archive},
-		{".xz", FileType::Archive},
-		{".bz2", FileType::Archive},
-		{".7z", FileType::Archive},
-		{".Z", FileType::Archive},
-		{".tgz", FileType::Archive},
-		{".tbz2", FileType::Archive},
-		// System
-		{".exe", FileType::System},
-		{".dll", FileType::System},
-		{".sys", FileType::System},
-		{".so", FileType::System},
-	};
-
-	const auto size = name.size();
-	if (!size) {
+	const auto dot = name.rfind('.');
+	if (dot == std::string_view::npos) {
 		return FileType::Generic;
 	}
 
-	std::transform(name.begin(), name.end(), name.begin(), [] (const unsigned char ch) {
-		return std::tolower(ch);
-	});
-
-	for (const auto &pair: FileTypes) {
-		const auto &[ext, type] = pair;
-		if (ext.size() > size) {
-			continue;
-		}
-
-		auto index = name.rfind(ext);
-		if (index == std::string::npos) {
-			continue;
-		}
-
-		if (name.substr(index) == ext) {
-			return type;
-		}
+	const auto size = name.size() - dot - 1;
+	if (size == 0 || size > MaxExtensionSize) {
+		return FileType::Generic;
 	}
 
-	return FileType::Generic;
+	const auto key = PackExtension(name.substr(dot + 1));
+	const auto &slot = ExtensionTable[HashExtension(key, ExtensionMultiplier)];
+	return slot.key == key ? slot.type : FileType::Generic;
 }
@@ -22,6 +22,7 @@
 #include <ctime>
 #include <filesystem>
 #include <string>
+#include <string_view>
 
 enum class FileType
 {
@@ -34,12 +35,15 @@ enum class FileType
 	System,
 };
 
+constexpr std::size_t FileTypeCount = static_cast<std::size_t>(FileType::System) + 1;
+
 std::string HumanReadablePerms(const std::filesystem::perms perms);
 std::string HumanReadablePermsOwner(const std::filesystem::perms perms);
 std::string HumanReadablePermsGroup(const std::filesystem::perms perms);
 std::string HumanReadablePermsOther(const std::filesystem::perms perms);
 std::string HumanReadableSize(const std::uintmax_t size);
 std::string HumanReadableTime(const std::time_t time);
-FileType GetFileType(std::string name);
+// Classifies a file by the extension of its name, case-insensitively.
+FileType GetFileType(const std::string_view name);
 
 #endif
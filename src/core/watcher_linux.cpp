@@ -24,6 +24,8 @@
 
 #include "watcher_linux.hpp"
 #include "database.hpp"
+#include "directoryreader.hpp"
+#include "exclusions.hpp"
 
 namespace fs = std::filesystem;
 
@@ -64,8 +66,7 @@ void Watcher::stop()
 		fd = -1;
 	}
 
-	for (const auto &descriptor: descriptors) {
-		const auto &[_, path] = descriptor;
+	for (const auto &path: roots.paths()) {
 		unwatch(path);
 	}
 
@@ -127,15 +128,21 @@ bool Watcher::watchInternal(const std::string &parent, const std::string &path)
 
 bool Watcher::watch(const std::string &path)
 {
-	auto it = std::find_if(descriptors.begin(), descriptors.end(), [&path] (auto &&descriptor) {
-		const auto &[_, descriptorPath] = descriptor;
-		return descriptorPath == path;
-	});
-	if (it != descriptors.end()) {
+	if (roots.contains(path)) {
 		std::printf("[Watcher] watch(): Path %s is already being watched, ignoring\n", path.c_str());
 		return true;
 	}
 
+	if (const auto parent = roots.parent(path); !parent.empty()) {
+		std::printf("[Watcher] watch(): Path %s is already being watched through %s, ignoring\n", path.c_str(), parent.c_str());
+		return true;
+	}
+
+	// NOTE: The folders of watched paths below this one are watched again as part of it, inotify hands out one descriptor per folder.
+	for (const auto &child: roots.descendants(path)) {
+		unwatch(child);
+	}
+
 	auto res = inotify_add_watch(
 		fd, path.c_str(),
 		IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
@@ -148,11 +155,17 @@ bool Watcher::watch(const std::string &path)
 	}
 
 	try {
-		for (auto &&entry: fs::recursive_directory_iterator{path, fs::directory_options::skip_permission_denied}) {
+		for (auto it = fs::recursive_directory_iterator{path, fs::directory_options::skip_permission_denied}; it != fs::recursive_directory_iterator{}; ++it) {
+			const auto &entry = *it;
 			if (!entry.is_directory()) {
 				continue;
 			}
 
+			if (isExcluded(entry.path(), true)) {
+				it.disable_recursion_pending();
+				continue;
+			}
+
 			if (!watchInternal(path, entry.path())) {
 				childDescriptors.erase(path);
 				unwatch(path);
@@ -169,26 +182,25 @@ bool Watcher::watch(const std::string &path)
 		std::printf("[Watcher] watch(): Watching %s (wd: %d)\n", path.c_str(), res);
 	#endif
 
-	descriptors.emplace_back(res, path);
+	roots.insert(path, static_cast<RootTrie::Value>(res));
 	folders[res] = path;
 	parents[res] = path;
 
 	return true;
 }
 
-bool Watcher::unwatch(const std::string &path)
+bool Watcher::unwatch(const std::string &removed)
 {
 	// NOTE: This should only be called on top parent paths.
-	auto it = std::find_if(descriptors.begin(), descriptors.end(), [&path] (auto &&descriptor) {
-		const auto &[_, descriptorPath] = descriptor;
-		return descriptorPath == path;
-	});
-
-	if (it == descriptors.end()) {
-		std::fprintf(stderr, "[Watcher] unwatch(): Failed to unwatch %s (path not in descriptor list)\n", path.c_str());
+	if (!roots.contains(removed)) {
+		std::fprintf(stderr, "[Watcher] unwatch(): Failed to unwatch %s (path not in descriptor list)\n", removed.c_str());
 		return false;
 	}
 
+	// NOTE: The child descriptors are keyed by the path as it was watched, which may be spelled differently.
+	const auto path = roots.owner(removed);
+	const auto wd = static_cast<int>(roots.find(path));
+
 	if (childDescriptors.count(path) > 0) {
 		for (const auto &child: childDescriptors[path]) {
 			const auto &[wd, path] = child;
@@ -203,9 +215,7 @@ bool Watcher::unwatch(const std::string &path)
 		childDescriptors.erase(path);
 	}
 
-	const auto &[wd, _] = *it;
-
-	descriptors.erase(it);
+	roots.remove(path);
 	folders.erase(wd);
 	parents.erase(wd);
 
@@ -284,7 +294,7 @@ void Watcher::onFileCreated(int wd, const std::string &name)
 	}
 
 	auto itParent = parents.find(wd);
-	if (it == parents.end()) {
+	if (itParent == parents.end()) {
 		std::fprintf(stderr, "[Watcher] onFileCreated(): Failed to find the top parent for %s (wd: %d)\n",
 			name.c_str(), wd
 		);
@@ -298,16 +308,25 @@ void Watcher::onFileCreated(int wd, const std::string &name)
 	#endif
 
 	Database::Entry entry{};
-	std::error_code ec{};
+	DirectoryReader::Entry file{};
 
 	auto fsPath = fs::path(it->second) / name;
-	auto &[file, path, parent, size, perms] = entry;
+	if (isExcluded(fsPath, false)) {
+		return;
+	}
 
-	file = name;
-	path = it->second;
-	parent = itParent->second;
-	size = fs::file_size(fsPath, ec);
-	perms = fs::status(fsPath, ec).permissions();
+	ReadMetadata(fsPath, file);
+
+	entry.name = name;
+	entry.directory = database->internDirectory(it->second);
+	// NOTE: The scanner may have merged the watched path into a root above it, the rows belong to that one then.
+	entry.root = database->getRootOwner(entry.directory);
+	if (entry.root == Index::InvalidId) {
+		entry.root = database->internRoot(itParent->second);
+	}
+	entry.size = file.size;
+	entry.perms = file.perms;
+	entry.mtime = file.mtime;
 
 	if (!database->addEntry(entry)) {
 		std::fprintf(stderr, "[Watcher] onFileCreated(): Failed to add the entry to the database (%s)\n",
@@ -372,6 +391,10 @@ void Watcher::onDirectoryCreated(int wd, const std::string &name)
 	#endif
 
 	auto path = fs::path(it->second) / name;
+	if (isExcluded(path, true)) {
+		return;
+	}
+
 	if (!watchInternal(itParent->second, path)) {
 		std::fprintf(stderr, "[Watcher] onDirectoryCreated(): Failed to watch %s in %s (parent %s)\n",
 			name.c_str(), it->second.c_str(), itParent->second.c_str()
@@ -381,18 +404,32 @@ void Watcher::onDirectoryCreated(int wd, const std::string &name)
 	// NOTE: This could be a directory that was moved from elsewhere and not just created so we need to populate the database.
 	try {
 		std::vector<Database::Entry> entries = {};
-		for (auto &&entry: fs::recursive_directory_iterator{path, fs::directory_options::skip_permission_denied}) {
-			if (entry.is_directory()) {
+
+		std::vector<Index::Id> directories{database->internDirectory(path)};
+		auto root = database->getRootOwner(directories[0]);
+		if (root == Index::InvalidId) {
+			root = database->internRoot(itParent->second);
+		}
+
+		for (auto dir = fs::recursive_directory_iterator{path, fs::directory_options::skip_permission_denied}; dir != fs::recursive_directory_iterator{}; ++dir) {
+			const auto &entry = *dir;
+			const auto depth = static_cast<std::size_t>(dir.depth());
+
+			if (isExcluded(entry.path(), entry.is_directory())) {
+				dir.disable_recursion_pending();
 				continue;
 			}
 
-			std::error_code ec{};
+			if (entry.is_directory()) {
+				directories.resize(depth + 2);
+				directories[depth + 1] = database->internDirectory(directories[depth], entry.path().filename().string());
+				continue;
+			}
 
-			auto fsPath = fs::path(it->second) / name;
-			auto size = fs::file_size(fsPath, ec);
-			auto perms = fs::status(fsPath, ec).permissions();
+			DirectoryReader::Entry file{};
+			ReadMetadata(entry.path(), file);
 
-			entries.emplace_back(name, it->second, itParent->second, size, perms);
+			entries.push_back({entry.path().filename().string(), directories[depth], root, file.size, file.perms, FileType::Generic, file.mtime});
 		}
 
 		if (!database->addEntries(entries)) {
@@ -458,3 +495,13 @@ void Watcher::onDirectoryDeleted(int wd, const std::string &name)
 		std::fprintf(stderr, "[Watcher] onDirectoryDeleted(): Failed to remove database entries\n");
 	}
 }
+
+bool Watcher::isExcluded(const fs::path &path, const bool directory) const
+{
+	if (!exclusions) {
+		return false;
+	}
+
+	const auto name = path.filename().string();
+	return directory ? exclusions->excludesDirectory(path.generic_string(), name) : exclusions->excludesFile(path.parent_path().generic_string(), name);
+}
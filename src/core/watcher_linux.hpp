@@ -19,12 +19,16 @@
 #define NOTHING_WATCHER_LINUX_HPP
 
 #include <atomic>
+#include <filesystem>
 #include <string>
 #include <thread>
 #include <unordered_map>
 #include <vector>
 
+#include "roottrie.hpp"
+
 class Database;
+class Exclusions;
 
 class Watcher
 {
@@ -47,8 +51,12 @@ class Watcher
 		bool watch(const std::string &path);
 		bool unwatch(const std::string &path);
 
+		// Excluded folders are not watched and excluded files are not added, the rules have to outlive the watcher.
+		void setExclusions(const Exclusions *exclusions) { this->exclusions = exclusions; }
+
 	private:
 		Database *database = nullptr;
+		const Exclusions *exclusions = nullptr;
 
 		std::atomic<bool> running = false;
 		std::thread thread = {};
@@ -59,14 +67,14 @@ class Watcher
 			The inotify_event structure only returns the watch descriptor and the file and folder name but not their full path.
 			So we create some manual mapping to keep track of things.
 
-			The descriptors vector holds all top parent folders.
+			The roots trie holds all top parent folders along with their watch descriptors, they never overlap.
 			The childDescriptors map maps the parent paths to child folders, used for unwatching child folders when a parent is unwatched.
 			The folders map maps watch descriptors to full folder paths.
 			The parents map maps watch descriptors to top parent paths.
 
 			This could likely be cleaned up.
 		*/
-		Descriptors descriptors = {};
+		RootTrie roots{};
 		std::unordered_map<std::string, Descriptors> childDescriptors = {};
 		std::unordered_map<int, std::string> folders = {};
 		std::unordered_map<int, std::string> parents = {};
@@ -80,6 +88,8 @@ class Watcher
 		void onFileDeleted(int wd, const std::string &path);
 		void onDirectoryCreated(int wd, const std::string &path);
 		void onDirectoryDeleted(int wd, const std::string &path);
+
+		bool isExcluded(const std::filesystem::path &path, const bool directory) const;
 };
 
 #endif // NOTHING_WATCHER_LINUX_HPP
@@ -21,6 +21,7 @@
 #include <string>
 
 class Database;
+class Exclusions;
 
 class Watcher
 {
@@ -40,6 +41,9 @@ class Watcher
 		bool watch(const std::string &path);
 		bool unwatch(const std::string &path);
 
+		// NOTE: Nothing is watched on Windows yet, so there is nothing to exclude either.
+		void setExclusions(const Exclusions *) {}
+
 	private:
 		Database *database = nullptr;
 };
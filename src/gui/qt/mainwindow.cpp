@@ -16,11 +16,20 @@
 */
 
 #include "mainwindow.hpp"
+#include "core/snapshot.hpp"
+
+#include <algorithm>
 
 #include <QSettings>
 
 namespace {
 
+// The number of rows fetched per query, more are requested as the view is scrolled down.
+constexpr std::size_t PageSize = 1000;
+
+constexpr std::chrono::seconds AutosaveInterval{5 * 60};
+constexpr std::chrono::seconds StatsInterval{1};
+
 void OpenPath(const std::string &link)
 {
 	QProcess proc;
@@ -39,6 +48,8 @@ MainWindow::MainWindow(int argc, char **argv)
 , table{new QTableView}
 , model{new TableModel}
 , timer{new QTimer{this}}
+, statsTimer{new QTimer{this}}
+, scanStatus{new QLabel}
 {
 	qRegisterMetaType<Database::Entry>("Database::Entry");
 	qRegisterMetaType<std::size_t>("std::size_t");
@@ -83,9 +94,27 @@ MainWindow::MainWindow(int argc, char **argv)
 	});
 
 	database = std::make_unique<Database>();
+
+	// NOTE: Roots restored from the snapshot are searchable right away, the scanner only walks the ones that are missing.
+	const auto snapshotPath = Snapshot::defaultPath();
+	database->loadSnapshot(snapshotPath);
+	database->enableAutosave(snapshotPath, AutosaveInterval);
+
+	exclusions.addDefaults();
+	exclusions.setGitIgnore(gitIgnore);
+	for (auto &&rule: exclusionRules) {
+		if (!exclusions.add(rule.toStdString())) {
+			std::fprintf(stderr, "Ignoring the invalid exclusion rule \"%s\".\n", rule.toStdString().c_str());
+		}
+	}
+
 	scanner = std::make_unique<Scanner>(database.get());
+	scanner->setExclusions(&exclusions);
+	scanner->setOneFilesystem(oneFilesystem);
+	scanner->setPolicy(scanPolicy);
 
 	watcher = std::make_unique<Watcher>(database.get());
+	watcher->setExclusions(&exclusions);
 	watcher->run();
 
 	if (argc > 1) {
@@ -99,7 +128,6 @@ MainWindow::MainWindow(int argc, char **argv)
 	}
 
 	for (auto &&path: paths) {
-		pathsDialog->addPath(path.toStdString());
 		scanner->addPath(path.toStdString());
 
 		if (!watcher->watch(path.toStdString())) {
@@ -107,29 +135,32 @@ MainWindow::MainWindow(int argc, char **argv)
 		}
 	}
 
-	scanner->run();
+	// NOTE: Overlapping paths saved by older versions are merged by the scanner, the dialog lists what is left.
+	pathsDialog->setPaths(scanner->getPaths());
 
-	statusBar()->showMessage("Scanning the paths...");
+	scanner->run();
+	statsTimer->start(StatsInterval);
 
 	timer->setSingleShot(true);
 	connect(timer, &QTimer::timeout, [this] {
-		if (queryText.empty()) {
-			return;
-		}
-
-		++queryIndex;
-		database->query(queryText, viewSettings.useRegexp, [this] (const std::size_t index, const auto &entry) {
-			emit onEntry(index, entry);
-		}, [this] () {
-			emit onDone();
-		});
+		fetchPage();
 	});
 
+	connect(model, &TableModel::onFetchMore, this, [this] () {
+		fetchPage();
+	}, Qt::QueuedConnection);
+
 	connect(this, &MainWindow::onEntry, this, [this] (const std::size_t index, const Database::Entry &entry) {
 		addEntry(index, entry);
 	}, Qt::QueuedConnection);
 
-	connect(this, &MainWindow::onDone, this, [this] () {
+	connect(this, &MainWindow::onDone, this, [this] (const std::size_t index, const std::size_t total) {
+		if (index != queryIndex) {
+			return;
+		}
+
+		model->setTotal(total);
+		statusBar()->showMessage(QString("%1 matches").arg(QLocale().toString(static_cast<qulonglong>(total))));
 		fitContents();
 	}, Qt::QueuedConnection);
 
@@ -217,6 +248,43 @@ void MainWindow::createActions()
 void MainWindow::createStatus()
 {
 	statusBar()->showMessage("Ready.");
+
+	// NOTE: The scan progress has a label of its own so that it does not replace the number of matches.
+	statusBar()->addPermanentWidget(scanStatus);
+	connect(statsTimer, &QTimer::timeout, [this] {
+		updateScanStatus();
+	});
+}
+
+void MainWindow::updateScanStatus()
+{
+	const auto stats = scanner->getStats();
+	const auto scanning = std::count_if(stats.roots.begin(), stats.roots.end(), [] (const Scanner::RootStats &root) {
+		return root.scanning;
+	});
+
+	const auto seconds = std::chrono::duration<double>(StatsInterval).count();
+	const auto rate = stats.files >= scannedFiles ? static_cast<double>(stats.files - scannedFiles) / seconds : 0.0;
+	scannedFiles = stats.files;
+
+	QLocale locale{};
+	if (scanning > 0) {
+		scanStatus->setText(QString("Scanning %1 of %2 paths: %3 folders, %4 files (%5 files/s)")
+			.arg(scanning)
+			.arg(stats.roots.size())
+			.arg(locale.toString(static_cast<qulonglong>(stats.directories)))
+			.arg(locale.toString(static_cast<qulonglong>(stats.files)))
+			.arg(locale.toString(rate, 'f', 0)));
+	} else if (stats.pendingMetadata > 0) {
+		scanStatus->setText(QString("Reading metadata: %1 files left").arg(locale.toString(static_cast<qulonglong>(stats.pendingMetadata))));
+	} else {
+		scanStatus->clear();
+	}
+
+	const auto problems = stats.errors + stats.denied;
+	scanStatus->setToolTip(problems > 0 ? QString("%1 folders could not be listed, %2 of them for lack of permissions.")
+		.arg(locale.toString(static_cast<qulonglong>(problems)))
+		.arg(locale.toString(static_cast<qulonglong>(stats.denied))) : QString{});
 }
 
 void MainWindow::onInputChanged(const std::string &text)
@@ -232,6 +300,35 @@ void MainWindow::onInputChanged(const std::string &text)
 	timer->start(200);
 }
 
+void MainWindow::fetchPage()
+{
+	if (queryText.empty()) {
+		return;
+	}
+
+	Database::QueryOptions options{};
+	options.regexp = viewSettings.useRegexp;
+	options.offset = model->takePage(PageSize);
+	options.limit = PageSize;
+
+	const auto index = ++queryIndex;
+	auto entryCallback = [this] (const std::size_t index, const auto &entry) {
+		emit onEntry(index, entry);
+	};
+
+	auto doneCallback = [this, index] (const std::size_t total) {
+		emit onDone(index, total);
+	};
+
+	// NOTE: The following pages come from the matches of the first one, so they neither shift nor run the query again as the index changes.
+	if (options.offset == 0) {
+		options.pin = true;
+		database->query(queryText, options, entryCallback, doneCallback);
+	} else {
+		database->queryPinned(options, entryCallback, doneCallback);
+	}
+}
+
 void MainWindow::addEntry(const std::size_t index, const Database::Entry &entry)
 {
 	if (index != queryIndex) {
@@ -254,6 +351,8 @@ void MainWindow::onPathAdded(const std::string &dir)
 	auto result = scanner->addPath(dir);
 	if (result == Scanner::AddPathResult::Ok) {
 		pathsDialog->addPath(dir);
+	} else if (result == Scanner::AddPathResult::ChildPathsMerged) {
+		pathsDialog->setPaths(scanner->getPaths());
 	} else {
 		QString message = "Unknown Error";
 		if (result == Scanner::AddPathResult::PathDoesNotExist) {
@@ -294,6 +393,14 @@ QList<QString> MainWindow::loadSettings()
 	viewSettings.showSize = settings.value("showSize", true).toBool();
 	viewSettings.showPerms = settings.value("showPerms", true).toBool();
 
+	exclusionRules = settings.value("exclusions").value<QList<QString>>();
+	gitIgnore = settings.value("gitIgnore", false).toBool();
+	oneFilesystem = settings.value("oneFilesystem", false).toBool();
+	scanPolicy.background = settings.value("backgroundScan", false).toBool();
+	scanPolicy.directoriesPerSecond = settings.value("maxFoldersPerSecond", 0).toUInt();
+	scanPolicy.statsPerSecond = settings.value("maxStatsPerSecond", 0).toUInt();
+	scanPolicy.backoffLatency = std::chrono::milliseconds{settings.value("backoffLatency", 0).toUInt()};
+
 	return settings.value("paths").value<QList<QString>>();
 }
 
@@ -309,6 +416,14 @@ void MainWindow::saveSettings()
 	settings.setValue("showSize", viewSettings.showSize);
 	settings.setValue("showPerms", viewSettings.showPerms);
 
+	settings.setValue("exclusions", QVariant::fromValue(exclusionRules));
+	settings.setValue("gitIgnore", gitIgnore);
+	settings.setValue("oneFilesystem", oneFilesystem);
+	settings.setValue("backgroundScan", scanPolicy.background);
+	settings.setValue("maxFoldersPerSecond", scanPolicy.directoriesPerSecond);
+	settings.setValue("maxStatsPerSecond", scanPolicy.statsPerSecond);
+	settings.setValue("backoffLatency", static_cast<uint>(scanPolicy.backoffLatency.count()));
+
 	QList<QString> paths = {};
 	for (auto &&path: scanner->getPaths()) {
 		paths.append(QString::fromStdString(path));
@@ -328,8 +443,7 @@ void MainWindow::onTableDoubleClicked(const QModelIndex &index)
 		return;
 	}
 
-	const auto &[name, path, _, __, ___] = *entry;
-	auto fsPath = std::filesystem::path(path) / name;
+	auto fsPath = std::filesystem::path(entry->path) / entry->name;
 	OpenPath(fsPath);
 }
 
@@ -345,7 +459,9 @@ void MainWindow::onContextMenuRequested(const QPoint &point)
 		return;
 	}
 
-	const auto &[name, path, parent, _, __] = *entry;
+	const auto name = entry->name;
+	const auto path = entry->path;
+	const auto parent = database->getRootPath(entry->root);
 
 	auto menu = new QMenu(table);
 	menu->addAction("Open File", [name, path] () {
@@ -359,8 +475,8 @@ void MainWindow::onContextMenuRequested(const QPoint &point)
 		OpenPath(parent);
 	});
 	menu->addSeparator();
-	menu->addAction("Properties", [this, entry] () {
-		propsDialog->load(entry);
+	menu->addAction("Properties", [this, entry, path, parent] () {
+		propsDialog->load(entry, path, parent);
 		propsDialog->show();
 	});
 
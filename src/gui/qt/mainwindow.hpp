@@ -21,6 +21,7 @@
 #include <QtWidgets>
 
 #include "core/database.hpp"
+#include "core/exclusions.hpp"
 #include "core/scanner.hpp"
 
 #if defined(PLATFORM_LINUX)
@@ -47,8 +48,10 @@ class MainWindow: public QMainWindow
 	private:
 		void createActions();
 		void createStatus();
+		void updateScanStatus();
 
 		void onInputChanged(const std::string &text);
+		void fetchPage();
 
 		void onPathAdded(const std::string &dir);
 		void onPathRemoved(const std::string &dir);
@@ -68,8 +71,18 @@ class MainWindow: public QMainWindow
 		QTableView *table = nullptr;
 		TableModel *model = nullptr;
 		QTimer *timer = nullptr;
+		QTimer *statsTimer = nullptr;
+		QLabel *scanStatus = nullptr;
+		// The number of files scanned as of the previous update, the rate is taken over the update interval.
+		std::uint64_t scannedFiles = 0;
 
 		std::unique_ptr<Database> database = nullptr;
+		// NOTE: Declared before the scanner and the watcher, which keep a pointer to it.
+		Exclusions exclusions{};
+		QList<QString> exclusionRules = {};
+		bool gitIgnore = false;
+		bool oneFilesystem = false;
+		Scanner::Policy scanPolicy{};
 		std::unique_ptr<Scanner> scanner = nullptr;
 		std::unique_ptr<Watcher> watcher = nullptr;
 
@@ -89,7 +102,7 @@ class MainWindow: public QMainWindow
 
 	signals:
 		void onEntry(const std::size_t index, const Database::Entry &entry);
-		void onDone();
+		void onDone(const std::size_t index, const std::size_t total);
 };
 
 #endif // NOTHING_MAINWINDOW_HPP
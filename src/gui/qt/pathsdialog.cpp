@@ -119,3 +119,11 @@ void PathsDialog::addPath(const std::string &dir)
 {
 	list->addItem(QString::fromStdString(dir));
 }
+
+void PathsDialog::setPaths(const std::vector<std::string> &dirs)
+{
+	list->clear();
+	for (const auto &dir: dirs) {
+		addPath(dir);
+	}
+}
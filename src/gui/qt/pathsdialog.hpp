@@ -28,6 +28,8 @@ class PathsDialog: public QDialog
 		PathsDialog(QWidget *parent);
 
 		void addPath(const std::string &dir);
+		// Replaces the listed paths, without emitting anything.
+		void setPaths(const std::vector<std::string> &dirs);
 
 	private:
 		QListWidget *list = nullptr;
@@ -79,12 +79,12 @@ void PropsDialog::reject()
 	QDialog::reject();
 }
 
-void PropsDialog::load(const Database::Entry *entry)
+void PropsDialog::load(const Database::Entry *entry, const std::string &folder, const std::string &parent)
 {
-	const auto &[_name, _path, _parent, _size, perms] = *entry;
-	name->setText(QString::fromStdString(_name));
-	path->setText(QString::fromStdString(_path));
-	parentPath->setText(QString::fromStdString(_parent));
+	const auto &perms = entry->perms;
+	name->setText(QString::fromStdString(entry->name));
+	path->setText(QString::fromStdString(folder));
+	parentPath->setText(QString::fromStdString(parent));
 
 	owner->setText(QString::fromStdString(HumanReadablePermsOwner(perms)));
 	group->setText(QString::fromStdString(HumanReadablePermsGroup(perms)));
@@ -95,7 +95,7 @@ void PropsDialog::load(const Database::Entry *entry)
 		so instead we fall back to stat() on Linux and GetFileTime() on Windows.
 	*/
 	#if defined(PLATFORM_LINUX)
-		auto fsPath = std::filesystem::path(_path) / _name;
+		auto fsPath = std::filesystem::path(folder) / entry->name;
 		struct stat s = {};
 		if (stat(fsPath.c_str(), &s) == 0) {
 			accessed->setText(QString::fromStdString(HumanReadableTime(s.st_atime)));
@@ -110,7 +110,7 @@ void PropsDialog::load(const Database::Entry *entry)
 		modified->setText("Unknown");
 	#endif
 
-	size->setText(QString::fromStdString(HumanReadableSize(_size)));
+	size->setText(QString::fromStdString(HumanReadableSize(entry->size)));
 }
 
 void PropsDialog::onClosePressed()
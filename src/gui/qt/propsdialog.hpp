@@ -29,7 +29,7 @@ class PropsDialog: public QDialog
 	public:
 		PropsDialog(QWidget *parent);
 
-		void load(const Database::Entry *entry);
+		void load(const Database::Entry *entry, const std::string &folder, const std::string &parent);
 
 	private:
 		QLabel *name = nullptr;
@@ -54,7 +54,7 @@ TableModel::TableModel(QObject *parent/* = nullptr*/)
 			continue;
 		}
 
-		icons[type] = QPixmap(QString::fromStdString(res)).scaled(IconWidth, IconHeight);
+		icons[static_cast<std::size_t>(type)] = QPixmap(QString::fromStdString(res)).scaled(IconWidth, IconHeight);
 	}
 }
 
@@ -75,23 +75,23 @@ QVariant TableModel::data(const QModelIndex &index, int role/* = Qt::DisplayRole
 		return {};
 	}
 
-	const auto &[file, path, _, size, perms] = entries[position];
+	const auto &entry = entries[position];
 	if (role == Qt::DisplayRole) {
 		switch (index.column()) {
-			case 0: return QString::fromStdString(file);
-			case 1: return QString::fromStdString(path);
-			case 2: return QString::fromStdString(HumanReadableSize(size));
-			case 3: return QString::fromStdString(HumanReadablePerms(perms));
+			case 0: return QString::fromStdString(entry.name);
+			case 1: return folders[position];
+			case 2: return QString::fromStdString(HumanReadableSize(entry.size));
+			case 3: return QString::fromStdString(HumanReadablePerms(entry.perms));
 		}
 	} else if (showIcons && role == Qt::DecorationRole) {
 		switch (index.column()) {
 			case 0: {
-				const auto it = icons.find(GetFileType(file));
-				if (it == icons.end()) {
+				const auto &icon = icons[static_cast<std::size_t>(entry.type)];
+				if (icon.isNull()) {
 					return {};
 				}
 
-				return it->second;
+				return icon;
 			} break;
 		}
 	}
@@ -119,18 +119,55 @@ QVariant TableModel::headerData(int section, Qt::Orientation orientation, int ro
 	return {};
 }
 
+bool TableModel::canFetchMore(const QModelIndex &parent) const
+{
+	if (parent.isValid()) {
+		return false;
+	}
+
+	return !fetching && fetched < total;
+}
+
+void TableModel::fetchMore(const QModelIndex &parent)
+{
+	if (!canFetchMore(parent)) {
+		return;
+	}
+
+	fetching = true;
+	emit onFetchMore();
+}
+
 void TableModel::addEntry(const Database::Entry &entry)
 {
 	entries.emplace_back(entry);
+	folders.push_back(QString::fromStdString(entry.path));
 	emit layoutChanged();
 }
 
 void TableModel::clear()
 {
 	entries.clear();
+	folders.clear();
+	total = 0;
+	fetched = 0;
+	fetching = false;
 	emit layoutChanged();
 }
 
+void TableModel::setTotal(const std::size_t total)
+{
+	this->total = total;
+	fetching = false;
+}
+
+std::size_t TableModel::takePage(const std::size_t size)
+{
+	const auto offset = fetched;
+	fetched += size;
+	return offset;
+}
+
 void TableModel::setShowIcons(const bool show)
 {
 	showIcons = show;
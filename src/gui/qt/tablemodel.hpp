@@ -24,7 +24,7 @@
 #include "core/database.hpp"
 #include "core/utils.hpp"
 
-#include <unordered_map>
+#include <array>
 #include <vector>
 
 class TableModel: public QAbstractTableModel
@@ -40,17 +40,36 @@ class TableModel: public QAbstractTableModel
 		QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
 		QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
 
+		bool canFetchMore(const QModelIndex &parent) const;
+		void fetchMore(const QModelIndex &parent);
+
 		void addEntry(const Database::Entry &entry);
 		void clear();
 
+		void setTotal(const std::size_t total);
+		// Returns where the next page of matches starts and moves past it.
+		std::size_t takePage(const std::size_t size);
+
 		void setShowIcons(const bool show);
 
 		Database::Entry *entry(const int index);
 
 	private:
 		std::vector<Database::Entry> entries = {};
-		std::unordered_map<FileType, QPixmap> icons = {};
+		// The folder of every entry, converted once when the entry is added rather than on every paint.
+		std::vector<QString> folders = {};
+		// Indexed by the file type, a null pixmap stands for no icon.
+		std::array<QPixmap, FileTypeCount> icons = {};
 		bool showIcons = true;
+
+		// The total number of matches of the current query, only a window of them is fetched at a time.
+		std::size_t total = 0;
+		// The number of matches asked for so far, the ones removed since the query ran are skipped so there can be fewer entries.
+		std::size_t fetched = 0;
+		bool fetching = false;
+
+	signals:
+		void onFetchMore();
 };
 
 #endif
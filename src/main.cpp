@@ -15,18 +15,112 @@
 	THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
 #include <string>
 
 #include "core/database.hpp"
+#include "core/exclusions.hpp"
 #include "core/scanner.hpp"
+#include "core/snapshot.hpp"
+#include "core/utils.hpp"
+
+namespace {
+
+constexpr std::chrono::seconds AutosaveInterval{5 * 60};
+
+// Reads a number given as <name>=<value>, returns false if the argument is a different one.
+bool ParseNumber(const std::string &argument, const std::string &name, std::uint32_t &value)
+{
+	if (argument.size() <= name.size() + 1 || argument.compare(0, name.size(), name) != 0 || argument[name.size()] != '=') {
+		return false;
+	}
+
+	value = static_cast<std::uint32_t>(std::strtoul(argument.c_str() + name.size() + 1, nullptr, 10));
+	return true;
+}
+
+inline double Seconds(const std::chrono::nanoseconds duration)
+{
+	return std::chrono::duration<double>(duration).count();
+}
+
+void PrintStats(const Scanner::Stats &stats)
+{
+	printf("%llu folders, %llu files, %s, %llu errors, %llu denied\n",
+		static_cast<unsigned long long>(stats.directories), static_cast<unsigned long long>(stats.files), HumanReadableSize(stats.bytes).c_str(),
+		static_cast<unsigned long long>(stats.errors), static_cast<unsigned long long>(stats.denied));
+	printf("%zu folders queued, %zu files without metadata, %zu/%zu batches waiting to be inserted\n",
+		stats.queuedDirectories, stats.pendingMetadata, stats.ingest.queueDepth, stats.ingest.queueCapacity);
+	printf("%.2fs listing, %.2fs reading metadata, %.2fs inserting, %.2fs stalled on %llu full queues\n",
+		Seconds(stats.listTime), Seconds(stats.statTime), Seconds(stats.insertTime), Seconds(stats.ingest.stallTime), static_cast<unsigned long long>(stats.ingest.stalls));
+	printf("%.2fs held back by the rate limits, %.2fs backing off from slow storage\n", Seconds(stats.throttleTime), Seconds(stats.backoffTime));
+
+	for (const auto &root: stats.roots) {
+		printf("  %s: %s, %llu folders, %llu files in %.2fs (%.0f files/s), %llu errors, %llu denied\n",
+			root.path.c_str(), root.scanning ? "scanning" : "done", static_cast<unsigned long long>(root.directories), static_cast<unsigned long long>(root.files),
+			Seconds(root.elapsed), root.filesPerSecond(), static_cast<unsigned long long>(root.errors), static_cast<unsigned long long>(root.denied));
+	}
+}
+
+} // namespace <anonymous>
 
 int main(int argc, char **argv)
 {
 	Database db{};
+
+	const auto snapshotPath = Snapshot::defaultPath();
+	if (db.loadSnapshot(snapshotPath)) {
+		printf("Loaded the index snapshot from %s.\n", snapshotPath.c_str());
+	}
+
+	db.enableAutosave(snapshotPath, AutosaveInterval);
+
+	Exclusions exclusions{};
+	exclusions.addDefaults();
+
 	Scanner scanner{&db};
+	scanner.setExclusions(&exclusions);
+
+	Scanner::Policy policy{};
+	std::uint32_t backoffLatency = 0;
+
 	if (argc > 1) {
 		for (int i = 1; i < argc; ++i) {
+			// NOTE: Exclusion rules are given as --exclude <rule> or --exclude=<rule>, see the Exclusions class for the syntax.
+			const std::string argument{argv[i]};
+			if (argument == "--gitignore") {
+				exclusions.setGitIgnore(true);
+				continue;
+			}
+
+			if (argument == "--one-filesystem") {
+				scanner.setOneFilesystem(true);
+				continue;
+			}
+
+			// NOTE: See Scanner::Policy, the latency is given in milliseconds.
+			if (argument == "--background") {
+				policy.background = true;
+				continue;
+			}
+
+			if (ParseNumber(argument, "--max-folders-per-second", policy.directoriesPerSecond)
+				|| ParseNumber(argument, "--max-stats-per-second", policy.statsPerSecond)
+				|| ParseNumber(argument, "--backoff-latency", backoffLatency)) {
+				continue;
+			}
+
+			if (argument == "--exclude" || argument.compare(0, 10, "--exclude=") == 0) {
+				const auto rule = argument == "--exclude" ? (i + 1 < argc ? std::string{argv[++i]} : std::string{}) : argument.substr(10);
+				if (!exclusions.add(rule)) {
+					fprintf(stderr, "Failed to add the exclusion rule \"%s\".\n", rule.c_str());
+				}
+
+				continue;
+			}
+
 			auto result = scanner.addPath(argv[i]);
 			if (result == Scanner::AddPathResult::PathDoesNotExist) {
 				fprintf(stderr, "Failed to add path %s, reason: path does not exist.\n", argv[i]);
@@ -38,10 +132,15 @@ int main(int argc, char **argv)
 				fprintf(stderr, "Failed to add path %s, reason: path has an existing parent path.\n", argv[i]);
 			} else if (result == Scanner::AddPathResult::Ok) {
 				printf("Added %s.\n", argv[i]);
+			} else if (result == Scanner::AddPathResult::ChildPathsMerged) {
+				printf("Added %s, the paths added below it are merged into it.\n", argv[i]);
 			}
 		}
 	}
 
+	policy.backoffLatency = std::chrono::milliseconds{backoffLatency};
+	scanner.setPolicy(policy);
+
 	scanner.run();
 	std::string line{};
 	while (scanner.isRunning()) {
@@ -49,10 +148,13 @@ int main(int argc, char **argv)
 
 		if (line == "stop") {
 			scanner.stop();
+		} else if (line == "stats") {
+			PrintStats(scanner.getStats());
 		} else {
-			db.query(line, false, [] (const std::size_t index, const auto &e) {
-				const auto &[file, _, __, size, ___] = e;
-				printf("(%ld) Received %s (%d bytes)\n", index, file.c_str(), (int) size);
+			db.query(line, {}, [] (const std::size_t index, const auto &e) {
+				printf("(%ld) Received %s (%d bytes)\n", index, e.name.c_str(), (int) e.size);
+			}, [] (const std::size_t total) {
+				printf("%ld matches\n", total);
 			});
 		}
 	}